@@ -0,0 +1,589 @@
+
+// End-to-end benchmark: runs full dpfb bakes over a fixed corpus and
+// reports median and 95th percentile wall time, glyphs per second, and
+// peak RSS of every case. Results can be saved as a baseline and
+// compared against it; a case that is slower than the baseline by more
+// than the threshold makes the benchmark fail.
+//
+// Peak RSS and glyph counts are taken from the -stats-json report of
+// dpfb, so peak RSS is 0 on platforms where dpfb can't get it.
+//
+// Besides the fonts from tests/data, the corpus has synthetic fonts
+// (see tests/stress_font.h) that are generated in the output directory
+// before running.
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+    #include <direct.h>
+#else
+    #include <sys/stat.h>
+#endif
+
+#include "str.h"
+#include "streams/file_stream.h"
+#include "stress_font.h"
+
+
+using namespace dpfb;
+
+
+struct Options {
+    std::string dpfbPath = DPFB_BENCH_DPFB_PATH;
+    std::string dataDir = DPFB_BENCH_DATA_DIR;
+    std::string outDir = "dpfb-bench-out";
+    std::string filter;
+    std::string baselinePath;
+    std::string saveBaselinePath;
+    int numRuns = 5;
+    int numWarmupRuns = 1;
+    double threshold = 10.0;
+    bool listOnly = false;
+};
+
+
+struct BenchCase {
+    std::string name;
+    std::string args;
+    std::string fontPath;
+    // If not null, the font is generated to fontPath before running.
+    const StressFontParams* stressFontParams;
+};
+
+
+struct BenchResult {
+    double medianMs;
+    double p95Ms;
+    std::size_t numGlyphs;
+    std::uint64_t peakRssKib;
+};
+
+
+const char* const help = (
+    "Usage: %s [options]\n"
+    "\n"
+    "Run full bakes over a fixed corpus and report median and 95th\n"
+    "percentile wall time, glyphs per second, and peak RSS.\n"
+    "\n"
+    "Options:\n"
+    "  -baseline PATH\n"
+    "           Compare medians against a baseline saved with\n"
+    "           -save-baseline. Exit with an error if a case is slower\n"
+    "           than the baseline by more than -threshold.\n"
+    "  -data-dir PATH\n"
+    "           Directory with the corpus fonts. Default is \"%s\".\n"
+    "  -dpfb PATH\n"
+    "           dpfb executable. Default is \"%s\".\n"
+    "  -filter STR\n"
+    "           Only run cases whose names contain STR.\n"
+    "  -list\n"
+    "           List case names and exit.\n"
+    "  -out-dir PATH\n"
+    "           Directory for baked files. Default is \"%s\".\n"
+    "  -runs N\n"
+    "           Number of measured runs of every case. Default is %i.\n"
+    "  -save-baseline PATH\n"
+    "           Save medians as a baseline.\n"
+    "  -threshold PERCENT\n"
+    "           Allowed slowdown against the baseline. Default is %g.\n"
+    "  -warmup N\n"
+    "           Number of unmeasured runs before measuring.\n"
+    "           Default is %i.\n"
+);
+
+
+static void printHelp(const char* progName)
+{
+    const Options defaults;
+    std::printf(
+        help,
+        progName,
+        defaults.dataDir.c_str(),
+        defaults.dpfbPath.c_str(),
+        defaults.outDir.c_str(),
+        defaults.numRuns,
+        defaults.threshold,
+        defaults.numWarmupRuns);
+}
+
+
+static void exitWithError(const char* msg)
+{
+    std::fprintf(stderr, "%s\n", msg);
+    std::exit(EXIT_FAILURE);
+}
+
+
+static Options parseOptions(int argc, char* argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* opt = argv[i];
+
+        if (std::strcmp(opt, "-help") == 0) {
+            printHelp(argv[0]);
+            std::exit(EXIT_SUCCESS);
+        } else if (std::strcmp(opt, "-list") == 0) {
+            options.listOnly = true;
+            continue;
+        }
+
+        if (i + 1 == argc)
+            exitWithError(str::format("%s expects an argument", opt).c_str());
+        const char* value = argv[++i];
+
+        if (std::strcmp(opt, "-baseline") == 0)
+            options.baselinePath = value;
+        else if (std::strcmp(opt, "-data-dir") == 0)
+            options.dataDir = value;
+        else if (std::strcmp(opt, "-dpfb") == 0)
+            options.dpfbPath = value;
+        else if (std::strcmp(opt, "-filter") == 0)
+            options.filter = value;
+        else if (std::strcmp(opt, "-out-dir") == 0)
+            options.outDir = value;
+        else if (std::strcmp(opt, "-runs") == 0)
+            options.numRuns = std::atoi(value);
+        else if (std::strcmp(opt, "-save-baseline") == 0)
+            options.saveBaselinePath = value;
+        else if (std::strcmp(opt, "-threshold") == 0)
+            options.threshold = std::atof(value);
+        else if (std::strcmp(opt, "-warmup") == 0)
+            options.numWarmupRuns = std::atoi(value);
+        else
+            exitWithError(str::format("Unknown option %s", opt).c_str());
+    }
+
+    if (options.numRuns < 1)
+        exitWithError("-runs must be at least 1");
+    if (options.numWarmupRuns < 0)
+        exitWithError("-warmup must not be negative");
+
+    return options;
+}
+
+
+static StressFontParams makeStressFontParams(
+    std::uint16_t numGlyphs,
+    std::uint16_t numLookups,
+    std::uint16_t numClasses,
+    std::uint16_t numClassRanges)
+{
+    StressFontParams params;
+    params.numGlyphs = numGlyphs;
+    params.numLookups = numLookups;
+    params.numClasses1 = numClasses;
+    params.numClasses2 = numClasses;
+    params.numClassRanges = numClassRanges;
+    return params;
+}
+
+
+static std::vector<BenchCase> createCases(const Options& options)
+{
+    struct CorpusFont {
+        const char* name;
+        const char* fileName;
+        const char* args;
+    };
+
+    static const CorpusFont fonts[] = {
+        {"kern", "kerning_kern.otf", ""},
+        {"gpos_pairs", "kerning_gpos_pairs.otf", ""},
+        {"gpos_classes", "kerning_gpos_classes.otf", ""},
+        {"gpos_device", "kerning_gpos_pairs_device1.otf",
+            "-kerning-units font"},
+        {"ttc", "collection00.ttc", "-font-index all"},
+        {"otc", "collection01.otc", "-font-index all"},
+    };
+
+    static const char* const renderers[] = {
+        #if DPFB_USE_FREETYPE
+        "ft",
+        #endif
+        #if DPFB_USE_NATIVE
+        "native",
+        #endif
+        #if DPFB_USE_STBTT
+        "stb",
+        #endif
+    };
+
+    static const int sizes[] = {16, 64};
+
+    struct CpSet {
+        const char* name;
+        const char* codePoints;
+    };
+
+    static const CpSet cpSets[] = {
+        {"ascii", "32-126"},
+        {"bmp", "0-65535"},
+    };
+
+    struct ExportFormat {
+        const char* name;
+        const char* args;
+    };
+
+    static const ExportFormat formats[] = {
+        #if DPFB_USE_LIBPNG
+        {"json_png", "-font-export-format json -image-format png"},
+        #else
+        {"json_pgm", "-font-export-format json -image-format pgm"},
+        #endif
+        {"bmfont_tga", "-font-export-format bmfont -image-format tga"},
+    };
+
+    std::vector<BenchCase> cases;
+
+    for (const auto& font : fonts)
+        for (const auto* renderer : renderers)
+            for (const auto size : sizes)
+                for (const auto& cpSet : cpSets)
+                    for (const auto& format : formats)
+                        cases.push_back({
+                            str::format(
+                                "%s/%s/%i/%s/%s",
+                                font.name,
+                                renderer,
+                                size,
+                                cpSet.name,
+                                format.name),
+                            str::format(
+                                "-font-renderer %s -font-size %i "
+                                "-code-points %s %s %s",
+                                renderer,
+                                size,
+                                cpSet.codePoints,
+                                format.args,
+                                font.args),
+                            options.dataDir + "/" + font.fileName,
+                            nullptr});
+
+    // Synthetic stress inputs: huge glyphs with wide padding give big
+    // pages, many pages, and a lot of pixels to render and encode.
+    for (const auto& font : fonts)
+        for (const auto* renderer : renderers)
+            cases.push_back({
+                str::format("stress/%s/%s", font.name, renderer),
+                str::format(
+                    "-font-renderer %s -font-size 512 "
+                    "-code-points 0-65535 -glyph-padding-inner 4 "
+                    "-glyph-padding-outer 16 -image-max-size 2048 "
+                    "-image-max-count 1000 -image-format tga %s",
+                    renderer,
+                    font.args),
+                options.dataDir + "/" + font.fileName,
+                nullptr});
+
+    // Synthetic fonts: all glyphs of the 65k one give O(n^2) behavior
+    // of packing and class kerning a chance to show up; the other one
+    // expands big class kerning matrices of many lookups to pairs.
+    struct SyntheticFont {
+        const char* name;
+        StressFontParams params;
+        const char* args;
+    };
+
+    static const SyntheticFont syntheticFonts[] = {
+        {
+            "glyphs65k",
+            makeStressFontParams(65535, 4, 64, 500),
+            "-kerning-format classes"},
+        {
+            "kerning_pairs",
+            makeStressFontParams(1000, 16, 100, 500),
+            ""},
+    };
+
+    for (const auto& font : syntheticFonts) {
+        const auto cps = getStressFontCps(font.params);
+        for (const auto* renderer : renderers)
+            cases.push_back({
+                str::format("synthetic/%s/%s", font.name, renderer),
+                str::format(
+                    "-font-renderer %s -font-size 16 "
+                    "-code-points %u-%u %s %s",
+                    renderer,
+                    static_cast<unsigned>(cps.front()),
+                    static_cast<unsigned>(cps.back()),
+                    formats[0].args,
+                    font.args),
+                str::format("%s/%s.ttf", options.outDir.c_str(), font.name),
+                &font.params});
+    }
+
+    if (!options.filter.empty())
+        cases.erase(
+            std::remove_if(
+                cases.begin(), cases.end(),
+                [&](const BenchCase& benchCase)
+                {
+                    return (
+                        benchCase.name.find(options.filter)
+                        == std::string::npos);
+                }),
+            cases.end());
+
+    return cases;
+}
+
+
+static std::string readFile(const std::string& path)
+{
+    streams::FileStream f(path, "rb");
+
+    std::string result(f.getSize(), 0);
+    if (!result.empty())
+        f.readBuffer(&result[0], result.size());
+
+    return result;
+}
+
+
+// Return values of all occurrences of "key": N in a JSON string. We
+// only read the -stats-json report, so a full parser is not needed.
+static std::vector<std::uint64_t> findJsonInts(
+    const std::string& json, const char* key)
+{
+    std::vector<std::uint64_t> result;
+
+    const auto pattern = str::format("\"%s\": ", key);
+    auto pos = json.find(pattern);
+    while (pos != std::string::npos) {
+        pos += pattern.size();
+        result.push_back(std::strtoull(json.c_str() + pos, nullptr, 10));
+        pos = json.find(pattern, pos);
+    }
+
+    return result;
+}
+
+
+static double getPercentile(std::vector<double> values, double p)
+{
+    std::sort(values.begin(), values.end());
+
+    // Nearest rank
+    auto rank = static_cast<std::size_t>(p / 100.0 * values.size() + 0.5);
+    rank = std::max<std::size_t>(rank, 1);
+    rank = std::min(rank, values.size());
+    return values[rank - 1];
+}
+
+
+static BenchResult runCase(
+    const Options& options, const BenchCase& benchCase)
+{
+    const auto statsPath = options.outDir + "/stats.json";
+    const auto command = str::format(
+        "\"%s\" -out-dir \"%s\" -stats-json \"%s\" %s \"%s\" %s",
+        options.dpfbPath.c_str(),
+        options.outDir.c_str(),
+        statsPath.c_str(),
+        benchCase.args.c_str(),
+        benchCase.fontPath.c_str(),
+        #ifdef _WIN32
+        "> NUL"
+        #else
+        "> /dev/null"
+        #endif
+    );
+
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<double> timesMs;
+    for (int i = 0; i < options.numWarmupRuns + options.numRuns; ++i) {
+        const auto startTime = Clock::now();
+        const auto status = std::system(command.c_str());
+        const auto endTime = Clock::now();
+
+        if (status != 0)
+            throw std::runtime_error(str::format(
+                "%s failed with status %i: %s",
+                benchCase.name.c_str(), status, command.c_str()));
+
+        if (i >= options.numWarmupRuns)
+            timesMs.push_back(
+                std::chrono::duration<double, std::milli>(
+                    endTime - startTime).count());
+    }
+
+    // The stats of the last run
+    const auto statsJson = readFile(statsPath);
+
+    BenchResult result {};
+    result.medianMs = getPercentile(timesMs, 50.0);
+    result.p95Ms = getPercentile(timesMs, 95.0);
+
+    for (const auto numGlyphs : findJsonInts(statsJson, "glyphs"))
+        result.numGlyphs += numGlyphs;
+    for (const auto peakRssKib : findJsonInts(statsJson, "peakRssKib"))
+        result.peakRssKib = std::max(result.peakRssKib, peakRssKib);
+
+    return result;
+}
+
+
+// The baseline is a text file with a "name median_ms" line for every
+// case. Lines starting with # are comments.
+static std::map<std::string, double> loadBaseline(const std::string& path)
+{
+    std::map<std::string, double> baseline;
+
+    const auto data = readFile(path);
+    std::size_t lineStart = 0;
+    while (lineStart < data.size()) {
+        auto lineEnd = data.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
+            lineEnd = data.size();
+
+        const auto line = data.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        const auto spacePos = line.rfind(' ');
+        if (spacePos == std::string::npos)
+            throw std::runtime_error(str::format(
+                "Invalid baseline line \"%s\"", line.c_str()));
+
+        baseline[line.substr(0, spacePos)] = std::atof(
+            line.c_str() + spacePos + 1);
+    }
+
+    return baseline;
+}
+
+
+static void saveBaseline(
+    const std::string& path,
+    const std::vector<BenchCase>& cases,
+    const std::vector<BenchResult>& results)
+{
+    streams::FileStream f(path, "wb");
+    f.writeStr("# dpfb-bench baseline: case median_ms\n");
+    for (std::size_t i = 0; i < cases.size(); ++i)
+        f.writeStr(str::format(
+            "%s %.3f\n", cases[i].name.c_str(), results[i].medianMs));
+}
+
+
+static void makeDir(const std::string& path)
+{
+    #ifdef _WIN32
+    _mkdir(path.c_str());
+    #else
+    mkdir(path.c_str(), 0777);
+    #endif
+}
+
+
+static void writeStressFonts(const std::vector<BenchCase>& cases)
+{
+    std::set<std::string> writtenPaths;
+    for (const auto& benchCase : cases) {
+        if (!benchCase.stressFontParams
+                || !writtenPaths.insert(benchCase.fontPath).second)
+            continue;
+
+        const auto fontData = generateStressFont(
+            *benchCase.stressFontParams);
+        streams::FileStream f(benchCase.fontPath, "wb");
+        f.writeBuffer(fontData.data(), fontData.size());
+    }
+}
+
+
+static int run(const Options& options)
+{
+    const auto cases = createCases(options);
+
+    if (options.listOnly) {
+        for (const auto& benchCase : cases)
+            std::printf("%s\n", benchCase.name.c_str());
+        return EXIT_SUCCESS;
+    }
+
+    std::map<std::string, double> baseline;
+    if (!options.baselinePath.empty())
+        baseline = loadBaseline(options.baselinePath);
+
+    makeDir(options.outDir);
+    writeStressFonts(cases);
+
+    std::printf(
+        "%-40s %10s %10s %12s %14s\n",
+        "case", "median, ms", "p95, ms", "glyphs/s", "peak RSS, KiB");
+
+    std::vector<BenchResult> results;
+    std::vector<std::string> regressions;
+
+    for (const auto& benchCase : cases) {
+        const auto result = runCase(options, benchCase);
+        results.push_back(result);
+
+        std::printf(
+            "%-40s %10.2f %10.2f %12.0f %14" PRIu64 "\n",
+            benchCase.name.c_str(),
+            result.medianMs,
+            result.p95Ms,
+            result.numGlyphs / (result.medianMs / 1000.0),
+            result.peakRssKib);
+        std::fflush(stdout);
+
+        const auto iter = baseline.find(benchCase.name);
+        if (iter == baseline.end() || iter->second <= 0.0)
+            continue;
+
+        const auto slowdown = (result.medianMs / iter->second - 1.0) * 100.0;
+        if (slowdown > options.threshold)
+            regressions.push_back(str::format(
+                "%s: %.2f ms, baseline %.2f ms (+%.1f%%)",
+                benchCase.name.c_str(),
+                result.medianMs,
+                iter->second,
+                slowdown));
+    }
+
+    if (!options.saveBaselinePath.empty())
+        saveBaseline(options.saveBaselinePath, cases, results);
+
+    if (!regressions.empty()) {
+        std::printf(
+            "\n%zu case(s) are slower than the baseline by more than "
+            "%g%%:\n",
+            regressions.size(), options.threshold);
+        for (const auto& regression : regressions)
+            std::printf("  %s\n", regression.c_str());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+int main(int argc, char* argv[])
+{
+    const auto options = parseOptions(argc, argv);
+
+    try {
+        return run(options);
+    } catch (std::runtime_error& e) {
+        std::fprintf(stderr, "dpfb-bench: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+}
@@ -24,10 +24,11 @@ const int numPositionalArgs = 1;
 const char* fontPath = "";
 
 const char* codePoints = "33-126";
+bool compareRenderers;
 int fontDpi = 72;
 const char* fontExportFormat = "json";
 const char* fontExportName = "";
-int fontIndex = 0;
+const char* fontIndex = "0";
 const char* fontRenderer = (
     #if DPFB_USE_FREETYPE
     "ft"
@@ -54,7 +55,19 @@ int imageMaxSize = 1024;
 int imagePadding[4] = {1, 1, 1, 1};
 const char* imageSizeMode = "min";
 const char* kerning = "both";
+const char* kerningCorpus = "";
+const char* kerningFormat = "pairs";
+const char* kerningLang = "";
+int kerningMaxPairs;
+int kerningMinAmount;
+const char* kerningScript = "";
+const char* kerningUnits = "px";
 const char* outDir = ".";
+int profileGlyphs;
+bool stats;
+const char* statsJson = "";
+const char* strikes = "prefer";
+const char* trace = "";
 
 
 const char* help = (
@@ -69,6 +82,11 @@ const char* help = (
     "\n"
     "  -code-points POINTS\n"
     "           Code points to bake. Default is \"%s\".\n"
+    "  -compare-renderers\n"
+    "           Instead of baking, get metrics and render glyphs with\n"
+    "           every font renderer, and compare them with the one of\n"
+    "           -font-renderer: time, glyphs per second, and metric and\n"
+    "           pixel differences.\n"
     "  -font-dpi DPI\n"
     "           Font dpi. Default is %i.\n"
     "  -font-export-format NAME\n"
@@ -76,9 +94,12 @@ const char* help = (
     "  -font-export-name NAME\n"
     "           Name of the exported font. Default is the font file\n"
     "           name.\n"
-    "  -font-index\n"
+    "  -font-index INDICES\n"
     "           0-based index of font in a collection (TTC and OTC).\n"
-    "           Default is 0.\n"
+    "           Can also be a comma-separated list of indices and\n"
+    "           ranges (like 0,2-4), or \"all\". Several fonts are\n"
+    "           baked in parallel, and their indices are appended to\n"
+    "           the export name. Default is 0.\n"
     "  -font-size SIZE\n"
     "           Font size. Default is %i.\n"
     "  -font-renderer NAME\n"
@@ -107,8 +128,44 @@ const char* help = (
     "           Image size mode. Default is \"%s\".\n"
     "  -kerning SOURCE\n"
     "           Source of kerning pairs. Default is \"both\".\n"
+    "  -kerning-corpus PATH\n"
+    "           UTF-8 text to rank kerning pairs by frequency when\n"
+    "           -kerning-max-pairs is set.\n"
+    "  -kerning-format FORMAT\n"
+    "           Format of kerning. Default is \"%s\".\n"
+    "  -kerning-lang TAG\n"
+    "           OpenType language tag (like \"TRK\") for -kerning-script.\n"
+    "           Default is the default language of the scripts.\n"
+    "  -kerning-max-pairs N\n"
+    "           Maximum number of kerning pairs. Pairs with the largest\n"
+    "           amounts (or the most frequent ones, if -kerning-corpus\n"
+    "           is given) are kept. Default is 0 (no limit).\n"
+    "  -kerning-min-amount N\n"
+    "           Drop kerning pairs with smaller absolute amounts.\n"
+    "           Default is 0.\n"
+    "  -kerning-script TAGS\n"
+    "           Comma-separated OpenType script tags (like \"latn,cyrl\")\n"
+    "           to read \"GPOS\" kerning for. Default is all scripts and\n"
+    "           languages.\n"
+    "  -kerning-units UNITS\n"
+    "           Units of kerning amounts. Default is \"%s\".\n"
     "  -out-dir PATH\n"
     "           Output directory. Default is \".\".\n"
+    "  -profile-glyphs N\n"
+    "           Time getting metrics and rendering of every glyph, and\n"
+    "           print N slowest glyphs and a histogram of glyph times.\n"
+    "           Default is 0 (don't profile).\n"
+    "  -stats\n"
+    "           Print time, peak memory, and stream I/O statistics of\n"
+    "           baking stages. Stream I/O counters are available if\n"
+    "           dpfb is built with DPFB_STREAM_STATS.\n"
+    "  -stats-json PATH\n"
+    "           Write the statistics of -stats to a JSON file.\n"
+    "  -strikes MODE\n"
+    "           Use of embedded bitmap strikes. Default is \"%s\".\n"
+    "  -trace PATH\n"
+    "           Write a timeline of baking in the Trace Event Format\n"
+    "           (JSON) for chrome://tracing or Perfetto.\n"
     "  -version\n"
     "           Print program version and exit.\n"
     "\n"
@@ -122,6 +179,21 @@ const char* help = (
     "  gpos  extract pairs from \"GPOS\" table\n"
     "  both  extract pairs from both \"kern\" and \"GPOS\" tables\n"
     "\n"
+    "Kerning formats (-kerning-format):\n"
+    "  pairs    expand class-based kerning to pairs\n"
+    "  classes  keep class-based kerning as class tables, if the font\n"
+    "           export format supports them\n"
+    "\n"
+    "Kerning units (-kerning-units):\n"
+    "  px    pixels of the font size\n"
+    "  font  font design units, if the font export format supports\n"
+    "        them; adjustments for specific sizes are exported\n"
+    "        separately\n"
+    "\n"
+    "Bitmap strikes modes (-strikes):\n"
+    "  prefer  use the strike of the font size, if any\n"
+    "  ignore  always render outlines\n"
+    "\n"
     "Image size modes (-image-size-mode):\n"
     "  min      use minimal image size\n"
     "  min-pot  use minimal power of two image size <= -image-max-size\n"
@@ -160,7 +232,10 @@ static void printHelp(const char* progName)
         fontDpi, fontExportFormat, fontSize, fontRenderer,
         hinting,
         imageFormat,
-        imageMaxCount, imageMaxSize, imageSizeMode);
+        imageMaxCount, imageMaxSize, imageSizeMode,
+        kerningFormat,
+        kerningUnits,
+        strikes);
 
     std::printf("Font export formats (-font-export-format):\n");
     listPlugins<FontWriter>();
@@ -261,6 +336,13 @@ static bool parseIntArray(
 }
 
 
+// Flags take no argument.
+static void getValue(char**&, char**, bool& var)
+{
+    var = true;
+}
+
+
 template<std::size_t N>
 void getValue(char**& cursor, char** optArgsEnd, int (&var)[N])
 {
@@ -328,6 +410,7 @@ void parse(int argc, char* argv[])
     auto** optArgsEnd = argv + (argc - numPositionalArgs);
     for (auto** cursor = argv + 1; cursor < optArgsEnd; ++cursor) {
         OPT(codePoints);
+        OPT(compareRenderers);
         OPT(fontDpi);
         OPT(fontExportFormat);
         OPT(fontExportName);
@@ -344,7 +427,19 @@ void parse(int argc, char* argv[])
         OPT(imagePadding);
         OPT(imageSizeMode);
         OPT(kerning);
+        OPT(kerningCorpus);
+        OPT(kerningFormat);
+        OPT(kerningLang);
+        OPT(kerningMaxPairs);
+        OPT(kerningMinAmount);
+        OPT(kerningScript);
+        OPT(kerningUnits);
         OPT(outDir);
+        OPT(profileGlyphs);
+        OPT(stats);
+        OPT(statsJson);
+        OPT(strikes);
+        OPT(trace);
 
         std::fprintf(stderr, "Unknown option %s\n", *cursor);
         std::exit(EXIT_FAILURE);
@@ -9,10 +9,11 @@ namespace args {
 extern const char* fontPath;
 
 extern const char* codePoints;
+extern bool compareRenderers;
 extern int fontDpi;
 extern const char* fontExportFormat;
 extern const char* fontExportName;
-extern int fontIndex;
+extern const char* fontIndex;
 extern const char* fontRenderer;
 extern int fontSize;
 extern int glyphPaddingInner[4];
@@ -25,7 +26,19 @@ extern int imageMaxSize;
 extern int imagePadding[4];
 extern const char* imageSizeMode;
 extern const char* kerning;
+extern const char* kerningCorpus;
+extern const char* kerningFormat;
+extern const char* kerningLang;
+extern int kerningMaxPairs;
+extern int kerningMinAmount;
+extern const char* kerningScript;
+extern const char* kerningUnits;
 extern const char* outDir;
+extern int profileGlyphs;
+extern bool stats;
+extern const char* statsJson;
+extern const char* strikes;
+extern const char* trace;
 
 
 void parse(int argc, char* argv[]);
@@ -0,0 +1,152 @@
+
+#include "baking_stats.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/resource.h>
+#endif
+
+
+namespace dpfb {
+
+
+const char* getBakingStageName(BakingStage stage)
+{
+    switch (stage) {
+        case BakingStage::load:
+            return "load";
+        case BakingStage::sfnt:
+            return "sfnt";
+        case BakingStage::glyphs:
+            return "glyphs";
+        case BakingStage::pack:
+            return "pack";
+        case BakingStage::name:
+            return "name";
+        case BakingStage::kerning:
+            return "kerning";
+        case BakingStage::render:
+            return "render";
+        case BakingStage::images:
+            return "images";
+        case BakingStage::fontFile:
+            return "font_file";
+    }
+
+    assert(false);
+    return "";
+}
+
+
+BakingStageStats& BakingStageStats::operator+=(
+    const BakingStageStats& other)
+{
+    timeNs += other.timeNs;
+    peakRssKib = std::max(peakRssKib, other.peakRssKib);
+    io += other.io;
+    return *this;
+}
+
+
+BakingStageStats& BakingStats::operator[](BakingStage stage)
+{
+    const auto stageIdx = static_cast<std::size_t>(stage);
+    assert(stageIdx < numBakingStages);
+    return stages[stageIdx];
+}
+
+
+const BakingStageStats& BakingStats::operator[](BakingStage stage) const
+{
+    const auto stageIdx = static_cast<std::size_t>(stage);
+    assert(stageIdx < numBakingStages);
+    return stages[stageIdx];
+}
+
+
+BakingStageStats BakingStats::getTotal() const
+{
+    BakingStageStats total {};
+    for (const auto& stageStats : stages)
+        total += stageStats;
+    return total;
+}
+
+
+std::uint64_t getPeakRssKib()
+{
+    #if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+    #ifdef __APPLE__
+    // Bytes on macOS
+    return usage.ru_maxrss / 1024;
+    #else
+    return usage.ru_maxrss;
+    #endif
+
+    #else
+    return 0;
+    #endif
+}
+
+
+static thread_local BakingStageScope* currentScope;
+
+
+static streams::StreamStats* getIoStats(
+    BakingStats* stats, BakingStage stage)
+{
+    return stats ? &(*stats)[stage].io : nullptr;
+}
+
+
+BakingStageScope::BakingStageScope(BakingStats* stats, BakingStage stage)
+    : stats {stats}
+    , stage {stage}
+    , outerScope {currentScope}
+    , startTime {}
+    , ioScope {getIoStats(stats, stage)}
+{
+    if (!stats)
+        return;
+
+    startTime = Clock::now();
+    if (outerScope)
+        outerScope->addTime(startTime);
+
+    currentScope = this;
+}
+
+
+BakingStageScope::~BakingStageScope()
+{
+    if (!stats)
+        return;
+
+    const auto now = Clock::now();
+    addTime(now);
+
+    auto& stageStats = (*stats)[stage];
+    stageStats.peakRssKib = std::max(
+        stageStats.peakRssKib, getPeakRssKib());
+
+    currentScope = outerScope;
+    if (outerScope)
+        outerScope->startTime = now;
+}
+
+
+void BakingStageScope::addTime(Clock::time_point now)
+{
+    (*stats)[stage].timeNs += std::chrono::duration_cast<
+        std::chrono::nanoseconds>(now - startTime).count();
+    startTime = now;
+}
+
+
+}
@@ -0,0 +1,107 @@
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "streams/stream_stats.h"
+
+
+namespace dpfb {
+
+
+enum class BakingStage {
+    // Reading the font file
+    load,
+    // Parsing the sfnt header and the head, OS/2, and maxp tables
+    sfnt,
+    // Creating the font renderer and loading glyphs
+    glyphs,
+    // Packing glyphs to pages
+    pack,
+    // Reading the name table
+    name,
+    // Reading and processing kerning
+    kerning,
+    // Rendering glyphs to page images
+    render,
+    // Encoding and writing the images
+    images,
+    // Writing the font file
+    fontFile
+};
+
+
+const std::size_t numBakingStages = 9;
+
+
+const char* getBakingStageName(BakingStage stage);
+
+
+struct BakingStageStats {
+    // Wall time of the stage, excluding nested stages.
+    std::uint64_t timeNs;
+    // Peak resident set size of the process at the end of the stage;
+    // 0 if unknown. The value is for the whole process, so it also
+    // includes fonts baked in parallel.
+    std::uint64_t peakRssKib;
+    streams::StreamStats io;
+
+    BakingStageStats& operator+=(const BakingStageStats& other);
+};
+
+
+/**
+ * Statistics of baking a single font, by stage.
+ */
+struct BakingStats {
+    BakingStageStats stages[numBakingStages];
+    std::size_t numGlyphs;
+
+    BakingStageStats& operator[](BakingStage stage);
+    const BakingStageStats& operator[](BakingStage stage) const;
+
+    /**
+     * Return the sum of all stages; peakRssKib is the maximum.
+     */
+    BakingStageStats getTotal() const;
+};
+
+
+/**
+ * Return the peak resident set size of the process in KiB, or 0 if
+ * it's not supported on this platform.
+ */
+std::uint64_t getPeakRssKib();
+
+
+/**
+ * Attribute the time and stream I/O of the current thread to the
+ * given stage till the end of the scope.
+ *
+ * Scopes can be nested: the enclosing stage's timer is paused while
+ * the nested scope is active, so the stage times add up to the total
+ * time. If stats is nullptr, the scope only disables I/O counting.
+ */
+class BakingStageScope {
+public:
+    BakingStageScope(BakingStats* stats, BakingStage stage);
+    ~BakingStageScope();
+
+    BakingStageScope(const BakingStageScope& other) = delete;
+    BakingStageScope& operator=(const BakingStageScope& other) = delete;
+private:
+    using Clock = std::chrono::steady_clock;
+
+    BakingStats* stats;
+    BakingStage stage;
+    BakingStageScope* outerScope;
+    Clock::time_point startTime;
+    streams::StreamStatsScope ioScope;
+
+    void addTime(Clock::time_point now);
+};
+
+
+}
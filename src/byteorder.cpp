@@ -0,0 +1,97 @@
+
+#include "byteorder.h"
+
+
+#if defined(__SSE2__) \
+        || defined(_M_X64) \
+        || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define DPFB_BYTEORDER_SSE2
+    #include <emmintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) \
+        && !defined(__ARM_BIG_ENDIAN)
+    #define DPFB_BYTEORDER_NEON
+    #include <arm_neon.h>
+#endif
+
+
+namespace dpfb {
+namespace byteorder {
+
+
+void copyFromBeScalar(
+    const void* src, std::uint16_t* dst, std::size_t count)
+{
+    const auto* s = static_cast<const std::uint8_t*>(src);
+    for (std::size_t i = 0; i < count; ++i, s += 2)
+        dst[i] = (s[0] << 8) | s[1];
+}
+
+
+void copyFromBeScalar(
+    const void* src, std::uint32_t* dst, std::size_t count)
+{
+    const auto* s = static_cast<const std::uint8_t*>(src);
+    for (std::size_t i = 0; i < count; ++i, s += 4)
+        dst[i] = (
+            (static_cast<std::uint32_t>(s[0]) << 24)
+            | (static_cast<std::uint32_t>(s[1]) << 16)
+            | (static_cast<std::uint32_t>(s[2]) << 8)
+            | s[3]);
+}
+
+
+// The vector loops load a whole vector before storing it, so the
+// in-place conversion is safe.
+
+
+void copyFromBe(const void* src, std::uint16_t* dst, std::size_t count)
+{
+    const auto* s = static_cast<const std::uint8_t*>(src);
+    std::size_t i = 0;
+
+    #if defined(DPFB_BYTEORDER_SSE2)
+    for (; i + 8 <= count; i += 8) {
+        const auto v = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(s + i * 2));
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i*>(dst + i),
+            _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+    }
+    #elif defined(DPFB_BYTEORDER_NEON)
+    for (; i + 8 <= count; i += 8)
+        vst1q_u16(
+            dst + i, vreinterpretq_u16_u8(vrev16q_u8(vld1q_u8(s + i * 2))));
+    #endif
+
+    copyFromBeScalar(s + i * 2, dst + i, count - i);
+}
+
+
+void copyFromBe(const void* src, std::uint32_t* dst, std::size_t count)
+{
+    const auto* s = static_cast<const std::uint8_t*>(src);
+    std::size_t i = 0;
+
+    #if defined(DPFB_BYTEORDER_SSE2)
+    // SSE2 has no byte shuffle, so swap bytes in 16-bit words and
+    // then the words.
+    for (; i + 4 <= count; i += 4) {
+        auto v = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(s + i * 4));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    }
+    #elif defined(DPFB_BYTEORDER_NEON)
+    for (; i + 4 <= count; i += 4)
+        vst1q_u32(
+            dst + i, vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(s + i * 4))));
+    #endif
+
+    copyFromBeScalar(s + i * 4, dst + i, count - i);
+}
+
+
+}
+}
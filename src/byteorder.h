@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 
@@ -93,5 +94,28 @@ inline T fromBe(T t)
 }
 
 
+/**
+ * Convert an array of big-endian values to native byte order.
+ *
+ * src doesn't need to be aligned. It can be the same as dst for
+ * in-place conversion, but the arrays must not overlap otherwise.
+ * SSE2 or NEON is used when available.
+ */
+void copyFromBe(const void* src, std::uint16_t* dst, std::size_t count);
+void copyFromBe(const void* src, std::uint32_t* dst, std::size_t count);
+
+
+/**
+ * Scalar versions of copyFromBe().
+ *
+ * These are used by copyFromBe() for the remainder of the array
+ * that doesn't fill a vector.
+ */
+void copyFromBeScalar(
+    const void* src, std::uint16_t* dst, std::size_t count);
+void copyFromBeScalar(
+    const void* src, std::uint32_t* dst, std::size_t count);
+
+
 }
 }
@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cinttypes>
 #include <cmath>
 
@@ -11,6 +12,7 @@
 #include "kerning.h"
 #include "str.h"
 #include "streams/file_stream.h"
+#include "trace.h"
 #include "unicode.h"
 
 
@@ -20,44 +22,62 @@ namespace dpfb {
 using namespace streams;
 
 
-static std::vector<std::uint8_t> getData(const std::string& fileName)
+FontData loadFontData(const std::string& fontPath)
 {
-    FileStream f(fileName, "rb");
-    std::vector<std::uint8_t> data;
-    data.resize(f.getSize());
-    f.readBuffer(&data[0], data.size());
+    FileStream f(fontPath, "rb");
+    std::shared_ptr<std::vector<std::uint8_t>> data(
+        new std::vector<std::uint8_t>());
+    data->resize(f.getSize());
+    f.readBuffer(&(*data)[0], data->size());
     return data;
 }
 
 
+static SfntOffsetTable readSfntOffsetTable(
+    const SpanReader& fontReader, int fontIndex, BakingStats* stats)
+{
+    const BakingStageScope stageScope(stats, BakingStage::sfnt);
+    return {fontReader, static_cast<std::uint32_t>(std::max(0, fontIndex))};
+}
+
+
 Font::Font(
         const FontBakingOptions& options,
-        const cp_range::CpRangeList& cpRangeList)
+        const cp_range::CpRangeList& cpRangeList,
+        const FontData& fontData,
+        BakingStats* stats,
+        GlyphProfile* glyphProfile)
     : bakingOptions {options}
-    , fontData {getData(options.fontPath)}
-    , fontStream {&fontData[0], fontData.size()}
+    , fontData {fontData}
+    , fontReader {&(*fontData)[0], fontData->size()}
     , sfntOffsetTable {
-        fontStream,
-        static_cast<std::uint32_t>(
-            std::max(0, bakingOptions.fontIndex)),
-    }
+        readSfntOffsetTable(fontReader, bakingOptions.fontIndex, stats)}
     , renderer {}
     , head {}
     , hasOs2 {}
     , os2 {}
+    , numGlyphs {}
     , fontName {}
     , pages {}
     , glyphsOrder {}
     , glyphs {}
+    , numBitmapGlyphs {}
     , kerningPairs {}
+    , kerningClassTables {}
+    , kerningDeltas {}
+    , numDroppedKerningPairs {}
 {
     validateBakingOptions();
 
+    const BakingStageScope glyphsScope(stats, BakingStage::glyphs);
+
     const FontRendererArgs args {
-        &fontData[0],
-        fontData.size(),
+        &(*fontData)[0],
+        fontData->size(),
+        bakingOptions.fontIndex,
         bakingOptions.fontPxSize,
-        bakingOptions.hinting
+        bakingOptions.hinting,
+        bakingOptions.bitmapStrikes
     };
 
     try {
@@ -70,44 +90,36 @@ Font::Font(
             bakingOptions.fontRenderer.c_str(), e.what()));
     }
 
-    uploadGlyphs(cpRangeList);
-    packGlyphs();
+    uploadGlyphs(cpRangeList, glyphProfile);
 
-    readHead();
-    readOs2();
+    {
+        const BakingStageScope stageScope(stats, BakingStage::pack);
+        packGlyphs();
+    }
 
-    readFontName();
+    {
+        const BakingStageScope stageScope(stats, BakingStage::sfnt);
+        readHead();
+        readOs2();
+        readMaxp();
+    }
 
-    // readKerningPairs() must be called after uploadGlyphs(), since
-    // we will need to convert glyph indices back to code points.
-    readKerningPairs();
+    {
+        const BakingStageScope stageScope(stats, BakingStage::name);
+        readFontName();
+    }
 
-    struct CmpKerningPairsByCp {
-        bool operator()(const KerningPair& a, const KerningPair& b) const
-        {
-            if (a.cp1 != b.cp1)
-                return a.cp1 < b.cp1;
-            else
-                return a.cp2 < b.cp2;
-        }
-    };
-    // Stable sort because we need to keep only the first added pair
-    // in case of duplicates.
-    std::stable_sort(
-        kerningPairs.begin(), kerningPairs.end(), CmpKerningPairsByCp());
+    {
+        const BakingStageScope stageScope(stats, BakingStage::kerning);
 
-    struct KerningPairsEqualByCp {
-        bool operator()(const KerningPair& a, const KerningPair& b) const
-        {
-            return a.cp1 == b.cp1 && a.cp2 == b.cp2;
-        }
-    };
-    kerningPairs.erase(
-        std::unique(
-            kerningPairs.begin(),
-            kerningPairs.end(),
-            KerningPairsEqualByCp()),
-        kerningPairs.end());
+        // readKerningPairs() must be called after uploadGlyphs(), since
+        // we will need to convert glyph indices back to code points.
+        readKerningPairs();
+
+        sortKerningPairsUnique(kerningPairs);
+        if (isKerningBudgetSet(bakingOptions.kerningBudget))
+            applyKerningBudget();
+    }
 
     sortGlyphs(GlyphsOrder::cp);
     for (std::size_t i = 0; i < glyphs.size(); ++i)
@@ -159,6 +171,18 @@ FontMetrics Font::getFontMetrics() const
 }
 
 
+std::vector<int> Font::getStrikeSizes() const
+{
+    return renderer->getStrikeSizes();
+}
+
+
+std::size_t Font::getNumBitmapGlyphs() const
+{
+    return numBitmapGlyphs;
+}
+
+
 const std::vector<Glyph>& Font::getGlyphs() const
 {
     return glyphs;
@@ -171,6 +195,30 @@ const std::vector<KerningPair>& Font::getKerningPairs() const
 }
 
 
+const std::vector<KerningClassTable>& Font::getKerningClassTables() const
+{
+    return kerningClassTables;
+}
+
+
+const std::vector<KerningDelta>& Font::getKerningDeltas() const
+{
+    return kerningDeltas;
+}
+
+
+int Font::getUnitsPerEm() const
+{
+    return head.unitsPerEm;
+}
+
+
+std::size_t Font::getNumDroppedKerningPairs() const
+{
+    return numDroppedKerningPairs;
+}
+
+
 const std::vector<Page>& Font::getPages() const
 {
     return pages;
@@ -246,6 +294,14 @@ void Font::validateBakingOptions() const
     if (bakingOptions.glyphSpacing.x < 0
             || bakingOptions.glyphSpacing.y < 0)
         throw FontError("Glyph spacing should be >= 0");
+
+    if (bakingOptions.kerningBudget.minAmount < 0)
+        throw FontError("Kerning min amount should be >= 0");
+
+    if (isKerningBudgetSet(bakingOptions.kerningBudget)
+            && bakingOptions.kerningFormat == KerningFormat::classes)
+        throw FontError(
+            "Kerning budget can't be used with class-based kerning");
 }
 
 
@@ -280,21 +336,15 @@ void Font::sortGlyphs(GlyphsOrder newOrder)
             };
             std::sort(glyphs.begin(), glyphs.end(), CmpGlyphsByCp());
             break;
-        case GlyphsOrder::glyphIdx:
-            struct CmpGlyphsByGlyphIdx {
-                bool operator()(const Glyph& a, const Glyph& b) const
-                {
-                    return a.glyphIdx < b.glyphIdx;
-                }
-            };
-            std::sort(glyphs.begin(), glyphs.end(), CmpGlyphsByGlyphIdx());
-            break;
     };
 }
 
 
-void Font::uploadGlyphs(const cp_range::CpRangeList& cpRangeList)
+void Font::uploadGlyphs(
+    const cp_range::CpRangeList& cpRangeList, GlyphProfile* glyphProfile)
 {
+    const trace::Span span("upload glyphs", "glyphs");
+
     // Font::getFontMetrics() returns metrics adjusted according to
     // the inner padding. We need original metrics, so get them
     // directly from the renderer.
@@ -306,8 +356,21 @@ void Font::uploadGlyphs(const cp_range::CpRangeList& cpRangeList)
             if (glyphIdx == 0 && cp != 0)
                 continue;
 
+            using Clock = std::chrono::steady_clock;
+            const auto metricsStartTime = (
+                glyphProfile ? Clock::now() : Clock::time_point());
+
             const auto glyphMetrics = renderer->getGlyphMetrics(glyphIdx);
 
+            if (glyphProfile)
+                glyphProfile->addMetricsTime(
+                    cp,
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        Clock::now() - metricsStartTime).count());
+
+            if (glyphMetrics.isBitmap)
+                ++numBitmapGlyphs;
+
             Glyph glyph;
             glyph.cp = cp;
             glyph.glyphIdx = glyphIdx;
@@ -347,6 +410,8 @@ void Font::uploadGlyphs(const cp_range::CpRangeList& cpRangeList)
 
 void Font::packGlyphs()
 {
+    trace::Span span("pack glyphs", "pack");
+
     sortGlyphs(GlyphsOrder::sizeDescending);
 
     using Packer = dp::rect_pack::RectPacker<>;
@@ -394,6 +459,9 @@ void Font::packGlyphs()
         packer.getPageSize(i, page.size.w, page.size.h);
         pages.push_back(page);
     }
+
+    span.addArg("glyphs", glyphs.size());
+    span.addArg("pages", pages.size());
 }
 
 
@@ -406,7 +474,7 @@ void Font::readHead()
         // "head" is a required table:
         throw StreamError("Font has no \"head\" table");
 
-    fontStream.seek(
+    fontReader.seek(
         tableOffset +
         // majorVersion, minorVersion
         + 2 * sizeof(std::uint16_t)
@@ -415,17 +483,35 @@ void Font::readHead()
         // Flags
         + sizeof(std::uint16_t),
         SeekOrigin::set);
-    head.unitsPerEm = fontStream.readU16Be();
+    head.unitsPerEm = fontReader.readU16Be();
     if (head.unitsPerEm == 0)
         throw StreamError("unitsPerEm in \"head\" table is 0");
 
-    fontStream.seek(
+    fontReader.seek(
         // Created and modified date
         2 * sizeof(std::uint64_t)
         // xMin, yMin, xMax, yMax
         + 4 * sizeof(std::uint16_t),
         SeekOrigin::cur);
-    head.macStyle = fontStream.readU16Be();
+    head.macStyle = fontReader.readU16Be();
+}
+
+
+// https://docs.microsoft.com/en-us/typography/opentype/spec/maxp
+void Font::readMaxp()
+{
+    const auto tableOffset = sfntOffsetTable.getTableOffset(
+        sfntTag('m', 'a', 'x', 'p'));
+    if (tableOffset == 0)
+        // "maxp" is a required table:
+        throw StreamError("Font has no \"maxp\" table");
+
+    fontReader.seek(
+        tableOffset
+        // version
+        + sizeof(std::uint32_t),
+        SeekOrigin::set);
+    numGlyphs = fontReader.readU16Be();
 }
 
 
@@ -439,7 +525,7 @@ void Font::readOs2()
         // "OS/2" is optional for Mac fonts
         return;
 
-    fontStream.seek(
+    fontReader.seek(
         tableOffset +
         // version
         + sizeof(std::int16_t)
@@ -487,13 +573,15 @@ void Font::readOs2()
         + sizeof(std::uint8_t[4]),
         SeekOrigin::set);
 
-    os2.fsSelection = fontStream.readU16Be();
+    os2.fsSelection = fontReader.readU16Be();
 }
 
 
 // https://www.microsoft.com/typography/otspec/name.htm
 void Font::readFontName()
 {
+    const trace::Span span("read name", "name");
+
     const std::uint16_t platformIdWin = 3;
     const std::uint16_t languageIdWinEnglishUs = 0x0409;
     const std::uint16_t encodingIdWinUcs2 = 1;
@@ -504,26 +592,26 @@ void Font::readFontName()
         // "name" is a required table.
         throw FontError("Font has no \"name\" table");
 
-    fontStream.seek(tableOffset, SeekOrigin::set);
+    fontReader.seek(tableOffset, SeekOrigin::set);
 
-    const auto format = fontStream.readU16Be();
+    const auto format = fontReader.readU16Be();
     if (format != 0 && format != 1)
         throw FontError("Invalid \"name\" table format");
 
-    auto count = fontStream.readU16Be();
+    auto count = fontReader.readU16Be();
     if (count == 0)
         throw FontError("\"name\" table has no records");
 
-    const auto stringsOffset = fontStream.readU16Be();
+    const auto stringsOffset = fontReader.readU16Be();
     const auto storageOffset = tableOffset + stringsOffset;
 
     while (count--) {
-        const auto platformId = fontStream.readU16Be();
-        const auto encodingId = fontStream.readU16Be();
-        const auto languageId = fontStream.readU16Be();
-        const auto nameId = fontStream.readU16Be();
-        const auto strByteLen = fontStream.readU16Be();
-        const auto strOffset = fontStream.readU16Be();
+        const auto platformId = fontReader.readU16Be();
+        const auto encodingId = fontReader.readU16Be();
+        const auto languageId = fontReader.readU16Be();
+        const auto nameId = fontReader.readU16Be();
+        const auto strByteLen = fontReader.readU16Be();
+        const auto strOffset = fontReader.readU16Be();
 
         // We rely on the fact that name records are sorted.
         if (platformId < platformIdWin
@@ -556,18 +644,18 @@ void Font::readFontName()
                 break;
         }
 
-        const auto pos = fontStream.getPosition();
-        fontStream.seek(storageOffset + strOffset, SeekOrigin::set);
+        const auto pos = fontReader.getPosition();
+        fontReader.seek(storageOffset + strOffset, SeekOrigin::set);
 
         std::vector<char16_t> utf16Name;
         utf16Name.resize(strByteLen / 2);
         for (auto& ch : utf16Name)
-            ch = fontStream.readU16Be();
+            ch = fontReader.readU16Be();
 
         *dst = unicode::utf16ToUtf8(
             utf16Name.data(), utf16Name.data() + utf16Name.size());
 
-        fontStream.seek(pos, SeekOrigin::set);
+        fontReader.seek(pos, SeekOrigin::set);
     }
 
     // Fallback from id 16 to id 1. No need to do the same for
@@ -578,89 +666,192 @@ void Font::readFontName()
 }
 
 
-char32_t Font::glyphIdxToCp(GlyphIndex glyphIdx) const
+Font::GlyphCpTable Font::createGlyphCpTable() const
 {
-    assert(glyphsOrder == GlyphsOrder::glyphIdx);
-
-    struct CmpGlyphIdx {
-        bool operator()(
-            const Glyph& a, const GlyphIndex& glyphIdx) const
-        {
-            return a.glyphIdx < glyphIdx;
-        }
-    };
-
-    const auto iter = std::lower_bound(
-        glyphs.begin(), glyphs.end(), glyphIdx, CmpGlyphIdx());
-    if (iter != glyphs.end() && iter->glyphIdx == glyphIdx)
-        return iter->cp;
-
-    return 0;
+    // Renderers should not return indices >= numGlyphs, but we
+    // don't rely on that.
+    std::size_t tableSize = numGlyphs;
+    for (const auto& glyph : glyphs)
+        if (glyph.glyphIdx >= tableSize)
+            tableSize = glyph.glyphIdx + 1;
+
+    GlyphCpTable table;
+
+    // Counting sort: count code points of every glyph, convert
+    // the counts to offsets, and then fill the code points.
+    // Code point 0 is skipped since it's always mapped to .notdef,
+    // which has no kerning.
+    table.offsets.assign(tableSize + 1, 0);
+    for (const auto& glyph : glyphs)
+        if (glyph.cp != 0)
+            ++table.offsets[glyph.glyphIdx + 1];
+
+    for (std::size_t i = 1; i < table.offsets.size(); ++i)
+        table.offsets[i] += table.offsets[i - 1];
+
+    table.cps.resize(table.offsets.back());
+    auto positions = table.offsets;
+    for (const auto& glyph : glyphs)
+        if (glyph.cp != 0)
+            table.cps[positions[glyph.glyphIdx]++] = glyph.cp;
+
+    return table;
 }
 
 
 void Font::readKerningPairs()
 {
+    const trace::Span span("read kerning", "kerning");
+
     const KerningParams kerningParams {
         bakingOptions.fontPxSize,
-        head.unitsPerEm
+        head.unitsPerEm,
+        bakingOptions.kerningUnits,
+        bakingOptions.kerningScope
     };
 
+    const auto glyphCpTable = createGlyphCpTable();
+    const auto& offsets = glyphCpTable.offsets;
+    const auto& cps = glyphCpTable.cps;
+    const auto numGlyphIndices = offsets.size() - 1;
+
+    // Don't let the readers produce pairs for glyphs we don't bake.
+    GlyphSet glyphSet(numGlyphIndices);
+    for (std::size_t i = 0; i < numGlyphIndices; ++i)
+        glyphSet[i] = offsets[i] != offsets[i + 1];
+
     std::vector<RawKerningPair> rawKerningPairs;
+    std::vector<RawKerningClassTable> rawClassTables;
+    std::vector<RawKerningDelta> rawDeltas;
+    bool hasGposKerning = false;
     if (bakingOptions.kerningSource == KerningSource::gpos
             || bakingOptions.kerningSource == KerningSource::kernAndGpos)
         rawKerningPairs = readKerningPairsGpos(
-            fontStream, sfntOffsetTable, kerningParams);
+            fontReader,
+            sfntOffsetTable,
+            kerningParams,
+            &glyphSet,
+            bakingOptions.kerningFormat == KerningFormat::classes
+                ? &rawClassTables : nullptr,
+            &rawDeltas,
+            &hasGposKerning,
+            bakingOptions.maxThreads);
 
     // According to the OpenType manual, the "kern" table should be
     // applied when there is no GPOS table, or if the GPOS table doesn't
     // contain any "kern" features for the resolved language.
     // https://docs.microsoft.com/en-us/typography/opentype/spec/recom
+    //
+    // This is about the font, so the result for the baked glyphs
+    // can't be used here: it's empty if GPOS doesn't kern them.
     if (bakingOptions.kerningSource == KerningSource::kern
             || (bakingOptions.kerningSource == KerningSource::kernAndGpos
-                && rawKerningPairs.empty()))
+                && !hasGposKerning))
         rawKerningPairs = readKerningPairsKern(
-            fontStream, sfntOffsetTable, kerningParams);
-    if (rawKerningPairs.empty())
-        return;
+            fontReader, sfntOffsetTable, kerningParams, &glyphSet);
+
+    const auto getKerningClassEntries = [&](
+        const std::vector<RawGlyphClass>& glyphClasses)
+    {
+        std::vector<KerningClassEntry> entries;
+        for (const auto& glyphClass : glyphClasses) {
+            const auto glyphIdx = glyphClass.glyphIdx;
+            if (glyphIdx >= numGlyphIndices)
+                continue;
+
+            for (auto j = offsets[glyphIdx]; j < offsets[glyphIdx + 1]; ++j)
+                entries.push_back({cps[j], glyphClass.glyphClass});
+        }
 
-    // Prepare for binary search
-    sortGlyphs(GlyphsOrder::glyphIdx);
+        std::sort(
+            entries.begin(), entries.end(),
+            [](const KerningClassEntry& a, const KerningClassEntry& b)
+            {
+                return a.cp < b.cp;
+            });
 
-    std::size_t i = 0;
-    while (i < rawKerningPairs.size()) {
-        const auto& rawKerningPair = rawKerningPairs[i];
+        return entries;
+    };
 
-        assert(rawKerningPair.amount != 0);
+    kerningClassTables.reserve(rawClassTables.size());
+    for (const auto& rawClassTable : rawClassTables) {
+        KerningClassTable classTable;
+        classTable.leftClasses = getKerningClassEntries(
+            rawClassTable.glyphClasses1);
+        classTable.rightClasses = getKerningClassEntries(
+            rawClassTable.glyphClasses2);
+        if (classTable.leftClasses.empty()
+                || classTable.rightClasses.empty())
+            continue;
 
-        const auto glyphIdx1 = rawKerningPair.glyphIdx1;
-        const auto cp1 = glyphIdxToCp(glyphIdx1);
-
-        // The raw pairs are grouped by the first glyph index (but
-        // not necessarily fully sorted in case of GPOS as we read
-        // pairs for multiple languages), so we can avoid calling
-        // glyphIdxToCp() every time for the first code point in a
-        // sequence.
-        while (i < rawKerningPairs.size()) {
-            const auto& rawKerningPair = rawKerningPairs[i];
-            if (rawKerningPair.glyphIdx1 != glyphIdx1)
-                break;
+        classTable.numLeftClasses = rawClassTable.numClasses1;
+        classTable.numRightClasses = rawClassTable.numClasses2;
+        classTable.amounts = rawClassTable.amounts;
 
-            ++i;
+        kerningClassTables.push_back(std::move(classTable));
+    }
 
-            assert(rawKerningPair.amount != 0);
+    for (const auto& rawKerningPair : rawKerningPairs) {
+        assert(rawKerningPair.amount != 0);
 
-            if (cp1 == 0)
-                continue;
+        const auto glyphIdx1 = rawKerningPair.glyphIdx1;
+        const auto glyphIdx2 = rawKerningPair.glyphIdx2;
+        if (glyphIdx1 >= numGlyphIndices || glyphIdx2 >= numGlyphIndices)
+            continue;
 
-            const auto cp2 = glyphIdxToCp(rawKerningPair.glyphIdx2);
-            if (cp2 == 0)
-                continue;
+        // A glyph can be mapped to several code points, so emit
+        // a pair for every combination.
+        for (auto j = offsets[glyphIdx1]; j < offsets[glyphIdx1 + 1]; ++j)
+            for (auto k = offsets[glyphIdx2];
+                    k < offsets[glyphIdx2 + 1]; ++k)
+                kerningPairs.push_back(
+                    {cps[j], cps[k], rawKerningPair.amount});
+    }
 
-            kerningPairs.push_back({cp1, cp2, rawKerningPair.amount});
-        }
+    for (const auto& rawDelta : rawDeltas) {
+        const auto glyphIdx1 = rawDelta.glyphIdx1;
+        const auto glyphIdx2 = rawDelta.glyphIdx2;
+        if (glyphIdx1 >= numGlyphIndices || glyphIdx2 >= numGlyphIndices)
+            continue;
+
+        for (auto j = offsets[glyphIdx1]; j < offsets[glyphIdx1 + 1]; ++j)
+            for (auto k = offsets[glyphIdx2];
+                    k < offsets[glyphIdx2 + 1]; ++k)
+                kerningDeltas.push_back(
+                    {cps[j], cps[k], rawDelta.pxSize, rawDelta.amount});
     }
+
+    // Like for pairs, keep only the first added delta in case of
+    // duplicates.
+    std::stable_sort(
+        kerningDeltas.begin(), kerningDeltas.end(),
+        [](const KerningDelta& a, const KerningDelta& b)
+        {
+            if (a.cp1 != b.cp1)
+                return a.cp1 < b.cp1;
+            else if (a.cp2 != b.cp2)
+                return a.cp2 < b.cp2;
+            else
+                return a.pxSize < b.pxSize;
+        });
+    kerningDeltas.erase(
+        std::unique(
+            kerningDeltas.begin(), kerningDeltas.end(),
+            [](const KerningDelta& a, const KerningDelta& b)
+            {
+                return (
+                    a.cp1 == b.cp1
+                    && a.cp2 == b.cp2
+                    && a.pxSize == b.pxSize);
+            }),
+        kerningDeltas.end());
 }
 
 
+void Font::applyKerningBudget()
+{
+    numDroppedKerningPairs = dpfb::applyKerningBudget(
+        kerningPairs, bakingOptions.kerningBudget, &kerningDeltas);
+}
+
 }
@@ -2,16 +2,20 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <stdexcept>
+#include <string>
 #include <vector>
-#include <memory>
 
+#include "baking_stats.h"
 #include "cp_range.h"
 #include "font_renderer/font_renderer.h"
 #include "geometry.h"
+#include "glyph_profile.h"
 #include "image.h"
+#include "kerning.h"
 #include "sfnt.h"
-#include "streams/const_mem_stream.h"
+#include "streams/span_reader.h"
 
 
 namespace dpfb {
@@ -25,18 +29,34 @@ enum class KerningSource {
 };
 
 
+enum class KerningFormat {
+    // Expand class-based kerning to pairs
+    pairs,
+    // Keep class-based kerning as class tables
+    classes
+};
+
+
 struct FontBakingOptions {
     std::string fontPath;
     std::string fontRenderer;
     int fontIndex;
     int fontPxSize;
     Hinting hinting;
+    BitmapStrikes bitmapStrikes;
     int imageMaxSize;
     Edge imagePadding;
     Edge glyphPaddingInner;
     Edge glyphPaddingOuter;
     Point glyphSpacing;
     KerningSource kerningSource;
+    KerningFormat kerningFormat;
+    KerningUnits kerningUnits;
+    KerningBudget kerningBudget;
+    KerningScope kerningScope;
+    // Maximum number of threads for reading kerning; 0 means the
+    // number of hardware threads.
+    unsigned maxThreads;
 };
 
 
@@ -88,48 +108,107 @@ struct Glyph {
 };
 
 
-struct KerningPair {
-    char32_t cp1;
-    char32_t cp2;
-    int amount;
-};
-
-
 class FontError : public std::runtime_error {
 public:
     using runtime_error::runtime_error;
 };
 
 
+/**
+ * Font file data.
+ *
+ * The data is shared so that fonts of a collection can be baked
+ * without reading the file several times.
+ */
+using FontData = std::shared_ptr<const std::vector<std::uint8_t>>;
+
+
+/**
+ * \throws streams::StreamError
+ */
+FontData loadFontData(const std::string& fontPath);
+
+
 class Font {
 public:
+    /**
+     * FontBakingOptions::fontPath is not used to load the font;
+     * fontData should be loaded from it by the caller.
+     *
+     * If stats is not nullptr, the time and stream I/O of the
+     * constructor are added to it by stage. If glyphProfile is not
+     * nullptr, times of getting glyph metrics are added to it.
+     */
     Font(
         const FontBakingOptions& options,
-        const cp_range::CpRangeList& cpRangeList);
+        const cp_range::CpRangeList& cpRangeList,
+        const FontData& fontData,
+        BakingStats* stats = nullptr,
+        GlyphProfile* glyphProfile = nullptr);
 
     const FontBakingOptions& getBakingOptions() const;
     StyleFlags getStyleFlags() const;
     const FontName& getFontName() const;
     FontMetrics getFontMetrics() const;
 
+    /**
+     * Pixel sizes of embedded bitmap strikes in the font.
+     *
+     * The list is empty if the font has no strikes or the renderer
+     * doesn't support them.
+     */
+    std::vector<int> getStrikeSizes() const;
+
+    /**
+     * Number of glyphs taken from an embedded bitmap strike rather
+     * than rendered from outlines.
+     */
+    std::size_t getNumBitmapGlyphs() const;
+
     const std::vector<Page>& getPages() const;
     const std::vector<Glyph>& getGlyphs() const;
     const std::vector<KerningPair>& getKerningPairs() const;
 
+    /**
+     * Class-based kerning.
+     *
+     * The tables are only created with KerningFormat::classes, in
+     * which case getKerningPairs() only returns the pairs that are
+     * not in the tables. Use expandKerningClasses() to get all pairs.
+     */
+    const std::vector<KerningClassTable>& getKerningClassTables() const;
+
+    /**
+     * Per-size kerning deltas, sorted by code points and size.
+     *
+     * Deltas are only created with KerningUnits::font. The kerning
+     * amount in pixels for a size is the amount in font units scaled
+     * by pxSize / getUnitsPerEm() and rounded, plus the delta for
+     * this pxSize, if any.
+     */
+    const std::vector<KerningDelta>& getKerningDeltas() const;
+
+    int getUnitsPerEm() const;
+
+    /**
+     * Number of kerning pairs removed due to
+     * FontBakingOptions::kerningBudget.
+     */
+    std::size_t getNumDroppedKerningPairs() const;
+
     void renderGlyph(
         GlyphIndex glyphIdx, Image& image) const;
 private:
     enum class GlyphsOrder {
         unsorted,
         sizeDescending,
-        cp,
-        glyphIdx
+        cp
     };
 
     FontBakingOptions bakingOptions;
 
-    std::vector<std::uint8_t> fontData;
-    streams::ConstMemStream fontStream;
+    FontData fontData;
+    streams::SpanReader fontReader;
 
     SfntOffsetTable sfntOffsetTable;
     std::unique_ptr<FontRenderer> renderer;
@@ -159,27 +238,49 @@ private:
     bool hasOs2;
     Os2 os2;
 
+    std::uint16_t numGlyphs;
+
     FontName fontName;
 
     std::vector<Page> pages;
     GlyphsOrder glyphsOrder;
     std::vector<Glyph> glyphs;
+    std::size_t numBitmapGlyphs;
     std::vector<KerningPair> kerningPairs;
+    std::vector<KerningClassTable> kerningClassTables;
+    std::vector<KerningDelta> kerningDeltas;
+    std::size_t numDroppedKerningPairs;
 
     void validateBakingOptions() const;
     void uploadFontData();
 
     void sortGlyphs(GlyphsOrder newOrder);
-    void uploadGlyphs(const cp_range::CpRangeList& cpRangeList);
+    void uploadGlyphs(
+        const cp_range::CpRangeList& cpRangeList,
+        GlyphProfile* glyphProfile);
     void packGlyphs();
 
     void readHead();
     void readOs2();
+    void readMaxp();
 
     void readFontName();
 
-    char32_t glyphIdxToCp(GlyphIndex glyphIdx) const;
+    /**
+     * Code points of baked glyphs, indexed by glyph index.
+     *
+     * Code points of glyph i are cps[offsets[i]..offsets[i + 1]).
+     * A glyph may have several code points (like space and no-break
+     * space), or none if it's not baked.
+     */
+    struct GlyphCpTable {
+        std::vector<std::uint32_t> offsets;
+        std::vector<char32_t> cps;
+    };
+
+    GlyphCpTable createGlyphCpTable() const;
     void readKerningPairs();
+    void applyKerningBudget();
 };
 
 
@@ -37,17 +37,30 @@ CoreTextFontRenderer::CoreTextFontRenderer(
         throw dpfb::FontRendererError(
             "CFDataCreate for font data failed");
 
-    const auto descriptor = CTFontManagerCreateFontDescriptorFromData(
+    // Unlike CTFontManagerCreateFontDescriptorFromData(), this
+    // function returns descriptors for all fonts in a collection.
+    const auto descriptors = CTFontManagerCreateFontDescriptorsFromData(
         data);
     CFRelease(data);
 
-    if (!descriptor)
+    if (!descriptors)
         throw dpfb::FontRendererError(
-            "CTFontManagerCreateFontDescriptorFromData failed");
+            "CTFontManagerCreateFontDescriptorsFromData failed");
+
+    if (args.fontIndex >= CFArrayGetCount(descriptors)) {
+        CFRelease(descriptors);
+        throw dpfb::FontRendererError(
+            dpfb::str::format(
+                "Core Text can't find font at index %i",
+                args.fontIndex));
+    }
+
+    const auto descriptor = static_cast<CTFontDescriptorRef>(
+        CFArrayGetValueAtIndex(descriptors, args.fontIndex));
 
     font = CTFontCreateWithFontDescriptor(
         descriptor, args.pxSize, nullptr);
-    CFRelease(descriptor);
+    CFRelease(descriptors);
 
     if (!font)
         throw dpfb::FontRendererError(
@@ -97,6 +110,7 @@ dpfb::GlyphMetrics CoreTextFontRenderer::getGlyphMetrics(
     dpfb::GlyphIndex glyphIdx) const
 {
     dpfb::GlyphMetrics glyphMetrics;
+    glyphMetrics.isBitmap = false;
     const CGGlyph glyph = glyphIdx;
 
     CGSize advance;
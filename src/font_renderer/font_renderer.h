@@ -4,6 +4,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <stdexcept>
+#include <vector>
 
 #include "image.h"
 #include "geometry.h"
@@ -24,11 +25,31 @@ enum class Hinting {
 };
 
 
+enum class BitmapStrikes {
+    /**
+     * Use embedded bitmaps if the font has a strike of the
+     * requested size. Glyphs missing from the strike are rendered
+     * from outlines.
+     */
+    prefer,
+
+    /**
+     * Always render outlines.
+     */
+    ignore
+};
+
+
 struct FontRendererArgs {
     const std::uint8_t* data;
     std::size_t dataSize;
+    /**
+     * Index of the font in a collection (TTC or OTC).
+     */
+    int fontIndex;
     int pxSize;
     Hinting hinting;
+    BitmapStrikes bitmapStrikes;
 };
 
 
@@ -44,9 +65,10 @@ struct GlyphMetrics {
     /**
      * Offset from the origin.
      *
-     * This is the offset of the bottom left corner of the bitmap
-     * from the origin on the baseline. Like in FreeType, the y
-     * coordinate increases up.
+     * This is the offset of the top left corner of the bitmap from
+     * the origin on the baseline. Like in FreeType, the y coordinate
+     * increases up, so the bitmap spans from offset.y - size.h to
+     * offset.y.
      */
     Point offset;
 
@@ -54,6 +76,12 @@ struct GlyphMetrics {
      * X advance.
      */
     int advance;
+
+    /**
+     * Whether the glyph is taken from an embedded bitmap strike
+     * rather than rendered from the outline.
+     */
+    bool isBitmap;
 };
 
 
@@ -81,6 +109,17 @@ public:
 
     virtual FontMetrics getFontMetrics() const = 0;
 
+    /**
+     * Get pixel sizes of embedded bitmap strikes.
+     *
+     * The default implementation returns an empty list, which
+     * means that the renderer doesn't support strikes.
+     */
+    virtual std::vector<int> getStrikeSizes() const
+    {
+        return {};
+    }
+
     virtual GlyphIndex getGlyphIndex(char32_t cp) const = 0;
     virtual GlyphMetrics getGlyphMetrics(GlyphIndex glyphIdx) const = 0;
     virtual void renderGlyph(GlyphIndex glyphIdx, Image& image) const = 0;
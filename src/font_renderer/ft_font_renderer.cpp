@@ -2,14 +2,16 @@
 #if DPFB_USE_FREETYPE
 
 #include <algorithm>
-#include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <string>
+#include <vector>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_BITMAP_H
 #include FT_OUTLINE_H
 
 #include "font_renderer/font_renderer.h"
@@ -57,29 +59,18 @@ static std::string ftErrorToStr(FT_Error err)
 }
 
 
-static FT_Library library;
-static std::size_t libRefCount;
-
-
-static void refLib()
+// Every renderer has its own FT_Library, since FreeType objects
+// can't be shared between threads, and we may bake several fonts
+// in parallel.
+static FT_Library createLib()
 {
-    ++libRefCount;
-    if (libRefCount > 1)
-        return;
-
-    auto err = FT_Init_FreeType(&library);
+    FT_Library library;
+    const auto err = FT_Init_FreeType(&library);
     if (err != FT_Err_Ok)
         throw dpfb::FontRendererError(
             "Error initializing FreeType: " + ftErrorToStr(err));
-}
-
 
-static void unrefLib()
-{
-    assert(libRefCount > 0);
-    --libRefCount;
-    if (libRefCount == 0)
-        FT_Done_FreeType(library);
+    return library;
 }
 
 
@@ -89,6 +80,7 @@ public:
     ~FtFontRenderer();
 
     dpfb::FontMetrics getFontMetrics() const override;
+    std::vector<int> getStrikeSizes() const override;
 
     dpfb::GlyphIndex getGlyphIndex(char32_t cp) const override;
     dpfb::GlyphMetrics getGlyphMetrics(
@@ -96,48 +88,106 @@ public:
     void renderGlyph(
         dpfb::GlyphIndex glyphIdx, dpfb::Image& image) const override;
 private:
+    FT_Library library;
     FT_Face face;
     FT_UInt loadFlags;
+
+    void setSize(const dpfb::FontRendererArgs& args);
 };
 
 
 FtFontRenderer::FtFontRenderer(const dpfb::FontRendererArgs& args)
+    : library {createLib()}
 {
-    refLib();
-
     auto err = FT_New_Memory_Face(
-        library, args.data, args.dataSize, 0, &face);
+        library, args.data, args.dataSize, args.fontIndex, &face);
     if (err != FT_Err_Ok) {
-        unrefLib();
+        FT_Done_FreeType(library);
         throw dpfb::FontRendererError(
             dpfb::str::format(
                 "Can't open font: %s", ftErrorToStr(err).c_str()));
     }
 
     if (!face->charmap) {
-        FT_Done_Face(face);
-        unrefLib();
+        FT_Done_FreeType(library);
         throw dpfb::FontRendererError(
             "Font doesn't contain Unicode charmap");
     }
 
-    err = FT_Set_Char_Size(face, args.pxSize * 64, 0, 72, 0);
-    if (err != FT_Err_Ok) {
-        FT_Done_Face(face);
-        unrefLib();
-        throw dpfb::FontRendererError(ftErrorToStr(err));
-    }
-
     loadFlags = FT_LOAD_DEFAULT;
     if (args.hinting == dpfb::Hinting::light)
         loadFlags |= FT_LOAD_TARGET_LIGHT;
+
+    try {
+        setSize(args);
+    } catch (dpfb::FontRendererError&) {
+        FT_Done_FreeType(library);
+        throw;
+    }
+}
+
+
+static int getStrikePxSize(const FT_Bitmap_Size& strike)
+{
+    // y_ppem is in 26.6 format. Like FT_Match_Size(), round it
+    // to compare with integer pixel sizes.
+    return (strike.y_ppem + 32) >> 6;
+}
+
+
+void FtFontRenderer::setSize(const dpfb::FontRendererArgs& args)
+{
+    if (args.bitmapStrikes == dpfb::BitmapStrikes::prefer)
+        for (FT_Int i = 0; i < face->num_fixed_sizes; ++i) {
+            if (getStrikePxSize(face->available_sizes[i]) != args.pxSize)
+                continue;
+
+            // Unlike FT_Set_Char_Size(), FT_Select_Size() also works
+            // for fonts without outlines. Glyphs missing from the
+            // strike are still loaded from outlines, if any.
+            const auto err = FT_Select_Size(face, i);
+            if (err != FT_Err_Ok)
+                throw dpfb::FontRendererError(ftErrorToStr(err));
+
+            // Color strikes (CBDT, sbix) are only loaded with
+            // FT_LOAD_COLOR; we use their alpha channel.
+            loadFlags |= FT_LOAD_COLOR;
+            return;
+        }
+
+    if (!FT_IS_SCALABLE(face)) {
+        std::string sizes;
+        for (const auto size : getStrikeSizes()) {
+            if (!sizes.empty())
+                sizes += ", ";
+            sizes += std::to_string(size);
+        }
+
+        if (args.bitmapStrikes == dpfb::BitmapStrikes::ignore)
+            throw dpfb::FontRendererError(
+                "Font has no outlines, so bitmap strikes can't be "
+                "ignored");
+        else
+            throw dpfb::FontRendererError(
+                dpfb::str::format(
+                    "Font has no outlines and no bitmap strike of "
+                    "%i px; available strikes: %s",
+                    args.pxSize, sizes.c_str()));
+    }
+
+    const auto err = FT_Set_Char_Size(face, args.pxSize * 64, 0, 72, 0);
+    if (err != FT_Err_Ok)
+        throw dpfb::FontRendererError(ftErrorToStr(err));
+
+    if (args.bitmapStrikes == dpfb::BitmapStrikes::ignore)
+        loadFlags |= FT_LOAD_NO_BITMAP;
 }
 
 
 FtFontRenderer::~FtFontRenderer()
 {
     FT_Done_Face(face);
-    unrefLib();
+    FT_Done_FreeType(library);
 }
 
 
@@ -151,6 +201,19 @@ dpfb::FontMetrics FtFontRenderer::getFontMetrics() const
 }
 
 
+std::vector<int> FtFontRenderer::getStrikeSizes() const
+{
+    std::vector<int> result;
+    for (FT_Int i = 0; i < face->num_fixed_sizes; ++i)
+        result.push_back(getStrikePxSize(face->available_sizes[i]));
+
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+
+    return result;
+}
+
+
 dpfb::GlyphIndex FtFontRenderer::getGlyphIndex(char32_t cp) const
 {
     return FT_Get_Char_Index(face, cp);
@@ -187,8 +250,9 @@ dpfb::GlyphMetrics FtFontRenderer::getGlyphMetrics(
 
     dpfb::GlyphMetrics glyphMetrics;
     glyphMetrics.advance = face->glyph->advance.x >> 6;
+    glyphMetrics.isBitmap = face->glyph->format == FT_GLYPH_FORMAT_BITMAP;
 
-    if (face->glyph->format == FT_GLYPH_FORMAT_BITMAP) {
+    if (glyphMetrics.isBitmap) {
         // Embedded bitmap
         glyphMetrics.size.w = static_cast<int>(face->glyph->bitmap.width);
         glyphMetrics.size.h = static_cast<int>(face->glyph->bitmap.rows);
@@ -219,53 +283,141 @@ dpfb::GlyphMetrics FtFontRenderer::getGlyphMetrics(
 }
 
 
-void FtFontRenderer::renderGlyph(
-    dpfb::GlyphIndex glyphIdx, dpfb::Image& image) const
+// Convert a row of an embedded bitmap to 8-bit coverage.
+static void convertBitmapRow(
+    const FT_Bitmap& bitmap,
+    const std::uint8_t* src,
+    std::uint8_t* dst,
+    int w)
 {
-    auto err = FT_Load_Glyph(face, glyphIdx, loadFlags);
-    if (err != FT_Err_Ok)
-        throw dpfb::FontRendererError(
-            dpfb::str::format(
-                "Can't load glyph for %s: %s",
-                dpfb::unicode::cpToStr(idxToCp(face, glyphIdx)),
-                ftErrorToStr(err).c_str()));
+    switch (bitmap.pixel_mode) {
+        case FT_PIXEL_MODE_MONO:
+            for (int x = 0; x < w; ++x)
+                dst[x] = (src[x / 8] & (0x80 >> (x % 8))) ? 255 : 0;
+            break;
+        case FT_PIXEL_MODE_GRAY2:
+            for (int x = 0; x < w; ++x)
+                dst[x] = ((src[x / 4] >> (6 - x % 4 * 2)) & 0x3) * 85;
+            break;
+        case FT_PIXEL_MODE_GRAY4:
+            for (int x = 0; x < w; ++x)
+                dst[x] = ((src[x / 2] >> (4 - x % 2 * 4)) & 0xf) * 17;
+            break;
+        case FT_PIXEL_MODE_GRAY:
+            std::memcpy(dst, src, w);
+            break;
+        case FT_PIXEL_MODE_BGRA:
+            for (int x = 0; x < w; ++x)
+                dst[x] = src[x * 4 + 3];
+            break;
+    }
+}
 
-    err = FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL);
-    if (err != FT_Err_Ok)
-        throw dpfb::FontRendererError(
-            dpfb::str::format(
-                "Can't render glyph for %s: %s",
-                dpfb::unicode::cpToStr(idxToCp(face, glyphIdx)),
-                ftErrorToStr(err).c_str()));
 
-    const auto* bitmap = &face->glyph->bitmap;
+// Copy an embedded bitmap to the image.
+static void copyBitmap(const FT_Bitmap& bitmap, dpfb::Image& image)
+{
+    switch (bitmap.pixel_mode) {
+        case FT_PIXEL_MODE_MONO:
+        case FT_PIXEL_MODE_GRAY2:
+        case FT_PIXEL_MODE_GRAY4:
+        case FT_PIXEL_MODE_GRAY:
+        case FT_PIXEL_MODE_BGRA:
+            break;
+        default:
+            throw dpfb::FontRendererError(
+                dpfb::str::format(
+                    "Unsupported bitmap pixel mode %i",
+                    bitmap.pixel_mode));
+    }
 
-    const auto* src = bitmap->buffer;
-    const auto srcPitch = bitmap->pitch;
+    const auto* src = bitmap.buffer;
+    const auto srcPitch = bitmap.pitch;
 
-    if (bitmap->pitch < 0)
-        src += -bitmap->pitch * (bitmap->rows - 1);
+    if (bitmap.pitch < 0)
+        src += -bitmap.pitch * (bitmap.rows - 1);
 
     auto* dst = image.getData();
 
-    // The size of the returned bitmap can be both smaller and larger
-    // than grid-fitted bbox. The latter can only happen with fonts
-    // containing buggy bytecode (like DejaVu Sans v2.37).
     const auto dstW = std::min(
-        image.getWidth(), static_cast<int>(bitmap->width));
+        image.getWidth(), static_cast<int>(bitmap.width));
     const auto dstH = std::min(
-        image.getHeight(), static_cast<int>(bitmap->rows));
+        image.getHeight(), static_cast<int>(bitmap.rows));
 
     const auto dstPitch = image.getPitch();
 
     for (int y = 0; y < dstH; ++y) {
-        std::memcpy(dst, src, dstW);
+        convertBitmapRow(bitmap, src, dst, dstW);
         dst += dstPitch;
         src += srcPitch;
     }
 }
 
 
+void FtFontRenderer::renderGlyph(
+    dpfb::GlyphIndex glyphIdx, dpfb::Image& image) const
+{
+    auto err = FT_Load_Glyph(face, glyphIdx, loadFlags);
+    if (err != FT_Err_Ok)
+        throw dpfb::FontRendererError(
+            dpfb::str::format(
+                "Can't load glyph for %s: %s",
+                dpfb::unicode::cpToStr(idxToCp(face, glyphIdx)),
+                ftErrorToStr(err).c_str()));
+
+    if (face->glyph->format == FT_GLYPH_FORMAT_BITMAP) {
+        copyBitmap(face->glyph->bitmap, image);
+        return;
+    }
+
+    if (face->glyph->format != FT_GLYPH_FORMAT_OUTLINE)
+        throw dpfb::FontRendererError(
+            dpfb::str::format(
+                "Can't render glyph for %s: Unsupported glyph format",
+                dpfb::unicode::cpToStr(idxToCp(face, glyphIdx))));
+
+    if (image.getWidth() == 0 || image.getHeight() == 0)
+        return;
+
+    // Rasterize the outline straight into the image instead of
+    // calling FT_Render_Glyph(), which allocates its own bitmap that
+    // we would have to copy afterwards.
+    //
+    // The image has the size of the grid-fitted bbox computed in
+    // getGlyphMetrics(), so we move the top left corner of the bbox
+    // to the top left corner of the image. Parts of the outline
+    // outside the image are clipped by the rasterizer. This can only
+    // happen with fonts containing buggy bytecode (like DejaVu Sans
+    // v2.37).
+    auto* outline = &face->glyph->outline;
+
+    FT_BBox bbox;
+    FT_Outline_Get_CBox(outline, &bbox);
+
+    FT_Outline_Translate(
+        outline,
+        -ftFoor(bbox.xMin),
+        image.getHeight() * 64 - ftCeil(bbox.yMax));
+
+    FT_Bitmap bitmap;
+    FT_Bitmap_Init(&bitmap);
+    bitmap.rows = image.getHeight();
+    bitmap.width = image.getWidth();
+    bitmap.pitch = image.getPitch();
+    bitmap.buffer = image.getData();
+    bitmap.num_grays = 256;
+    bitmap.pixel_mode = FT_PIXEL_MODE_GRAY;
+
+    err = FT_Outline_Get_Bitmap(library, outline, &bitmap);
+    if (err != FT_Err_Ok)
+        throw dpfb::FontRendererError(
+            dpfb::str::format(
+                "Can't render glyph for %s: %s",
+                dpfb::unicode::cpToStr(idxToCp(face, glyphIdx)),
+                ftErrorToStr(err).c_str()));
+}
+
+
 class FtFontRendererCreator : public dpfb::FontRendererCreator {
 public:
     FtFontRendererCreator()
@@ -283,9 +435,9 @@ public:
             FT_Int vMinor;
             FT_Int vPatch;
 
-            refLib();
+            const auto library = createLib();
             FT_Library_Version(library, &vMajor, &vMinor, &vPatch);
-            unrefLib();
+            FT_Done_FreeType(library);
 
             std::snprintf(
                 buf, sizeof(buf),
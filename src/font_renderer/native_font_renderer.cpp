@@ -0,0 +1,329 @@
+
+#if DPFB_USE_NATIVE
+
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+#include "font_renderer/font_renderer.h"
+#include "native/cff.h"
+#include "native/cmap.h"
+#include "native/glyf.h"
+#include "native/outline.h"
+#include "native/rasterizer.h"
+#include "sfnt.h"
+#include "str.h"
+#include "streams/const_mem_stream.h"
+
+
+using namespace dpfb::streams;
+
+
+class NativeFontRenderer : public dpfb::FontRenderer {
+public:
+    explicit NativeFontRenderer(const dpfb::FontRendererArgs& args);
+
+    dpfb::FontMetrics getFontMetrics() const override;
+
+    dpfb::GlyphIndex getGlyphIndex(char32_t cp) const override;
+    dpfb::GlyphMetrics getGlyphMetrics(
+        dpfb::GlyphIndex glyphIdx) const override;
+    void renderGlyph(
+        dpfb::GlyphIndex glyphIdx, dpfb::Image& image) const override;
+private:
+    mutable ConstMemStream stream;
+    float scale;
+    dpfb::FontMetrics metrics;
+    std::uint32_t hmtxOffset;
+    std::uint16_t numberOfHMetrics;
+    std::unique_ptr<dpfb::native::Cmap> cmap;
+    std::unique_ptr<dpfb::native::OutlineReader> outlineReader;
+
+    mutable dpfb::native::Outline outline;
+    mutable dpfb::native::Rasterizer rasterizer;
+
+    void init(int fontIndex, int pxSize);
+    void readMetrics(const dpfb::SfntOffsetTable& sfntOffsetTable);
+    void loadOutline(dpfb::GlyphIndex glyphIdx) const;
+};
+
+
+NativeFontRenderer::NativeFontRenderer(const dpfb::FontRendererArgs& args)
+    : stream {args.data, args.dataSize}
+    , scale {}
+    , metrics {}
+    , hmtxOffset {}
+    , numberOfHMetrics {}
+    , cmap {}
+    , outlineReader {}
+    , outline {}
+    , rasterizer {}
+{
+    // The renderer doesn't support hinting, so args.hinting is
+    // ignored.
+    try {
+        init(args.fontIndex, args.pxSize);
+    } catch (StreamError& e) {
+        throw dpfb::FontRendererError(e.what());
+    }
+}
+
+
+void NativeFontRenderer::init(int fontIndex, int pxSize)
+{
+    const dpfb::SfntOffsetTable sfntOffsetTable(
+        {stream.getData(), static_cast<std::size_t>(stream.getSize())},
+        fontIndex);
+
+    // https://docs.microsoft.com/en-us/typography/opentype/spec/head
+    const auto headOffset = sfntOffsetTable.getTableOffset(
+        dpfb::sfntTag('h', 'e', 'a', 'd'));
+    if (headOffset == 0)
+        throw StreamError("Font has no \"head\" table");
+
+    stream.seek(headOffset + 18, SeekOrigin::set);
+    const auto unitsPerEm = stream.readU16Be();
+    if (unitsPerEm == 0)
+        throw StreamError("unitsPerEm in \"head\" table is 0");
+
+    stream.seek(headOffset + 50, SeekOrigin::set);
+    const auto indexToLocFormat = stream.readS16Be();
+
+    // https://docs.microsoft.com/en-us/typography/opentype/spec/maxp
+    const auto maxpOffset = sfntOffsetTable.getTableOffset(
+        dpfb::sfntTag('m', 'a', 'x', 'p'));
+    if (maxpOffset == 0)
+        throw StreamError("Font has no \"maxp\" table");
+
+    stream.seek(maxpOffset + 4, SeekOrigin::set);
+    const auto numGlyphs = stream.readU16Be();
+
+    scale = static_cast<float>(pxSize) / unitsPerEm;
+
+    readMetrics(sfntOffsetTable);
+
+    cmap.reset(new dpfb::native::Cmap(stream, sfntOffsetTable));
+
+    if (sfntOffsetTable.getTableOffset(
+            dpfb::sfntTag('g', 'l', 'y', 'f')) != 0)
+        outlineReader.reset(
+            new dpfb::native::GlyfOutlineReader(
+                sfntOffsetTable, numGlyphs, indexToLocFormat));
+    else if (sfntOffsetTable.getTableOffset(
+            dpfb::sfntTag('C', 'F', 'F', ' ')) != 0)
+        outlineReader.reset(
+            new dpfb::native::CffOutlineReader(stream, sfntOffsetTable));
+    else
+        throw StreamError(
+            "Font has neither \"glyf\" nor \"CFF \" outlines");
+}
+
+
+// Round 26.6 values the way FreeType does.
+
+
+static long toF26Dot6(float v)
+{
+    return std::lround(v * 64.0f);
+}
+
+
+static int floorF26Dot6(long v)
+{
+    return (v & -64) / 64;
+}
+
+
+static int ceilF26Dot6(long v)
+{
+    return ((v + 63) & -64) / 64;
+}
+
+
+static int roundF26Dot6(long v)
+{
+    return ((v + 32) & -64) / 64;
+}
+
+
+void NativeFontRenderer::readMetrics(
+    const dpfb::SfntOffsetTable& sfntOffsetTable)
+{
+    // https://docs.microsoft.com/en-us/typography/opentype/spec/hhea
+    const auto hheaOffset = sfntOffsetTable.getTableOffset(
+        dpfb::sfntTag('h', 'h', 'e', 'a'));
+    if (hheaOffset == 0)
+        throw StreamError("Font has no \"hhea\" table");
+
+    stream.seek(hheaOffset + 4, SeekOrigin::set);
+    int ascender = stream.readS16Be();
+    int descender = stream.readS16Be();
+    int lineGap = stream.readS16Be();
+
+    stream.seek(hheaOffset + 34, SeekOrigin::set);
+    numberOfHMetrics = stream.readU16Be();
+
+    hmtxOffset = sfntOffsetTable.getTableOffset(
+        dpfb::sfntTag('h', 'm', 't', 'x'));
+    if (hmtxOffset == 0)
+        throw StreamError("Font has no \"hmtx\" table");
+
+    // Like FreeType, use typographic metrics from "OS/2" if the
+    // USE_TYPO_METRICS flag is set or "hhea" has no metrics.
+    // https://docs.microsoft.com/en-us/typography/opentype/spec/os2
+    const auto os2Offset = sfntOffsetTable.getTableOffset(
+        dpfb::sfntTag('O', 'S', '/', '2'));
+    if (os2Offset != 0) {
+        stream.seek(os2Offset + 62, SeekOrigin::set);
+        const auto fsSelection = stream.readU16Be();
+        const auto useTypoMetrics = (fsSelection & (1 << 7)) != 0;
+
+        if (useTypoMetrics || (ascender == 0 && descender == 0)) {
+            stream.seek(os2Offset + 68, SeekOrigin::set);
+            ascender = stream.readS16Be();
+            descender = stream.readS16Be();
+            lineGap = stream.readS16Be();
+        }
+    }
+
+    metrics.ascender = ceilF26Dot6(toF26Dot6(ascender * scale));
+    metrics.descender = floorF26Dot6(toF26Dot6(descender * scale));
+    metrics.lineHeight = roundF26Dot6(
+        toF26Dot6((ascender - descender + lineGap) * scale));
+}
+
+
+dpfb::FontMetrics NativeFontRenderer::getFontMetrics() const
+{
+    return metrics;
+}
+
+
+dpfb::GlyphIndex NativeFontRenderer::getGlyphIndex(char32_t cp) const
+{
+    return cmap->getGlyphIndex(cp);
+}
+
+
+void NativeFontRenderer::loadOutline(dpfb::GlyphIndex glyphIdx) const
+{
+    try {
+        outlineReader->read(stream, glyphIdx, outline);
+    } catch (StreamError& e) {
+        throw dpfb::FontRendererError(
+            dpfb::str::format(
+                "Can't load glyph %" PRIuLEAST32 ": %s",
+                glyphIdx, e.what()));
+    }
+}
+
+
+dpfb::GlyphMetrics NativeFontRenderer::getGlyphMetrics(
+    dpfb::GlyphIndex glyphIdx) const
+{
+    dpfb::GlyphMetrics glyphMetrics;
+    glyphMetrics.isBitmap = false;
+
+    // https://docs.microsoft.com/en-us/typography/opentype/spec/hmtx
+    glyphMetrics.advance = 0;
+    try {
+        // Like FreeType, treat a font without metrics as having
+        // zero advances.
+        if (numberOfHMetrics > 0) {
+            const auto hMetricIdx = (
+                glyphIdx < numberOfHMetrics
+                    ? glyphIdx : numberOfHMetrics - 1);
+            stream.seek(hmtxOffset + hMetricIdx * 4, SeekOrigin::set);
+            glyphMetrics.advance = roundF26Dot6(
+                toF26Dot6(stream.readU16Be() * scale));
+        }
+    } catch (StreamError& e) {
+        throw dpfb::FontRendererError(
+            dpfb::str::format(
+                "Can't read advance of glyph %" PRIuLEAST32 ": %s",
+                glyphIdx, e.what()));
+    }
+
+    loadOutline(glyphIdx);
+    if (outline.isEmpty()) {
+        glyphMetrics.size = {};
+        glyphMetrics.offset = {};
+        return glyphMetrics;
+    }
+
+    float xMin;
+    float yMin;
+    float xMax;
+    float yMax;
+    outline.getCBox(xMin, yMin, xMax, yMax);
+
+    const auto bboxXMin = floorF26Dot6(toF26Dot6(xMin * scale));
+    const auto bboxYMin = floorF26Dot6(toF26Dot6(yMin * scale));
+    const auto bboxXMax = ceilF26Dot6(toF26Dot6(xMax * scale));
+    const auto bboxYMax = ceilF26Dot6(toF26Dot6(yMax * scale));
+
+    glyphMetrics.size.w = bboxXMax - bboxXMin;
+    glyphMetrics.size.h = bboxYMax - bboxYMin;
+    glyphMetrics.offset.x = bboxXMin;
+    glyphMetrics.offset.y = bboxYMax;
+
+    return glyphMetrics;
+}
+
+
+void NativeFontRenderer::renderGlyph(
+    dpfb::GlyphIndex glyphIdx, dpfb::Image& image) const
+{
+    if (image.getWidth() == 0 || image.getHeight() == 0)
+        return;
+
+    loadOutline(glyphIdx);
+    if (outline.isEmpty())
+        return;
+
+    // Compute the offset the same way as getGlyphMetrics(), so that
+    // the top left corner of the bbox is at the top left corner of
+    // the image.
+    float xMin;
+    float yMin;
+    float xMax;
+    float yMax;
+    outline.getCBox(xMin, yMin, xMax, yMax);
+
+    const auto bboxXMin = floorF26Dot6(toF26Dot6(xMin * scale));
+    const auto bboxYMax = ceilF26Dot6(toF26Dot6(yMax * scale));
+
+    rasterizer.reset(image.getWidth(), image.getHeight());
+    rasterizer.drawOutline(outline, scale, -bboxXMin, bboxYMax);
+    rasterizer.accumulate(image);
+}
+
+
+class NativeFontRendererCreator : public dpfb::FontRendererCreator {
+public:
+    NativeFontRendererCreator()
+        : FontRendererCreator("native")
+    {
+
+    }
+
+    const char* getDescription() const override
+    {
+        return (
+            "Built-in TrueType and CFF rasterizer "
+            "(no hinting, SIMD accumulation)");
+    }
+
+    dpfb::FontRenderer* create(
+        const dpfb::FontRendererArgs& args) const override
+    {
+        return new NativeFontRenderer(args);
+    }
+};
+
+
+static NativeFontRendererCreator creatorInstance;
+
+
+#endif  // DPFB_USE_NATIVE
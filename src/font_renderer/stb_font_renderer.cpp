@@ -1,6 +1,110 @@
 
 #if DPFB_USE_STBTT
 
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+
+/**
+ * Bump allocator for temporary stbtt allocations.
+ *
+ * stbtt allocates and frees vertices, edges, and active edges for
+ * every rendered glyph. We route these allocations to the arena,
+ * which is reset after each glyph. Freeing is a no-op.
+ *
+ * When a glyph doesn't fit in the current block, a new block is
+ * added. On reset, the blocks are merged into a single one of
+ * the total size, so that after a few glyphs rendering needs no
+ * heap allocations at all.
+ */
+class ScratchArena {
+public:
+    ScratchArena();
+
+    void* alloc(std::size_t size);
+    void reset();
+private:
+    struct Block {
+        std::unique_ptr<unsigned char[]> data;
+        std::size_t size;
+    };
+
+    std::vector<Block> blocks;
+    std::size_t blockPos;
+};
+
+
+ScratchArena::ScratchArena()
+    : blocks {}
+    , blockPos {}
+{
+
+}
+
+
+void* ScratchArena::alloc(std::size_t size)
+{
+    const std::size_t alignment = alignof(std::max_align_t);
+    size = (size + alignment - 1) & ~(alignment - 1);
+
+    if (blocks.empty() || blocks.back().size - blockPos < size) {
+        std::size_t blockSize = 16 * 1024;
+        if (!blocks.empty())
+            blockSize = blocks.back().size * 2;
+        if (blockSize < size)
+            blockSize = size;
+
+        Block block;
+        block.data.reset(new (std::nothrow) unsigned char[blockSize]);
+        if (!block.data)
+            // stbtt handles out of memory
+            return nullptr;
+        block.size = blockSize;
+
+        blocks.push_back(std::move(block));
+        blockPos = 0;
+    }
+
+    auto* result = blocks.back().data.get() + blockPos;
+    blockPos += size;
+    return result;
+}
+
+
+void ScratchArena::reset()
+{
+    blockPos = 0;
+    if (blocks.size() < 2)
+        return;
+
+    std::size_t totalSize = 0;
+    for (const auto& block : blocks)
+        totalSize += block.size;
+
+    blocks.clear();
+
+    Block block;
+    block.data.reset(new (std::nothrow) unsigned char[totalSize]);
+    if (!block.data)
+        return;
+    block.size = totalSize;
+
+    blocks.push_back(std::move(block));
+}
+
+
+static void* arenaAlloc(std::size_t size, void* userdata)
+{
+    return static_cast<ScratchArena*>(userdata)->alloc(size);
+}
+
+
+#define STBTT_malloc(x, u) arenaAlloc(x, u)
+#define STBTT_free(x, u) ((void)(x), (void)(u))
+
+
 #if defined(__GNUC__) || defined(__clang__)
     // Clang understands both "GCC" and "clang" names
     #pragma GCC diagnostic ignored "-Wunused-function"
@@ -11,6 +115,7 @@
 #include "stb_truetype.h"
 
 #include "font_renderer/font_renderer.h"
+#include "str.h"
 
 
 class StbFontRenderer : public dpfb::FontRenderer {
@@ -27,14 +132,28 @@ public:
 private:
     stbtt_fontinfo font;
     float scale;
+    mutable ScratchArena arena;
 };
 
 
 StbFontRenderer::StbFontRenderer(const dpfb::FontRendererArgs& args)
+    : font {}
+    , scale {}
+    , arena {}
 {
-    if (!stbtt_InitFont(&font, args.data, 0))
+    const auto fontOffset = stbtt_GetFontOffsetForIndex(
+        args.data, args.fontIndex);
+    if (fontOffset < 0)
+        throw dpfb::FontRendererError(
+            dpfb::str::format(
+                "stbtt can't find font at index %i", args.fontIndex));
+
+    if (!stbtt_InitFont(&font, args.data, fontOffset))
         throw dpfb::FontRendererError("stbtt can't init font");
 
+    // Route STBTT_malloc() to the arena.
+    font.userdata = &arena;
+
     scale = stbtt_ScaleForMappingEmToPixels(&font, args.pxSize);
 }
 
@@ -75,6 +194,7 @@ dpfb::GlyphMetrics StbFontRenderer::getGlyphMetrics(
     dpfb::GlyphIndex glyphIdx) const
 {
     dpfb::GlyphMetrics glyphMetrics;
+    glyphMetrics.isBitmap = false;
 
     stbtt_GetGlyphHMetrics(
         &font, glyphIdx, &glyphMetrics.advance, nullptr);
@@ -107,6 +227,7 @@ void StbFontRenderer::renderGlyph(
         image.getHeight(),
         image.getPitch(),
         scale, scale, glyphIdx);
+    arena.reset();
 }
 
 
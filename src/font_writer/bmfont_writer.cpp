@@ -86,7 +86,17 @@ void BMFontWriter::write(
             glyph.drawOffset.x, glyph.drawOffset.y, glyph.advance,
             glyph.pageIdx));
 
-    const auto& kerningPairs = font.getKerningPairs();
+    // BMFont has no class-based kerning, and its amounts are in
+    // pixels.
+    auto kerningPairs = dpfb::expandKerningClasses(
+        font.getKerningPairs(), font.getKerningClassTables());
+    if (bakingOptions.kerningUnits == dpfb::KerningUnits::font)
+        kerningPairs = dpfb::scaleKerningPairs(
+            kerningPairs,
+            font.getKerningDeltas(),
+            bakingOptions.fontPxSize,
+            font.getUnitsPerEm());
+
     if (!kerningPairs.empty()) {
         stream.writeStr(dpfb::str::format
             ("kernings count=%zu\n", kerningPairs.size()));
@@ -45,6 +45,94 @@ static const char* jsonBool(bool v)
 }
 
 
+// Writes a "name": [[codePoint, class], ...] member.
+static void writeKerningClasses(
+    dpfb::streams::Stream& stream,
+    const char* name,
+    const std::vector<dpfb::KerningClassEntry>& entries)
+{
+    stream.writeStr(dpfb::str::format("      \"%s\": [\n", name));
+    for (std::size_t i = 0; i < entries.size(); ++i)
+        stream.writeStr(dpfb::str::format(
+            "        [%" PRIuLEAST32 ", %" PRIu16 "]%s\n",
+            entries[i].cp,
+            entries[i].kerningClass,
+            i + 1 != entries.size() ? "," : ""));
+    stream.writeStr("      ],\n");
+}
+
+
+static void writeKerningClassTables(
+    dpfb::streams::Stream& stream,
+    const std::vector<dpfb::KerningClassTable>& classTables)
+{
+    stream.writeStr("  \"kerningClasses\": [\n");
+
+    for (std::size_t i = 0; i < classTables.size(); ++i) {
+        const auto& classTable = classTables[i];
+        stream.writeStr(dpfb::str::format(
+            "    {\n"
+            "      \"leftClassCount\": %" PRIu16 ",\n"
+            "      \"rightClassCount\": %" PRIu16 ",\n",
+            classTable.numLeftClasses,
+            classTable.numRightClasses));
+
+        writeKerningClasses(stream, "leftClasses", classTable.leftClasses);
+        writeKerningClasses(
+            stream, "rightClasses", classTable.rightClasses);
+
+        stream.writeStr("      \"amounts\": [\n");
+        for (std::size_t row = 0; row < classTable.numLeftClasses; ++row) {
+            stream.writeStr("        [");
+            for (std::size_t col = 0;
+                    col < classTable.numRightClasses;
+                    ++col)
+                stream.writeStr(dpfb::str::format(
+                    "%s%i",
+                    col > 0 ? ", " : "",
+                    classTable.amounts[
+                        row * classTable.numRightClasses + col]));
+            stream.writeStr(dpfb::str::format(
+                "]%s\n",
+                row + 1 != classTable.numLeftClasses ? "," : ""));
+        }
+        stream.writeStr("      ]\n");
+
+        stream.writeStr(dpfb::str::format(
+            "    }%s\n",
+            i + 1 != classTables.size() ? "," : ""));
+    }
+
+    stream.writeStr("  ]");
+}
+
+
+static void writeKerningDeltas(
+    dpfb::streams::Stream& stream,
+    const std::vector<dpfb::KerningDelta>& deltas)
+{
+    stream.writeStr("  \"kerningDeltas\": [\n");
+
+    for (std::size_t i = 0; i < deltas.size(); ++i) {
+        const auto& delta = deltas[i];
+        stream.writeStr(dpfb::str::format(
+            "    {\n"
+            "      \"codePoint1\": %" PRIuLEAST32 ",\n"
+            "      \"codePoint2\": %" PRIuLEAST32 ",\n"
+            "      \"pxSize\": %i,\n"
+            "      \"amount\": %i\n"
+            "    }%s\n",
+            delta.cp1,
+            delta.cp2,
+            delta.pxSize,
+            delta.amount,
+            i + 1 != deltas.size() ? "," : ""));
+    }
+
+    stream.writeStr("  ]");
+}
+
+
 void JsonFontWriter::write(
     dpfb::streams::Stream& stream,
     const dpfb::Font& font,
@@ -203,7 +291,22 @@ void JsonFontWriter::write(
             i + 1 != kerningPairs.size() ? "," : ""));
     }
 
-    stream.writeStr("  ]\n");
+    stream.writeStr("  ]");
+
+    if (bakingOptions.kerningFormat == dpfb::KerningFormat::classes) {
+        stream.writeStr(",\n");
+        writeKerningClassTables(stream, font.getKerningClassTables());
+    }
+
+    if (bakingOptions.kerningUnits == dpfb::KerningUnits::font) {
+        stream.writeStr(dpfb::str::format(
+            ",\n"
+            "  \"kerningUnitsPerEm\": %i,\n",
+            font.getUnitsPerEm()));
+        writeKerningDeltas(stream, font.getKerningDeltas());
+    }
+
+    stream.writeStr("\n");
 
     stream.writeStr("}");
 }
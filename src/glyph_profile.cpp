@@ -0,0 +1,105 @@
+
+#include "glyph_profile.h"
+
+#include <algorithm>
+
+
+namespace dpfb {
+
+
+std::uint64_t GlyphTiming::getTotalNs() const
+{
+    return metricsNs + renderNs;
+}
+
+
+GlyphTiming& GlyphProfile::getTiming(char32_t cp)
+{
+    const auto iter = cpToTimingIdx.find(cp);
+    if (iter != cpToTimingIdx.end())
+        return timings[iter->second];
+
+    cpToTimingIdx[cp] = timings.size();
+    timings.push_back({cp, 0, 0});
+    return timings.back();
+}
+
+
+void GlyphProfile::addMetricsTime(char32_t cp, std::uint64_t ns)
+{
+    getTiming(cp).metricsNs += ns;
+}
+
+
+void GlyphProfile::addRenderTime(char32_t cp, std::uint64_t ns)
+{
+    getTiming(cp).renderNs += ns;
+}
+
+
+const std::vector<GlyphTiming>& GlyphProfile::getTimings() const
+{
+    return timings;
+}
+
+
+std::vector<GlyphTiming> GlyphProfile::getSlowest(std::size_t n) const
+{
+    auto result = timings;
+    n = std::min(n, result.size());
+
+    std::partial_sort(
+        result.begin(), result.begin() + n, result.end(),
+        [](const GlyphTiming& a, const GlyphTiming& b)
+        {
+            const auto aTotalNs = a.getTotalNs();
+            const auto bTotalNs = b.getTotalNs();
+            if (aTotalNs != bTotalNs)
+                return aTotalNs > bTotalNs;
+            return a.cp < b.cp;
+        });
+
+    result.resize(n);
+    return result;
+}
+
+
+std::uint64_t GlyphProfile::getMedianNs() const
+{
+    if (timings.empty())
+        return 0;
+
+    std::vector<std::uint64_t> totalsNs;
+    totalsNs.reserve(timings.size());
+    for (const auto& timing : timings)
+        totalsNs.push_back(timing.getTotalNs());
+
+    const auto middle = totalsNs.begin() + totalsNs.size() / 2;
+    std::nth_element(totalsNs.begin(), middle, totalsNs.end());
+    return *middle;
+}
+
+
+std::vector<std::size_t> GlyphProfile::getHistogram() const
+{
+    std::vector<std::size_t> histogram;
+
+    for (const auto& timing : timings) {
+        auto totalUs = timing.getTotalNs() / 1000;
+
+        std::size_t bucketIdx = 0;
+        while (totalUs > 0) {
+            ++bucketIdx;
+            totalUs >>= 1;
+        }
+
+        if (bucketIdx >= histogram.size())
+            histogram.resize(bucketIdx + 1);
+        ++histogram[bucketIdx];
+    }
+
+    return histogram;
+}
+
+
+}
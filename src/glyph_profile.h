@@ -0,0 +1,67 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+
+namespace dpfb {
+
+
+struct GlyphTiming {
+    char32_t cp;
+    // Time of FontRenderer::getGlyphMetrics()
+    std::uint64_t metricsNs;
+    // Time of FontRenderer::renderGlyph()
+    std::uint64_t renderNs;
+
+    std::uint64_t getTotalNs() const;
+};
+
+
+/**
+ * Per-glyph renderer timings.
+ *
+ * This helps to find glyphs that are much slower than others, like
+ * ones with pathological hinting bytecode.
+ */
+class GlyphProfile {
+public:
+    void addMetricsTime(char32_t cp, std::uint64_t ns);
+    void addRenderTime(char32_t cp, std::uint64_t ns);
+
+    /**
+     * Return timings in the order code points were first added.
+     */
+    const std::vector<GlyphTiming>& getTimings() const;
+
+    /**
+     * Return up to n timings with the largest total time, slowest
+     * first. Glyphs with equal times are ordered by code point.
+     */
+    std::vector<GlyphTiming> getSlowest(std::size_t n) const;
+
+    /**
+     * Return the median of total times, or 0 if there are no timings.
+     */
+    std::uint64_t getMedianNs() const;
+
+    /**
+     * Return the histogram of total times.
+     *
+     * Bucket 0 counts glyphs faster than 1 microsecond. Bucket i > 0
+     * counts glyphs taking [2^(i-1), 2^i) microseconds. The last
+     * bucket is the last non-empty one.
+     */
+    std::vector<std::size_t> getHistogram() const;
+private:
+    std::vector<GlyphTiming> timings;
+    std::unordered_map<char32_t, std::size_t> cpToTimingIdx;
+
+    GlyphTiming& getTiming(char32_t cp);
+};
+
+
+}
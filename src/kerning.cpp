@@ -2,11 +2,19 @@
 #include "kerning.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cinttypes>
 #include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <thread>
 #include <utility>
 
+#include "kerning_detail.h"
 #include "str.h"
+#include "streams/stream_stats.h"
+#include "trace.h"
+#include "unicode.h"
 
 
 namespace dpfb {
@@ -14,45 +22,352 @@ namespace dpfb {
 
 static float getScale(const KerningParams& params)
 {
+    if (params.units == KerningUnits::font)
+        return 1.0f;
+
     return static_cast<float>(params.pxSize) / params.pxPerEm;
 }
 
 
+static bool isInGlyphSet(const GlyphSet* glyphSet, std::uint16_t glyphIdx)
+{
+    return (
+        !glyphSet
+        || (glyphIdx < glyphSet->size() && (*glyphSet)[glyphIdx]));
+}
+
+
+static std::uint64_t getKerningPairKey(const KerningPair& pair)
+{
+    return (static_cast<std::uint64_t>(pair.cp1) << 32) | pair.cp2;
+}
+
+
+// LSD radix sort by (cp1, cp2). It's stable, so the first added
+// pair goes first among the pairs with the same code points.
+static void radixSortKerningPairs(std::vector<KerningPair>& pairs)
+{
+    const int digitBits = 11;
+    const int numDigits = (64 + digitBits - 1) / digitBits;
+    const std::uint64_t digitMask = (1 << digitBits) - 1;
+
+    std::vector<std::uint32_t> counts(numDigits << digitBits);
+    for (const auto& pair : pairs) {
+        const auto key = getKerningPairKey(pair);
+        for (int i = 0; i < numDigits; ++i)
+            ++counts[
+                (i << digitBits)
+                + ((key >> (i * digitBits)) & digitMask)];
+    }
+
+    std::vector<KerningPair> buffer(pairs.size());
+    for (int i = 0; i < numDigits; ++i) {
+        auto* digitCounts = &counts[i << digitBits];
+
+        // Code points fit in 21 bits, so most of the high digits are
+        // the same for all pairs.
+        const auto firstKey = getKerningPairKey(pairs[0]);
+        const auto firstDigit = (firstKey >> (i * digitBits)) & digitMask;
+        if (digitCounts[firstDigit] == pairs.size())
+            continue;
+
+        std::uint32_t offset = 0;
+        for (std::size_t j = 0; j <= digitMask; ++j) {
+            const auto count = digitCounts[j];
+            digitCounts[j] = offset;
+            offset += count;
+        }
+
+        for (const auto& pair : pairs) {
+            const auto key = getKerningPairKey(pair);
+            buffer[digitCounts[(key >> (i * digitBits)) & digitMask]++] = (
+                pair);
+        }
+
+        pairs.swap(buffer);
+    }
+}
+
+
+void sortKerningPairsUnique(std::vector<KerningPair>& pairs)
+{
+    if (pairs.empty())
+        return;
+
+    radixSortKerningPairs(pairs);
+
+    struct KerningPairsEqualByCp {
+        bool operator()(const KerningPair& a, const KerningPair& b) const
+        {
+            return a.cp1 == b.cp1 && a.cp2 == b.cp2;
+        }
+    };
+    pairs.erase(
+        std::unique(pairs.begin(), pairs.end(), KerningPairsEqualByCp()),
+        pairs.end());
+}
+
+
+std::vector<KerningPair> expandKerningClasses(
+    const std::vector<KerningPair>& pairs,
+    const std::vector<KerningClassTable>& classTables)
+{
+    auto result = pairs;
+    if (classTables.empty())
+        return result;
+
+    for (const auto& classTable : classTables)
+        for (const auto& left : classTable.leftClasses) {
+            const auto* row = &classTable.amounts[
+                left.kerningClass * classTable.numRightClasses];
+            for (const auto& right : classTable.rightClasses) {
+                const auto amount = row[right.kerningClass];
+                if (amount != 0)
+                    result.push_back({left.cp, right.cp, amount});
+            }
+        }
+
+    sortKerningPairsUnique(result);
+
+    return result;
+}
+
+
+std::vector<KerningPair> scaleKerningPairs(
+    const std::vector<KerningPair>& pairs,
+    const std::vector<KerningDelta>& deltas,
+    int pxSize,
+    int unitsPerEm)
+{
+    const auto scale = static_cast<float>(pxSize) / unitsPerEm;
+
+    std::vector<KerningPair> result;
+    result.reserve(pairs.size());
+
+    // Both lists are sorted, so merge them.
+    auto deltaIter = deltas.begin();
+    const auto addDeltasBefore = [&](const KerningPair* pair)
+    {
+        for (; deltaIter < deltas.end(); ++deltaIter) {
+            const auto& delta = *deltaIter;
+            if (pair
+                    && (delta.cp1 > pair->cp1
+                        || (delta.cp1 == pair->cp1
+                            && delta.cp2 >= pair->cp2)))
+                break;
+
+            if (delta.pxSize == pxSize)
+                result.push_back({delta.cp1, delta.cp2, delta.amount});
+        }
+    };
+
+    for (const auto& pair : pairs) {
+        addDeltasBefore(&pair);
+
+        int amount = std::lround(pair.amount * scale);
+        for (; deltaIter < deltas.end()
+                    && deltaIter->cp1 == pair.cp1
+                    && deltaIter->cp2 == pair.cp2;
+                ++deltaIter)
+            if (deltaIter->pxSize == pxSize)
+                amount += deltaIter->amount;
+
+        if (amount != 0)
+            result.push_back({pair.cp1, pair.cp2, amount});
+    }
+
+    addDeltasBefore(nullptr);
+
+    return result;
+}
+
+
+static std::uint64_t getBigramKey(char32_t cp1, char32_t cp2)
+{
+    return (static_cast<std::uint64_t>(cp1) << 32) | cp2;
+}
+
+
+void BigramCounts::addText(const char* str, std::size_t size)
+{
+    const auto* end = str + size;
+    if (str == end)
+        return;
+
+    auto prevCp = unicode::decodeUtf8(str, end);
+    while (str < end) {
+        const auto cp = unicode::decodeUtf8(str, end);
+        ++counts[getBigramKey(prevCp, cp)];
+        prevCp = cp;
+    }
+}
+
+
+std::uint32_t BigramCounts::getCount(char32_t cp1, char32_t cp2) const
+{
+    const auto iter = counts.find(getBigramKey(cp1, cp2));
+    return iter != counts.end() ? iter->second : 0;
+}
+
+
+bool isKerningBudgetSet(const KerningBudget& budget)
+{
+    return budget.maxPairs > 0 || budget.minAmount > 0;
+}
+
+
+// Removed pairs are appended to droppedPairs, if it's not null.
+static void applyKerningBudgetToPairs(
+    std::vector<KerningPair>& pairs,
+    const KerningBudget& budget,
+    std::vector<KerningPair>* droppedPairs)
+{
+    pairs.erase(
+        std::remove_if(
+            pairs.begin(), pairs.end(),
+            [&](const KerningPair& pair)
+            {
+                if (std::abs(pair.amount) >= budget.minAmount)
+                    return false;
+
+                if (droppedPairs)
+                    droppedPairs->push_back(pair);
+                return true;
+            }),
+        pairs.end());
+
+    if (budget.maxPairs == 0 || pairs.size() <= budget.maxPairs)
+        return;
+
+    struct RankedPair {
+        std::uint64_t score;
+        int absAmount;
+        std::size_t idx;
+    };
+
+    std::vector<RankedPair> rankedPairs;
+    rankedPairs.reserve(pairs.size());
+    for (std::size_t i = 0; i < pairs.size(); ++i) {
+        const auto& pair = pairs[i];
+        const auto absAmount = std::abs(pair.amount);
+
+        std::uint64_t score = absAmount;
+        if (budget.bigramCounts)
+            score *= budget.bigramCounts->getCount(pair.cp1, pair.cp2);
+
+        rankedPairs.push_back({score, absAmount, i});
+    }
+
+    // Ties are resolved by the original order to make the result
+    // independent from the sort algorithm.
+    std::nth_element(
+        rankedPairs.begin(),
+        rankedPairs.begin() + budget.maxPairs,
+        rankedPairs.end(),
+        [](const RankedPair& a, const RankedPair& b)
+        {
+            if (a.score != b.score)
+                return a.score > b.score;
+            else if (a.absAmount != b.absAmount)
+                return a.absAmount > b.absAmount;
+            else
+                return a.idx < b.idx;
+        });
+    rankedPairs.resize(budget.maxPairs);
+
+    std::vector<bool> keep(pairs.size());
+    for (const auto& rankedPair : rankedPairs)
+        keep[rankedPair.idx] = true;
+
+    std::size_t numKept = 0;
+    for (std::size_t i = 0; i < pairs.size(); ++i)
+        if (keep[i])
+            pairs[numKept++] = pairs[i];
+        else if (droppedPairs)
+            droppedPairs->push_back(pairs[i]);
+    pairs.resize(numKept);
+}
+
+
+std::size_t applyKerningBudget(
+    std::vector<KerningPair>& pairs,
+    const KerningBudget& budget,
+    std::vector<KerningDelta>* deltas)
+{
+    const auto numPairs = pairs.size();
+
+    if (!deltas || deltas->empty()) {
+        applyKerningBudgetToPairs(pairs, budget, nullptr);
+        return numPairs - pairs.size();
+    }
+
+    std::vector<KerningPair> droppedPairs;
+    applyKerningBudgetToPairs(pairs, budget, &droppedPairs);
+
+    std::sort(
+        droppedPairs.begin(), droppedPairs.end(),
+        [](const KerningPair& a, const KerningPair& b)
+        {
+            return getKerningPairKey(a) < getKerningPairKey(b);
+        });
+
+    deltas->erase(
+        std::remove_if(
+            deltas->begin(), deltas->end(),
+            [&](const KerningDelta& delta)
+            {
+                return std::binary_search(
+                    droppedPairs.begin(), droppedPairs.end(),
+                    KerningPair {delta.cp1, delta.cp2, 0},
+                    [](const KerningPair& a, const KerningPair& b)
+                    {
+                        return getKerningPairKey(a) < getKerningPairKey(b);
+                    });
+            }),
+        deltas->end());
+
+    return numPairs - pairs.size();
+}
+
+
 using namespace streams;
+using namespace dpfb::detail;
 
 
 // https://www.microsoft.com/typography/otspec/kern.htm
 std::vector<RawKerningPair> readKerningPairsKern(
-    Stream& stream,
+    const SpanReader& fontReader,
     const SfntOffsetTable& sfntOffsetTable,
-    const KerningParams& params)
+    const KerningParams& params,
+    const GlyphSet* glyphSet)
 {
     const auto tableOffset = sfntOffsetTable.getTableOffset(
         sfntTag('k', 'e', 'r', 'n'));
     if (tableOffset == 0)
         return {};
 
-    stream.seek(tableOffset, SeekOrigin::set);
+    auto reader = fontReader.getSubSpan(tableOffset);
 
-    const auto version = stream.readU16Be();
+    const auto version = reader.readU16Be();
     if (version != 0)
         // Unsupported kern table version
         return {};
 
-    auto numTables = stream.readU16Be();
+    auto numTables = reader.readU16Be();
     if (numTables == 0)
         throw streams::StreamError("\"kern\" table has no subtables");
 
     const auto scale = getScale(params);
 
     std::vector<RawKerningPair> result;
+    std::vector<std::uint16_t> pairWords;
 
-    auto nextPos = stream.getPosition();
+    auto nextPos = reader.getPosition();
     while (numTables--) {
         // Skip subtable version
-        stream.seek(sizeof(std::uint16_t), SeekOrigin::cur);
-        const auto subTableLenght = stream.readU16Be();
-        const auto coverage = stream.readU16Be();
+        reader.seek(sizeof(std::uint16_t), SeekOrigin::cur);
+        const auto subTableLenght = reader.readU16Be();
+        const auto coverage = reader.readU16Be();
 
         nextPos += subTableLenght;
 
@@ -74,22 +389,26 @@ std::vector<RawKerningPair> readKerningPairsKern(
             || (coverage & (1 << 2))
             // Only format 0 is supported
                 || (coverage >> 8) != 0) {
-            stream.seek(nextPos, SeekOrigin::set);
+            reader.seek(nextPos, SeekOrigin::set);
             continue;
         }
 
-        auto numPairs = stream.readU16Be();
+        const auto numPairs = reader.readU16Be();
         // Skip binary search stuff
-        stream.seek(3 * sizeof(std::uint16_t), SeekOrigin::cur);
+        reader.seek(3 * sizeof(std::uint16_t), SeekOrigin::cur);
+
+        // Each pair is left glyph, right glyph, and value.
+        pairWords.resize(numPairs * 3);
+        reader.readU16BeArray(pairWords.data(), pairWords.size());
 
         std::uint16_t prevGlyphIdx1 = 0;
         std::uint16_t prevGlyphIdx2 = 0;
 
         result.reserve(result.size() + numPairs);
-        while (numPairs--) {
-            const auto glyphIdx1 = stream.readU16Be();
-            const auto glyphIdx2 = stream.readU16Be();
-            const auto amount = stream.readS16Be();
+        for (std::size_t i = 0; i < pairWords.size(); i += 3) {
+            const auto glyphIdx1 = pairWords[i];
+            const auto glyphIdx2 = pairWords[i + 1];
+            const auto amount = static_cast<std::int16_t>(pairWords[i + 2]);
 
             // Some Windows' fonts have duplicate pairs
             if (glyphIdx1 == prevGlyphIdx1
@@ -100,6 +419,10 @@ std::vector<RawKerningPair> readKerningPairsKern(
                 prevGlyphIdx2 = glyphIdx2;
             }
 
+            if (!isInGlyphSet(glyphSet, glyphIdx1)
+                    || !isInGlyphSet(glyphSet, glyphIdx2))
+                continue;
+
             const int scaledAmount = std::lround(amount * scale);
             if (scaledAmount == 0)
                 continue;
@@ -112,24 +435,46 @@ std::vector<RawKerningPair> readKerningPairsKern(
 }
 
 
-static std::vector<std::uint16_t> readCovarageTable(Stream& stream)
+static std::uint32_t getCoverageSize(const Coverage& coverage)
+{
+    std::uint32_t result = 0;
+    for (const auto& range : coverage)
+        result += range.last - range.first + 1;
+
+    return result;
+}
+
+
+namespace detail {
+
+
+Coverage readCoverageTable(SpanReader& reader)
 {
-    std::vector<std::uint16_t> result;
+    Coverage result;
+    std::vector<std::uint16_t> words;
 
-    const auto coverageFormat = stream.readU16Be();
+    const auto coverageFormat = reader.readU16Be();
     if (coverageFormat == 1) {
-        auto glyphCount = stream.readU16Be();
-        result.reserve(glyphCount);
-        while (glyphCount--)
-            result.push_back(stream.readU16Be());
+        words.resize(reader.readU16Be());
+        reader.readU16BeArray(words.data(), words.size());
+        for (const auto glyphId : words) {
+            // Merge consecutive glyphs in a single range.
+            if (!result.empty() && result.back().last + 1 == glyphId)
+                result.back().last = glyphId;
+            else
+                result.push_back({glyphId, glyphId});
+        }
     } else if (coverageFormat == 2) {
-        auto rangeCount = stream.readU16Be();
-        while (rangeCount--) {
-            const auto startGlyphId = stream.readU16Be();
-            const auto endGlyphId = stream.readU16Be();
-            // Skip startCoverageIndex
-            stream.seek(
-                sizeof(std::uint16_t), SeekOrigin::cur);
+        const auto rangeCount = reader.readU16Be();
+        // Each range is startGlyphId, endGlyphId, and
+        // startCoverageIndex; the latter is not needed.
+        words.resize(rangeCount * 3);
+        reader.readU16BeArray(words.data(), words.size());
+
+        result.reserve(rangeCount);
+        for (std::size_t i = 0; i < words.size(); i += 3) {
+            const auto startGlyphId = words[i];
+            const auto endGlyphId = words[i + 1];
 
             if (startGlyphId > endGlyphId)
                 throw StreamError(str::format(
@@ -138,10 +483,7 @@ static std::vector<std::uint16_t> readCovarageTable(Stream& stream)
                     startGlyphId,
                     endGlyphId));
 
-            result.reserve(
-                result.size() + endGlyphId - startGlyphId + 1);
-            for (auto i = startGlyphId; i <= endGlyphId; ++ i)
-                result.push_back(i);
+            result.push_back({startGlyphId, endGlyphId});
         }
     } else
         throw StreamError(str::format(
@@ -152,22 +494,19 @@ static std::vector<std::uint16_t> readCovarageTable(Stream& stream)
 }
 
 
-using GlyphClasses = std::vector<std::vector<std::uint16_t>>;
-
-
-static GlyphClasses readClassDefTable(
-    Stream& stream, std::uint16_t classCount)
+ClassDef readClassDefTable(SpanReader& reader, std::uint16_t classCount)
 {
-    GlyphClasses result;
-    result.resize(classCount);
+    ClassDef result;
+    std::vector<std::uint16_t> words;
 
-    const auto classFormat = stream.readU16Be();
+    const auto classFormat = reader.readU16Be();
     if (classFormat == 1) {
-        const auto startGlyphId = stream.readU16Be();
-        const auto glyphCount = stream.readU16Be();
-        for (std::uint16_t i = 0; i < glyphCount; ++i) {
-            const auto glyphId = startGlyphId + i;
-            const auto glyphClass = stream.readU16Be();
+        const auto startGlyphId = reader.readU16Be();
+        words.resize(reader.readU16Be());
+        reader.readU16BeArray(words.data(), words.size());
+        for (std::size_t i = 0; i < words.size(); ++i) {
+            const std::uint16_t glyphId = startGlyphId + i;
+            const auto glyphClass = words[i];
             if (glyphClass >= classCount)
                 throw StreamError(str::format(
                     "Glyph class index (%" PRIu16 ") in class "
@@ -176,13 +515,22 @@ static GlyphClasses readClassDefTable(
                     glyphClass,
                     classCount));
 
-            result[glyphClass].push_back(glyphId);
+            // Merge runs of the same class in a single range.
+            if (i > 0 && result.back().glyphClass == glyphClass)
+                result.back().last = glyphId;
+            else
+                result.push_back({glyphId, glyphId, glyphClass});
         }
     } else if (classFormat == 2) {
-        auto classRangeCount = stream.readU16Be();
-        while (classRangeCount--) {
-            const auto startGlyphId = stream.readU16Be();
-            const auto endGlyphId = stream.readU16Be();
+        const auto classRangeCount = reader.readU16Be();
+        // Each range is startGlyphId, endGlyphId, and class.
+        words.resize(classRangeCount * 3);
+        reader.readU16BeArray(words.data(), words.size());
+
+        result.reserve(classRangeCount);
+        for (std::size_t i = 0; i < words.size(); i += 3) {
+            const auto startGlyphId = words[i];
+            const auto endGlyphId = words[i + 1];
             if (startGlyphId > endGlyphId)
                 throw StreamError(str::format(
                     "Class definition table format 2 range start id "
@@ -190,7 +538,7 @@ static GlyphClasses readClassDefTable(
                     startGlyphId,
                     endGlyphId));
 
-            const auto glyphClass = stream.readU16Be();
+            const auto glyphClass = words[i + 2];
             if (glyphClass >= classCount)
                 throw StreamError(str::format(
                     "Glyph class index (%" PRIu16 ") in class "
@@ -199,10 +547,21 @@ static GlyphClasses readClassDefTable(
                     glyphClass,
                     classCount));
 
-            auto& classGlyphs = result[glyphClass];
-            for (std::uint16_t i = startGlyphId; i <= endGlyphId; ++i)
-                classGlyphs.push_back(i);
+            result.push_back({startGlyphId, endGlyphId, glyphClass});
         }
+
+        // Ranges should already be sorted, but the spec doesn't
+        // require that.
+        struct CmpClassRanges {
+            bool operator()(const ClassRange& a, const ClassRange& b) const
+            {
+                return a.first < b.first;
+            }
+        };
+        if (!std::is_sorted(
+                result.begin(), result.end(), CmpClassRanges()))
+            std::stable_sort(
+                result.begin(), result.end(), CmpClassRanges());
     } else
         throw StreamError(str::format(
             "Unknown format of class definition table: %" PRIu16,
@@ -212,10 +571,120 @@ static GlyphClasses readClassDefTable(
 }
 
 
+}
+
+
+// Returns 0 for glyphs not in the class definition table.
+static std::uint16_t getGlyphClass(
+    const ClassDef& classDef, std::uint16_t glyphIdx)
+{
+    struct CmpGlyphIdx {
+        bool operator()(std::uint16_t glyphIdx, const ClassRange& range) const
+        {
+            return glyphIdx < range.first;
+        }
+    };
+
+    auto iter = std::upper_bound(
+        classDef.begin(), classDef.end(), glyphIdx, CmpGlyphIdx());
+    if (iter == classDef.begin())
+        return 0;
+
+    --iter;
+    if (glyphIdx > iter->last)
+        return 0;
+
+    return iter->glyphClass;
+}
+
+
+// Glyphs of every class, stored as a single array: glyphs of class
+// i are glyphIndices[offsets[i]..offsets[i + 1]).
+struct ClassGlyphs {
+    std::vector<std::uint32_t> offsets;
+    std::vector<std::uint16_t> glyphIndices;
+
+    bool isEmpty(std::size_t glyphClass) const
+    {
+        return offsets[glyphClass] == offsets[glyphClass + 1];
+    }
+
+    const std::uint16_t* begin(std::size_t glyphClass) const
+    {
+        return glyphIndices.data() + offsets[glyphClass];
+    }
+
+    const std::uint16_t* end(std::size_t glyphClass) const
+    {
+        return glyphIndices.data() + offsets[glyphClass + 1];
+    }
+
+    std::size_t getSize(std::size_t glyphClass) const
+    {
+        return offsets[glyphClass + 1] - offsets[glyphClass];
+    }
+};
+
+
+struct ClassedGlyph {
+    std::uint16_t glyphClass;
+    std::uint16_t glyphIdx;
+};
+
+
+static ClassGlyphs groupGlyphsByClass(
+    const std::vector<ClassedGlyph>& classedGlyphs,
+    std::uint16_t classCount)
+{
+    ClassGlyphs result;
+
+    result.offsets.assign(classCount + 1, 0);
+    for (const auto& classedGlyph : classedGlyphs)
+        ++result.offsets[classedGlyph.glyphClass + 1];
+
+    for (std::size_t i = 1; i < result.offsets.size(); ++i)
+        result.offsets[i] += result.offsets[i - 1];
+
+    result.glyphIndices.resize(classedGlyphs.size());
+    auto positions = result.offsets;
+    for (const auto& classedGlyph : classedGlyphs)
+        result.glyphIndices[positions[classedGlyph.glyphClass]++] = (
+            classedGlyph.glyphIdx);
+
+    return result;
+}
+
+
+struct DeviceDelta {
+    int pxSize;
+    int amount;
+};
+
+
+// Decoded device tables of a subtable, by their offsets. Many value
+// records of a subtable usually share a few device tables.
+struct DeviceTableCache {
+    // Adjustments for LookupContext::pxSize
+    std::unordered_map<std::uint16_t, int> adjustments;
+    std::unordered_map<std::uint16_t, std::vector<DeviceDelta>> deltas;
+};
+
+
+// State and results of reading a single subtable.
 struct LookupContext {
     int pxSize;
     float scale;
+    const GlyphSet* glyphSet;
     std::vector<RawKerningPair> kerningPairs;
+    std::vector<RawKerningClassTable>* classTables;
+    // Not null if device adjustments should be returned as deltas
+    // rather than applied for pxSize.
+    std::vector<RawKerningDelta>* deltas;
+    // Set if kerningPairs are from pair sets, and thus should be
+    // dropped if class tables of the preceding subtables have kerning
+    // for them. Deltas are checked against these tables regardless.
+    bool hasPairSets;
+    DeviceTableCache deviceTableCache;
 };
 
 
@@ -245,10 +714,10 @@ static bool hasKerning(int valueFormat1, int valueFormat2)
 }
 
 
-static int readDeviceAdjsutment(Stream& stream, int pxSize)
+static int readDeviceAdjsutment(SpanReader& reader, int pxSize)
 {
-    const auto startSize = stream.readU16Be();
-    const auto endSize = stream.readU16Be();
+    const auto startSize = reader.readU16Be();
+    const auto endSize = reader.readU16Be();
     if (startSize > endSize)
         throw StreamError(str::format(
             "Device table start size (%" PRIu16 ") > "
@@ -259,7 +728,7 @@ static int readDeviceAdjsutment(Stream& stream, int pxSize)
     if (pxSize < startSize || pxSize > endSize)
         return 0;
 
-    const auto deltaFormat = stream.readU16Be();
+    const auto deltaFormat = reader.readU16Be();
     if (deltaFormat < 1 || deltaFormat > 3)
         return 0;
 
@@ -267,9 +736,9 @@ static int readDeviceAdjsutment(Stream& stream, int pxSize)
     const auto valuesPerU16 = 16 / valueBits;
     const auto valueIdx = pxSize - startSize;
     const auto valueU16Idx = valueIdx / valuesPerU16;
-    stream.seek(valueU16Idx * sizeof(std::uint16_t), SeekOrigin::cur);
+    reader.seek(valueU16Idx * sizeof(std::uint16_t), SeekOrigin::cur);
 
-    const auto u16 = stream.readU16Be();
+    const auto u16 = reader.readU16Be();
     const auto u16rshift = (
         ((valueU16Idx + 1) * valuesPerU16 - 1 - valueIdx) * valueBits);
     const auto mask = 0xff >> (8 - valueBits);
@@ -282,6 +751,57 @@ static int readDeviceAdjsutment(Stream& stream, int pxSize)
 }
 
 
+// Appends non-zero deltas for all sizes of the device table.
+static void readDeviceDeltas(
+    SpanReader& reader, std::vector<DeviceDelta>& deltas)
+{
+    const auto startSize = reader.readU16Be();
+    const auto endSize = reader.readU16Be();
+    if (startSize > endSize)
+        throw StreamError(str::format(
+            "Device table start size (%" PRIu16 ") > "
+            "end size (%" PRIu16 ")",
+            startSize,
+            endSize));
+
+    const auto deltaFormat = reader.readU16Be();
+    if (deltaFormat < 1 || deltaFormat > 3)
+        return;
+
+    const auto valueBits = 1 << deltaFormat;
+    const auto valuesPerU16 = 16 / valueBits;
+    const auto mask = 0xff >> (8 - valueBits);
+
+    std::uint16_t u16 = 0;
+    for (int valueIdx = 0; valueIdx <= endSize - startSize; ++valueIdx) {
+        if (valueIdx % valuesPerU16 == 0)
+            u16 = reader.readU16Be();
+
+        const auto u16rshift = (
+            (valuesPerU16 - 1 - valueIdx % valuesPerU16) * valueBits);
+
+        int value = (u16 >> u16rshift) & mask;
+        if (value >= (mask + 1) >> 1)
+            value -= mask + 1;
+
+        if (value != 0)
+            deltas.push_back({startSize + valueIdx, value});
+    }
+}
+
+
+// Returns the size of a ValueRecord in bytes.
+static std::uint32_t getValueRecordSize(int valueFormat)
+{
+    std::uint32_t result = 0;
+    for (int i = 0; i < 8; ++i)
+        if (valueFormat & (1 << i))
+            result += sizeof(std::uint16_t);
+
+    return result;
+}
+
+
 enum ValueIdx {
     valueIdxXPlacement,
     valueIdxYPlacement,
@@ -291,196 +811,518 @@ enum ValueIdx {
 };
 
 
+static int getDeviceAdjustment(
+    SpanReader& reader,
+    std::uint32_t subTablePos,
+    std::uint16_t deviceOffset,
+    LookupContext& ctx)
+{
+    auto& adjustments = ctx.deviceTableCache.adjustments;
+    const auto iter = adjustments.find(deviceOffset);
+    if (iter != adjustments.end())
+        return iter->second;
+
+    reader.seek(subTablePos + deviceOffset, SeekOrigin::set);
+    const auto adjustment = readDeviceAdjsutment(reader, ctx.pxSize);
+    adjustments[deviceOffset] = adjustment;
+    return adjustment;
+}
+
+
+static const std::vector<DeviceDelta>& getDeviceDeltas(
+    SpanReader& reader,
+    std::uint32_t subTablePos,
+    std::uint16_t deviceOffset,
+    LookupContext& ctx)
+{
+    auto& deltasMap = ctx.deviceTableCache.deltas;
+    const auto iter = deltasMap.find(deviceOffset);
+    if (iter != deltasMap.end())
+        return iter->second;
+
+    std::vector<DeviceDelta> deltas;
+    reader.seek(subTablePos + deviceOffset, SeekOrigin::set);
+    readDeviceDeltas(reader, deltas);
+    return deltasMap[deviceOffset] = std::move(deltas);
+}
+
+
+// Reads a ValueRecord from words that are already in native byte
+// order, advancing words past the record. Device tables are read
+// with the reader, keeping its position.
+//
+// If ctx.deltas is not null, device adjustments are not added to the
+// values. Instead, deltas of the xAdvance device table are appended
+// to xAdvanceDeltas, if it's not null.
 static void readValuesForSize(
-    Stream& stream,
+    SpanReader& reader,
     std::uint32_t subTablePos,
-    const LookupContext& ctx,
+    LookupContext& ctx,
+    const std::uint16_t*& words,
     int values[numValues],
-    int valueFormat)
+    int valueFormat,
+    std::vector<DeviceDelta>* xAdvanceDeltas = nullptr)
 {
     for (int i = 0; i < numValues; ++i)
         if (valueFormat & (1 << i))
-            values[i] = std::lround(stream.readS16Be() * ctx.scale);
+            values[i] = std::lround(
+                static_cast<std::int16_t>(*words++) * ctx.scale);
         else
             values[i] = 0;
 
     std::uint16_t deviceOffsets[numValues];
     for (int i = 0; i < numValues; ++i)
         if (valueFormat & (1 << (i + numValues)))
-            deviceOffsets[i] = stream.readU16Be();
+            deviceOffsets[i] = *words++;
         else
             deviceOffsets[i] = 0;
 
-    const auto prevPos = stream.getPosition();
+    const auto prevPos = reader.getPosition();
     for (int i = 0; i < numValues; ++i) {
         const auto deviceOffset = deviceOffsets[i];
         if (deviceOffset == 0)
             continue;
 
-        stream.seek(subTablePos + deviceOffset, SeekOrigin::set);
-        values[i] += readDeviceAdjsutment(stream, ctx.pxSize);
+        if (ctx.deltas) {
+            if (i != valueIdxXAdvance || !xAdvanceDeltas)
+                continue;
+
+            const auto& deltas = getDeviceDeltas(
+                reader, subTablePos, deviceOffset, ctx);
+            xAdvanceDeltas->insert(
+                xAdvanceDeltas->end(), deltas.begin(), deltas.end());
+        } else
+            values[i] += getDeviceAdjustment(
+                reader, subTablePos, deviceOffset, ctx);
     }
-    stream.seek(prevPos, SeekOrigin::set);
+    reader.seek(prevPos, SeekOrigin::set);
+}
+
+
+static void addDeltas(
+    LookupContext& ctx,
+    std::uint16_t glyphIdx1,
+    std::uint16_t glyphIdx2,
+    const std::vector<DeviceDelta>& deviceDeltas)
+{
+    for (const auto& deviceDelta : deviceDeltas)
+        ctx.deltas->push_back(
+            {glyphIdx1,
+                glyphIdx2,
+                deviceDelta.pxSize,
+                deviceDelta.amount});
+}
+
+
+// Returns -1 if the glyph has no class.
+static int findGlyphClass(
+    const std::vector<RawGlyphClass>& glyphClasses,
+    std::uint16_t glyphIdx)
+{
+    const auto iter = std::lower_bound(
+        glyphClasses.begin(),
+        glyphClasses.end(),
+        glyphIdx,
+        [](const RawGlyphClass& glyphClass, std::uint16_t glyphIdx)
+        {
+            return glyphClass.glyphIdx < glyphIdx;
+        });
+    if (iter == glyphClasses.end() || iter->glyphIdx != glyphIdx)
+        return -1;
+
+    return iter->glyphClass;
 }
 
 
-static void readGposPairAdjustmentFormat1(Stream& stream, LookupContext& ctx)
+// Returns true if any of the class tables has non-zero kerning for
+// the pair.
+static bool hasClassKerning(
+    const std::vector<RawKerningClassTable>& classTables,
+    std::uint16_t glyphIdx1,
+    std::uint16_t glyphIdx2)
+{
+    for (const auto& classTable : classTables) {
+        const auto class1 = findGlyphClass(
+            classTable.glyphClasses1, glyphIdx1);
+        if (class1 < 0)
+            continue;
+
+        const auto class2 = findGlyphClass(
+            classTable.glyphClasses2, glyphIdx2);
+        if (class2 < 0)
+            continue;
+
+        if (classTable.amounts[
+                static_cast<std::size_t>(class1) * classTable.numClasses2
+                + class2] != 0)
+            return true;
+    }
+
+    return false;
+}
+
+
+static void readPairSet(
+    SpanReader& reader,
+    std::uint32_t subTablePos,
+    LookupContext& ctx,
+    std::uint16_t glyphIdx1,
+    int valueFormat1,
+    int valueFormat2,
+    std::vector<std::uint16_t>& words)
+{
+    // PairValueRecord is secondGlyph followed by two ValueRecords,
+    // all of which are 16-bit.
+    const auto recordNumWords = 1 + (
+        getValueRecordSize(valueFormat1)
+        + getValueRecordSize(valueFormat2)) / sizeof(std::uint16_t);
+
+    const auto pairValueCount = reader.readU16Be();
+    words.resize(pairValueCount * recordNumWords);
+    reader.readU16BeArray(words.data(), words.size());
+
+    std::vector<DeviceDelta> deviceDeltas;
+
+    for (std::size_t i = 0; i < words.size(); i += recordNumWords) {
+        const auto glyphIdx2 = words[i];
+        if (!isInGlyphSet(ctx.glyphSet, glyphIdx2))
+            continue;
+
+        deviceDeltas.clear();
+
+        const auto* valueWords = &words[i + 1];
+        int values1[numValues];
+        readValuesForSize(
+            reader,
+            subTablePos,
+            ctx,
+            valueWords,
+            values1,
+            valueFormat1,
+            &deviceDeltas);
+        int values2[numValues];
+        readValuesForSize(
+            reader, subTablePos, ctx, valueWords, values2, valueFormat2);
+        (void)values2;
+
+        const auto amount = values1[valueIdxXAdvance];
+        if (amount == 0 && deviceDeltas.empty())
+            continue;
+
+        if (amount != 0)
+            ctx.kerningPairs.push_back({glyphIdx1, glyphIdx2, amount});
+
+        addDeltas(ctx, glyphIdx1, glyphIdx2, deviceDeltas);
+    }
+}
+
+
+static void readGposPairAdjustmentFormat1(
+    SpanReader& reader, LookupContext& ctx)
 {
     const auto subTablePos = (
-        stream.getPosition()
+        reader.getPosition()
         // Format
         - sizeof(std::uint16_t));
 
-    const auto coverageOffset = stream.readU16Be();
-    const auto valueFormat1 = stream.readU16Be();
-    const auto valueFormat2 = stream.readU16Be();
+    const auto coverageOffset = reader.readU16Be();
+    const auto valueFormat1 = reader.readU16Be();
+    const auto valueFormat2 = reader.readU16Be();
 
     if (!hasKerning(valueFormat1, valueFormat2))
         return;
 
-    const auto pairSetCount = stream.readU16Be();
+    ctx.hasPairSets = true;
 
-    const auto pairSetsPos = stream.getPosition();
+    const auto pairSetCount = reader.readU16Be();
 
-    stream.seek(subTablePos + coverageOffset, SeekOrigin::set);
-    const auto coverage = readCovarageTable(stream);
+    const auto pairSetsPos = reader.getPosition();
 
-    if (pairSetCount != coverage.size())
+    reader.seek(subTablePos + coverageOffset, SeekOrigin::set);
+    const auto coverage = readCoverageTable(reader);
+
+    const auto coverageSize = getCoverageSize(coverage);
+    if (pairSetCount != coverageSize)
         throw StreamError(str::format(
             "\"GPOS\" pair adjustment table format 1 "
             "pairSetCount (%" PRIu16 ") doesn't match the number of "
-            "glyphs in coverage table (%zu)",
+            "glyphs in coverage table (%" PRIu32 ")",
             pairSetCount,
-            coverage.size()));
-
-    stream.seek(pairSetsPos, SeekOrigin::set);
-    for (std::uint16_t i = 0; i < pairSetCount; ++i) {
-        const auto glyphIdx1 = coverage[i];
-
-        const auto pairSetOffset = stream.readU16Be();
+            coverageSize));
 
-        const auto pos = stream.getPosition();
-        stream.seek(subTablePos + pairSetOffset, SeekOrigin::set);
+    std::vector<std::uint16_t> words;
 
-        auto pairValueCount = stream.readU16Be();
-        while (pairValueCount--) {
-            const auto glyphIdx2 = stream.readU16Be();
-
-            int values1[numValues];
-            readValuesForSize(stream, subTablePos, ctx, values1, valueFormat1);
-            int values2[numValues];
-            readValuesForSize(stream, subTablePos, ctx, values2, valueFormat2);
-            (void)values2;
-            if (values1[valueIdxXAdvance] == 0)
+    std::uint32_t coverageIdx = 0;
+    for (const auto& range : coverage) {
+        for (std::uint32_t glyphIdx1 = range.first;
+                glyphIdx1 <= range.last;
+                ++glyphIdx1, ++coverageIdx) {
+            if (!isInGlyphSet(ctx.glyphSet, glyphIdx1))
                 continue;
 
-            ctx.kerningPairs.push_back(
-                {glyphIdx1, glyphIdx2, values1[valueIdxXAdvance]});
+            reader.seek(
+                pairSetsPos + coverageIdx * sizeof(std::uint16_t),
+                SeekOrigin::set);
+            const auto pairSetOffset = reader.readU16Be();
+            reader.seek(subTablePos + pairSetOffset, SeekOrigin::set);
+
+            readPairSet(
+                reader,
+                subTablePos,
+                ctx,
+                glyphIdx1,
+                valueFormat1,
+                valueFormat2,
+                words);
         }
+    }
+}
+
+
+static std::vector<RawGlyphClass> getRawGlyphClasses(
+    const ClassGlyphs& classGlyphs, const std::vector<int>& newClasses)
+{
+    std::vector<RawGlyphClass> result;
+    for (std::size_t i = 0; i < newClasses.size(); ++i) {
+        if (newClasses[i] < 0)
+            continue;
 
-        stream.seek(pos, SeekOrigin::set);
+        for (auto* glyphIdx = classGlyphs.begin(i);
+                glyphIdx < classGlyphs.end(i);
+                ++glyphIdx)
+            result.push_back(
+                {*glyphIdx, static_cast<std::uint16_t>(newClasses[i])});
     }
+
+    std::sort(
+        result.begin(), result.end(),
+        [](const RawGlyphClass& a, const RawGlyphClass& b)
+        {
+            return a.glyphIdx < b.glyphIdx;
+        });
+
+    return result;
 }
 
 
-static std::uint16_t getGlyphClass(
-    std::uint16_t glyphIdx, const GlyphClasses& classes)
+// Append a class table, keeping only the classes that have non-zero
+// kerning. amounts is a class1 x class2 matrix.
+static void addClassTable(
+    std::vector<RawKerningClassTable>& classTables,
+    const ClassGlyphs& class1,
+    const ClassGlyphs& class2,
+    const std::vector<int>& amounts)
 {
-    if (classes.size() < 2)
-        return 0;
+    const auto numClasses1 = class1.offsets.size() - 1;
+    const auto numClasses2 = class2.offsets.size() - 1;
+
+    // New class indices; -1 for removed classes.
+    std::vector<int> newClasses1(numClasses1, -1);
+    std::vector<int> newClasses2(numClasses2, -1);
+    for (std::size_t ci1 = 0; ci1 < numClasses1; ++ci1)
+        for (std::size_t ci2 = 0; ci2 < numClasses2; ++ci2)
+            if (amounts[ci1 * numClasses2 + ci2] != 0) {
+                newClasses1[ci1] = 0;
+                newClasses2[ci2] = 0;
+            }
+
+    std::uint16_t newNumClasses1 = 0;
+    for (auto& newClass : newClasses1)
+        if (newClass == 0)
+            newClass = newNumClasses1++;
 
-    for (std::uint16_t i = 1; i < classes.size(); ++i) {
-        const auto& glyphIndices = classes[i];
-        if (glyphIdx < glyphIndices.front()
-                || glyphIdx > glyphIndices.back())
+    if (newNumClasses1 == 0)
+        return;
+
+    std::uint16_t newNumClasses2 = 0;
+    for (auto& newClass : newClasses2)
+        if (newClass == 0)
+            newClass = newNumClasses2++;
+
+    RawKerningClassTable classTable;
+    classTable.glyphClasses1 = getRawGlyphClasses(class1, newClasses1);
+    classTable.glyphClasses2 = getRawGlyphClasses(class2, newClasses2);
+    classTable.numClasses1 = newNumClasses1;
+    classTable.numClasses2 = newNumClasses2;
+
+    classTable.amounts.resize(
+        static_cast<std::size_t>(newNumClasses1) * newNumClasses2);
+    for (std::size_t ci1 = 0; ci1 < numClasses1; ++ci1) {
+        if (newClasses1[ci1] < 0)
             continue;
 
-        const auto iter = std::lower_bound(
-            glyphIndices.begin(),
-            glyphIndices.end(),
-            glyphIdx);
-        if (iter != glyphIndices.end() && *iter == glyphIdx)
-            return i;
+        for (std::size_t ci2 = 0; ci2 < numClasses2; ++ci2) {
+            if (newClasses2[ci2] < 0)
+                continue;
+
+            classTable.amounts[
+                newClasses1[ci1] * newNumClasses2 + newClasses2[ci2]] = (
+                    amounts[ci1 * numClasses2 + ci2]);
+        }
     }
 
-    return 0;
+    classTables.push_back(std::move(classTable));
 }
 
 
-static void readGposPairAdjustmentFormat2(Stream& stream, LookupContext& ctx)
+static void readGposPairAdjustmentFormat2(
+    SpanReader& reader, LookupContext& ctx)
 {
     const auto subTablePos = (
-        stream.getPosition()
+        reader.getPosition()
         // Format
         - sizeof(std::uint16_t));
 
-    const auto coverageOffset = stream.readU16Be();
-    const auto valueFormat1 = stream.readU16Be();
-    const auto valueFormat2 = stream.readU16Be();
+    const auto coverageOffset = reader.readU16Be();
+    const auto valueFormat1 = reader.readU16Be();
+    const auto valueFormat2 = reader.readU16Be();
 
     if (!hasKerning(valueFormat1, valueFormat2))
         return;
 
-    const auto classDef1Offset = stream.readU16Be();
-    const auto classDef2Offset = stream.readU16Be();
-    const auto class1Count = stream.readU16Be();
+    const auto classDef1Offset = reader.readU16Be();
+    const auto classDef2Offset = reader.readU16Be();
+    const auto class1Count = reader.readU16Be();
     if (class1Count == 0)
         throw StreamError(
             "\"GPOS\" pair adjustment format 2 class 1 count is 0");
-    const auto class2Count = stream.readU16Be();
+    const auto class2Count = reader.readU16Be();
     if (class2Count == 0)
         throw StreamError(
             "\"GPOS\" pair adjustment format 2 class 2 count is 0");
 
-    const auto valuesPos = stream.getPosition();
+    const auto valuesPos = reader.getPosition();
+
+    reader.seek(subTablePos + coverageOffset, SeekOrigin::set);
+    const auto coverage = readCoverageTable(reader);
+
+    reader.seek(subTablePos + classDef1Offset, SeekOrigin::set);
+    const auto classDef1 = readClassDefTable(reader, class1Count);
+    reader.seek(subTablePos + classDef2Offset, SeekOrigin::set);
+    const auto classDef2 = readClassDefTable(reader, class2Count);
+
+    std::vector<ClassedGlyph> classedGlyphs;
+
+    // The first glyph of a pair must be in the coverage table; glyphs
+    // not assigned to a class go to class 0.
+    for (const auto& range : coverage)
+        for (std::uint32_t glyphIdx = range.first;
+                glyphIdx <= range.last;
+                ++glyphIdx)
+            if (isInGlyphSet(ctx.glyphSet, glyphIdx))
+                classedGlyphs.push_back({
+                    getGlyphClass(classDef1, glyphIdx),
+                    static_cast<std::uint16_t>(glyphIdx)});
+
+    const auto class1 = groupGlyphsByClass(classedGlyphs, class1Count);
+
+    classedGlyphs.clear();
+    for (const auto& range : classDef2)
+        for (std::uint32_t glyphIdx = range.first;
+                glyphIdx <= range.last;
+                ++glyphIdx)
+            if (isInGlyphSet(ctx.glyphSet, glyphIdx))
+                classedGlyphs.push_back({
+                    range.glyphClass,
+                    static_cast<std::uint16_t>(glyphIdx)});
+
+    const auto class2 = groupGlyphsByClass(classedGlyphs, class2Count);
+
+    const auto valueRecordsSize = (
+        getValueRecordSize(valueFormat1)
+        + getValueRecordSize(valueFormat2));
+
+    std::vector<int> amounts;
+    if (ctx.classTables)
+        amounts.resize(
+            static_cast<std::size_t>(class1Count) * class2Count);
+
+    std::vector<DeviceDelta> deviceDeltas;
+
+    // Class2Record is two ValueRecords, all of which are 16-bit.
+    const auto recordNumWords = valueRecordsSize / sizeof(std::uint16_t);
+    std::vector<std::uint16_t> rowWords(class2Count * recordNumWords);
+
+    reader.seek(valuesPos, SeekOrigin::set);
+    for (std::size_t ci1 = 0; ci1 < class1Count; ++ci1) {
+        // Skip empty classes without reading device tables.
+        if (class1.isEmpty(ci1)) {
+            reader.seek(
+                class2Count * valueRecordsSize, SeekOrigin::cur);
+            continue;
+        }
 
-    stream.seek(subTablePos + coverageOffset, SeekOrigin::set);
-    const auto coverage = readCovarageTable(stream);
+        reader.readU16BeArray(rowWords.data(), rowWords.size());
 
-    stream.seek(subTablePos + classDef1Offset, SeekOrigin::set);
-    auto class1 = readClassDefTable(stream, class1Count);
-    stream.seek(subTablePos + classDef2Offset, SeekOrigin::set);
-    const auto class2 = readClassDefTable(stream, class2Count);
+        for (std::size_t ci2 = 0; ci2 < class2Count; ++ci2) {
+            if (class2.isEmpty(ci2))
+                continue;
 
-    // Glyphs not assigned to a class go to class 0.
-    for (auto glyphIdx : coverage) {
-        const auto glyphClass = getGlyphClass(glyphIdx, class1);
-        if (glyphClass == 0)
-            class1[0].push_back(glyphIdx);
-    }
+            deviceDeltas.clear();
 
-    stream.seek(valuesPos, SeekOrigin::set);
-    for (std::uint16_t ci1 = 0; ci1 < class1Count; ++ci1) {
-        for (std::uint16_t ci2 = 0; ci2 < class2Count; ++ci2) {
+            const auto* valueWords = &rowWords[ci2 * recordNumWords];
             int values1[numValues];
-            readValuesForSize(stream, subTablePos, ctx, values1, valueFormat1);
+            readValuesForSize(
+                reader,
+                subTablePos,
+                ctx,
+                valueWords,
+                values1,
+                valueFormat1,
+                &deviceDeltas);
             int values2[numValues];
-            readValuesForSize(stream, subTablePos, ctx, values2, valueFormat2);
+            readValuesForSize(
+                reader, subTablePos, ctx, valueWords, values2, valueFormat2);
             (void)values2;
-            if (values1[valueIdxXAdvance] == 0)
+
+            const auto amount = values1[valueIdxXAdvance];
+            if (amount == 0 && deviceDeltas.empty())
                 continue;
 
-            ctx.kerningPairs.reserve(
-                ctx.kerningPairs.size()
-                + class1[ci1].size() * class2[ci2].size());
-            for (auto glyphIdx1 : class1[ci1])
-                for (auto glyphIdx2 : class2[ci2])
+            // Device deltas are always expanded to pairs; they are
+            // rare in class-based subtables.
+            if (!deviceDeltas.empty())
+                for (auto* glyphIdx1 = class1.begin(ci1);
+                        glyphIdx1 < class1.end(ci1);
+                        ++glyphIdx1)
+                    for (auto* glyphIdx2 = class2.begin(ci2);
+                            glyphIdx2 < class2.end(ci2);
+                            ++glyphIdx2)
+                        addDeltas(ctx, *glyphIdx1, *glyphIdx2, deviceDeltas);
+
+            if (amount == 0)
+                continue;
+
+            if (ctx.classTables) {
+                amounts[ci1 * class2Count + ci2] = amount;
+                continue;
+            }
+
+            // No reserve() here: growing by the exact size for every
+            // class pair would reallocate and copy all pairs each time.
+            for (auto* glyphIdx1 = class1.begin(ci1);
+                    glyphIdx1 < class1.end(ci1);
+                    ++glyphIdx1)
+                for (auto* glyphIdx2 = class2.begin(ci2);
+                        glyphIdx2 < class2.end(ci2);
+                        ++glyphIdx2)
                     ctx.kerningPairs.push_back(
-                        {glyphIdx1,
-                            glyphIdx2,
-                            values1[valueIdxXAdvance]});
+                        {*glyphIdx1, *glyphIdx2, amount});
         }
     }
+
+    if (ctx.classTables)
+        addClassTable(*ctx.classTables, class1, class2, amounts);
 }
 
 
-static void readGposPairAdjustment(Stream& stream, LookupContext& ctx)
+static void readGposPairAdjustment(SpanReader& reader, LookupContext& ctx)
 {
-    const auto posFormat = stream.readU16Be();
+    const auto posFormat = reader.readU16Be();
     if (posFormat == 1)
-        readGposPairAdjustmentFormat1(stream, ctx);
+        readGposPairAdjustmentFormat1(reader, ctx);
     else if (posFormat == 2)
-        readGposPairAdjustmentFormat2(stream, ctx);
+        readGposPairAdjustmentFormat2(reader, ctx);
     else
         throw StreamError(str::format(
             "Unknown format of \"GPOS\" pair adjustment subtable: "
@@ -489,54 +1331,19 @@ static void readGposPairAdjustment(Stream& stream, LookupContext& ctx)
 }
 
 
-static void readGposSubtable(
-    Stream& stream, LookupContext& ctx, int lookupType);
-
-
-static void readGposExtension(Stream& stream, LookupContext& ctx)
-{
-    const auto subTableOffset = stream.getPosition();
-
-    const auto posFormat = stream.readU16Be();
-    if (posFormat != 1)
-        throw StreamError(str::format(
-            "Unknown format of \"GPOS\" extension subtable: %" PRIu16,
-            posFormat));
-
-    const auto extensionLookupType = stream.readU16Be();
-    if (extensionLookupType == gposLookupExtension)
-        throw StreamError(
-            "\"GPOS\" extension subtables cannot be nested");
-
-    stream.seek(
-        subTableOffset + stream.readU32Be(), SeekOrigin::set);
-    readGposSubtable(stream, ctx, extensionLookupType);
-}
-
-
-static void readGposSubtable(
-    Stream& stream, LookupContext& ctx, int lookupType)
-{
-    if (lookupType == gposLookupPairAdjustment)
-        readGposPairAdjustment(stream, ctx);
-    else if (lookupType == gposLookupExtension)
-        readGposExtension(stream, ctx);
-}
-
-
 static void appendFeatureTable(
-    Stream& stream,
+    SpanReader& reader,
     std::vector<std::uint16_t>& lookupIndices,
     bool ignoreDuplicates = true)
 {
     // Skip featureParams
-    stream.seek(sizeof(std::uint16_t), SeekOrigin::cur);
+    reader.seek(sizeof(std::uint16_t), SeekOrigin::cur);
 
-    auto lookupIdxCount = stream.readU16Be();
+    auto lookupIdxCount = reader.readU16Be();
     if (!ignoreDuplicates)
         lookupIndices.reserve(lookupIndices.size() + lookupIdxCount);
     while (lookupIdxCount--) {
-        const auto lookupIdx = stream.readU16Be();
+        const auto lookupIdx = reader.readU16Be();
         if (ignoreDuplicates
                 && std::find(
                     lookupIndices.begin(),
@@ -549,23 +1356,121 @@ static void appendFeatureTable(
 }
 
 
-static std::vector<std::uint16_t> getAllKernFeatures(
-    Stream& stream,
-    std::uint32_t featureListPos)
+// Returns the offset of the record with the given tag from a list
+// of tag records (ScriptList, LangSysRecords), or 0 if there is no
+// such record. The reader should be at the record count.
+static std::uint16_t findTagRecord(SpanReader& reader, std::uint32_t tag)
+{
+    auto recordCount = reader.readU16Be();
+    while (recordCount--) {
+        const auto recordTag = reader.readU32Be();
+        const auto recordOffset = reader.readU16Be();
+        if (recordTag == tag)
+            return recordOffset;
+    }
+
+    return 0;
+}
+
+
+static void addLangSysFeatures(
+    SpanReader& reader, std::vector<bool>& enabledFeatures)
+{
+    const auto checkFeatureIdx = [&](std::uint16_t featureIdx)
+    {
+        if (featureIdx >= enabledFeatures.size())
+            throw StreamError(str::format(
+                "LangSys featureIdx (%" PRIu16 ") >= "
+                "featureCount (%zu)",
+                featureIdx,
+                enabledFeatures.size()));
+    };
+
+    // Skip lookupOrderOffset
+    reader.seek(sizeof(std::uint16_t), SeekOrigin::cur);
+
+    const auto requiredFeatureIdx = reader.readU16Be();
+    if (requiredFeatureIdx != 0xffff) {
+        checkFeatureIdx(requiredFeatureIdx);
+        enabledFeatures[requiredFeatureIdx] = true;
+    }
+
+    auto featureIdxCount = reader.readU16Be();
+    while (featureIdxCount--) {
+        const auto featureIdx = reader.readU16Be();
+        checkFeatureIdx(featureIdx);
+        enabledFeatures[featureIdx] = true;
+    }
+}
+
+
+// Returns features of the language systems that are resolved for the
+// scope, as a flag for every feature index.
+static std::vector<bool> getScopeFeatures(
+    SpanReader& reader,
+    std::uint32_t scriptListPos,
+    std::uint32_t featureListPos,
+    const KerningScope& scope)
+{
+    reader.seek(featureListPos, SeekOrigin::set);
+    std::vector<bool> enabledFeatures(reader.readU16Be());
+
+    for (const auto scriptTag : scope.scriptTags) {
+        reader.seek(scriptListPos, SeekOrigin::set);
+        auto scriptOffset = findTagRecord(reader, scriptTag);
+        if (scriptOffset == 0) {
+            // Shaping engines use the default script for scripts
+            // the font knows nothing about.
+            reader.seek(scriptListPos, SeekOrigin::set);
+            scriptOffset = findTagRecord(
+                reader, sfntTag('D', 'F', 'L', 'T'));
+            if (scriptOffset == 0)
+                continue;
+        }
+
+        const auto scriptPos = scriptListPos + scriptOffset;
+        reader.seek(scriptPos, SeekOrigin::set);
+
+        const auto defaultLangSysOffset = reader.readU16Be();
+        std::uint16_t langSysOffset = 0;
+        if (scope.langTag != 0)
+            langSysOffset = findTagRecord(reader, scope.langTag);
+        if (langSysOffset == 0)
+            langSysOffset = defaultLangSysOffset;
+        if (langSysOffset == 0)
+            continue;
+
+        reader.seek(scriptPos + langSysOffset, SeekOrigin::set);
+        addLangSysFeatures(reader, enabledFeatures);
+    }
+
+    return enabledFeatures;
+}
+
+
+// If enabledFeatures is null, "kern" features of all scripts and
+// languages are collected.
+static std::vector<std::uint16_t> getKernFeatures(
+    SpanReader& reader,
+    std::uint32_t featureListPos,
+    const std::vector<bool>* enabledFeatures)
 {
     std::vector<std::uint16_t> lookupIndices;
 
-    stream.seek(featureListPos, SeekOrigin::set);
-    auto featureCount = stream.readU16Be();
-    while (featureCount--) {
-        const auto featureTag = stream.readU32Be();
-        const auto featureOffset = stream.readU16Be();
-        if (featureTag != sfntTag('k', 'e', 'r', 'n'))
+    reader.seek(featureListPos, SeekOrigin::set);
+    const auto featureCount = reader.readU16Be();
+    for (std::uint16_t featureIdx = 0;
+            featureIdx < featureCount;
+            ++featureIdx) {
+        const auto featureTag = reader.readU32Be();
+        const auto featureOffset = reader.readU16Be();
+        if (featureTag != sfntTag('k', 'e', 'r', 'n')
+                || (enabledFeatures && !(*enabledFeatures)[featureIdx]))
             continue;
 
-        const auto prevPos = stream.getPosition();
+        const auto prevPos = reader.getPosition();
 
-        stream.seek(featureListPos + featureOffset, SeekOrigin::set);
+        reader.seek(featureListPos + featureOffset, SeekOrigin::set);
         // There can be duplicate lookup indices, since some
         // applications don't optimize the feature list, creating
         // a separate set of feature records for every language
@@ -573,50 +1478,85 @@ static std::vector<std::uint16_t> getAllKernFeatures(
         // script with BGR, SRB, and default language, there may
         // be 4 separate "kern" feature records with the same
         // feature table.
-        appendFeatureTable(stream, lookupIndices, true);
+        appendFeatureTable(reader, lookupIndices, true);
 
-        stream.seek(prevPos, SeekOrigin::set);
+        reader.seek(prevPos, SeekOrigin::set);
     }
 
     return lookupIndices;
 }
 
 
-static void readLookupTable(Stream& stream, LookupContext& ctx)
+// Returns the position of the pair adjustment subtable an extension
+// subtable points to, or 0 if the extension is of another type.
+static std::uint32_t readGposExtension(SpanReader& reader)
 {
-    const auto lookupTablePos = stream.getPosition();
+    const auto subTablePos = reader.getPosition();
+
+    const auto posFormat = reader.readU16Be();
+    if (posFormat != 1)
+        throw StreamError(str::format(
+            "Unknown format of \"GPOS\" extension subtable: %" PRIu16,
+            posFormat));
 
-    const auto lookupType = stream.readU16Be();
+    const auto extensionLookupType = reader.readU16Be();
+    if (extensionLookupType == gposLookupExtension)
+        throw StreamError(
+            "\"GPOS\" extension subtables cannot be nested");
+    if (extensionLookupType != gposLookupPairAdjustment)
+        return 0;
+
+    return subTablePos + reader.readU32Be();
+}
+
+
+static void appendPairAdjustmentSubtables(
+    SpanReader& reader, std::vector<std::uint32_t>& subTablePositions)
+{
+    const auto lookupTablePos = reader.getPosition();
+
+    const auto lookupType = reader.readU16Be();
     if (lookupType != gposLookupPairAdjustment
             && lookupType != gposLookupExtension)
         return;
 
     // Skip lookupFlag
-    stream.seek(sizeof(std::uint16_t), SeekOrigin::cur);
+    reader.seek(sizeof(std::uint16_t), SeekOrigin::cur);
 
-    auto subTableCount = stream.readU16Be();
+    auto subTableCount = reader.readU16Be();
     while (subTableCount--) {
-        const auto subTableOffset = stream.readU16Be();
-        const auto prevPos = stream.getPosition();
+        const auto subTableOffset = reader.readU16Be();
+        const auto subTablePos = lookupTablePos + subTableOffset;
+
+        if (lookupType == gposLookupPairAdjustment) {
+            subTablePositions.push_back(subTablePos);
+            continue;
+        }
 
-        stream.seek(
-            lookupTablePos + subTableOffset, SeekOrigin::set);
-        readGposSubtable(stream, ctx, lookupType);
+        const auto prevPos = reader.getPosition();
 
-        stream.seek(prevPos, SeekOrigin::set);
+        reader.seek(subTablePos, SeekOrigin::set);
+        const auto extensionSubTablePos = readGposExtension(reader);
+        if (extensionSubTablePos != 0)
+            subTablePositions.push_back(extensionSubTablePos);
+
+        reader.seek(prevPos, SeekOrigin::set);
     }
 }
 
 
-static void lookupFeatures(
-    Stream& stream,
+// Returns positions of pair adjustment subtables of the lookups, in
+// the order they should be applied.
+static std::vector<std::uint32_t> getPairAdjustmentSubtables(
+    SpanReader& reader,
     std::uint32_t lookupListPos,
-    LookupContext& ctx,
     const std::vector<std::uint16_t>& lookupIndices)
 {
-    stream.seek(lookupListPos, SeekOrigin::set);
+    std::vector<std::uint32_t> subTablePositions;
+
+    reader.seek(lookupListPos, SeekOrigin::set);
 
-    const auto lookupCount = stream.readU16Be();
+    const auto lookupCount = reader.readU16Be();
 
     for (const auto lookupIdx : lookupIndices) {
         if (lookupIdx >= lookupCount)
@@ -626,52 +1566,302 @@ static void lookupFeatures(
                 lookupIdx,
                 lookupCount));
 
-        stream.seek(
+        reader.seek(
             lookupListPos
             + sizeof(std::uint16_t)  // lookupCount
             + sizeof(std::uint16_t) * lookupIdx,
             SeekOrigin::set);
-        const auto lookupOffset = stream.readU16Be();
+        const auto lookupOffset = reader.readU16Be();
 
-        stream.seek(lookupListPos + lookupOffset, SeekOrigin::set);
-        readLookupTable(stream, ctx);
+        reader.seek(lookupListPos + lookupOffset, SeekOrigin::set);
+        appendPairAdjustmentSubtables(reader, subTablePositions);
+    }
+
+    return subTablePositions;
+}
+
+
+struct SubtableResult {
+    std::vector<RawKerningPair> kerningPairs;
+    std::vector<RawKerningClassTable> classTables;
+    std::vector<RawKerningDelta> deltas;
+    bool hasPairSets;
+    // Stream stats of the worker thread that read the subtable.
+    streams::StreamStats ioStats;
+};
+
+
+static void readSubtable(
+    const SpanReader& tableReader,
+    std::uint32_t subTablePos,
+    const LookupContext& ctxTemplate,
+    SubtableResult& result)
+{
+    auto reader = tableReader;
+    reader.seek(subTablePos, SeekOrigin::set);
+
+    auto ctx = ctxTemplate;
+    if (ctx.classTables)
+        ctx.classTables = &result.classTables;
+    if (ctx.deltas)
+        ctx.deltas = &result.deltas;
+
+    readGposPairAdjustment(reader, ctx);
+
+    result.kerningPairs = std::move(ctx.kerningPairs);
+    result.hasPairSets = ctx.hasPairSets;
+}
+
+
+static std::uint32_t getGlyphPairKey(
+    std::uint16_t glyphIdx1, std::uint16_t glyphIdx2)
+{
+    return (static_cast<std::uint32_t>(glyphIdx1) << 16) | glyphIdx2;
+}
+
+
+// Glyph pair with deltas and the first subtable that has a kerning
+// pair or deltas for it.
+struct DeltaOwner {
+    std::uint32_t glyphPairKey;
+    std::size_t subtableIdx;
+};
+
+
+static std::vector<DeltaOwner>::iterator findDeltaOwner(
+    std::vector<DeltaOwner>& owners,
+    std::uint16_t glyphIdx1,
+    std::uint16_t glyphIdx2)
+{
+    const auto key = getGlyphPairKey(glyphIdx1, glyphIdx2);
+    const auto iter = std::lower_bound(
+        owners.begin(),
+        owners.end(),
+        key,
+        [](const DeltaOwner& owner, std::uint32_t key)
+        {
+            return owner.glyphPairKey < key;
+        });
+    if (iter == owners.end() || iter->glyphPairKey != key)
+        return owners.end();
+
+    return iter;
+}
+
+
+// Deltas of a pair belong to the first subtable that has the pair,
+// the same way as the kerning pair itself wins the deduplication.
+// Otherwise, deltas of a later subtable would be applied to the
+// amount of an earlier one. The result is sorted by keys.
+static std::vector<DeltaOwner> getDeltaOwners(
+    const std::vector<SubtableResult>& results)
+{
+    std::vector<DeltaOwner> owners;
+    for (std::size_t i = 0; i < results.size(); ++i)
+        for (const auto& delta : results[i].deltas)
+            owners.push_back(
+                {getGlyphPairKey(delta.glyphIdx1, delta.glyphIdx2), i});
+
+    if (owners.empty())
+        return owners;
+
+    std::sort(
+        owners.begin(), owners.end(),
+        [](const DeltaOwner& a, const DeltaOwner& b)
+        {
+            if (a.glyphPairKey != b.glyphPairKey)
+                return a.glyphPairKey < b.glyphPairKey;
+            else
+                return a.subtableIdx < b.subtableIdx;
+        });
+    owners.erase(
+        std::unique(
+            owners.begin(), owners.end(),
+            [](const DeltaOwner& a, const DeltaOwner& b)
+            {
+                return a.glyphPairKey == b.glyphPairKey;
+            }),
+        owners.end());
+
+    std::size_t lastOwnerIdx = 0;
+    for (const auto& owner : owners)
+        lastOwnerIdx = std::max(lastOwnerIdx, owner.subtableIdx);
+
+    // Pairs of later subtables can't take the ownership.
+    for (std::size_t i = 0; i < lastOwnerIdx; ++i)
+        for (const auto& pair : results[i].kerningPairs) {
+            const auto iter = findDeltaOwner(
+                owners, pair.glyphIdx1, pair.glyphIdx2);
+            if (iter != owners.end() && iter->subtableIdx > i)
+                iter->subtableIdx = i;
+        }
+
+    return owners;
+}
+
+
+// Subtables are independent, so they are read concurrently, each
+// with its own copy of the reader. The results are then
+// concatenated in the original order, so that the first pair still
+// wins during deduplication.
+static void readSubtables(
+    const SpanReader& tableReader,
+    const std::vector<std::uint32_t>& subTablePositions,
+    unsigned maxThreads,
+    LookupContext& ctx)
+{
+    const auto numSubtables = subTablePositions.size();
+    std::vector<SubtableResult> results(numSubtables);
+    std::vector<std::exception_ptr> errors(numSubtables);
+    std::atomic<std::size_t> nextIdx {0};
+
+    auto* ioStats = streams::getCurrentStreamStats();
+
+    const auto worker = [&]()
+    {
+        while (true) {
+            const auto i = nextIdx++;
+            if (i >= numSubtables)
+                break;
+
+            const streams::StreamStatsScope ioScope(
+                ioStats ? &results[i].ioStats : nullptr);
+
+            trace::Span span("kerning subtable", "kerning");
+            span.addArg("offset", subTablePositions[i]);
+
+            try {
+                readSubtable(
+                    tableReader, subTablePositions[i], ctx, results[i]);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }
+    };
+
+    if (maxThreads == 0)
+        maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    const auto numThreads = std::min<std::size_t>(maxThreads, numSubtables);
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < numThreads; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+
+    // Report the same error as if the subtables were read in order.
+    for (const auto& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+
+    std::size_t numPairs = 0;
+    for (const auto& result : results)
+        numPairs += result.kerningPairs.size();
+    ctx.kerningPairs.reserve(numPairs);
+
+    auto deltaOwners = getDeltaOwners(results);
+
+    for (std::size_t i = 0; i < numSubtables; ++i) {
+        auto& result = results[i];
+        if (ioStats)
+            *ioStats += result.ioStats;
+
+        // At this point, ctx.classTables only has the class tables of
+        // the preceding subtables.
+        const auto isShadowed = [&](
+            std::uint16_t glyphIdx1, std::uint16_t glyphIdx2)
+        {
+            return (
+                ctx.classTables
+                && hasClassKerning(*ctx.classTables, glyphIdx1, glyphIdx2));
+        };
+
+        for (const auto& pair : result.kerningPairs)
+            if (!result.hasPairSets
+                    || !isShadowed(pair.glyphIdx1, pair.glyphIdx2))
+                ctx.kerningPairs.push_back(pair);
+
+        // Unlike pairs, deltas are expanded from class-based subtables
+        // as well, so they are checked regardless of the format.
+        if (ctx.deltas)
+            for (const auto& delta : result.deltas) {
+                const auto owner = findDeltaOwner(
+                    deltaOwners, delta.glyphIdx1, delta.glyphIdx2);
+                if (owner->subtableIdx == i
+                        && !isShadowed(delta.glyphIdx1, delta.glyphIdx2))
+                    ctx.deltas->push_back(delta);
+            }
+
+        if (ctx.classTables)
+            for (auto& classTable : result.classTables)
+                ctx.classTables->push_back(std::move(classTable));
     }
 }
 
 
 std::vector<RawKerningPair> readKerningPairsGpos(
-    Stream& stream,
+    const SpanReader& fontReader,
     const SfntOffsetTable& sfntOffsetTable,
-    const KerningParams& params)
+    const KerningParams& params,
+    const GlyphSet* glyphSet,
+    std::vector<RawKerningClassTable>* classTables,
+    std::vector<RawKerningDelta>* deltas,
+    bool* hasPairAdjustments,
+    unsigned maxThreads)
 {
+    if (hasPairAdjustments)
+        *hasPairAdjustments = false;
+
     const auto tableOffset = sfntOffsetTable.getTableOffset(
         sfntTag('G', 'P', 'O', 'S'));
     if (tableOffset == 0)
         return {};
 
-    stream.seek(tableOffset, SeekOrigin::set);
+    auto reader = fontReader.getSubSpan(tableOffset);
 
-    const auto versionMajor = stream.readU16Be();
+    const auto versionMajor = reader.readU16Be();
     if (versionMajor != 1)
         throw StreamError(str::format(
             "Unsupported \"GPOS\" major version %" PRIu16,
             versionMajor));
     // Skip minor version
-    stream.seek(sizeof(std::uint16_t), SeekOrigin::cur);
+    reader.seek(sizeof(std::uint16_t), SeekOrigin::cur);
+
+    const auto scriptListOffset = reader.readU16Be();
+    const auto featureListOffset = reader.readU16Be();
+    const auto lookupListOffset = reader.readU16Be();
 
-    // Skip scriptListOffset
-    stream.seek(sizeof(std::uint16_t), SeekOrigin::cur);
-    const auto featureListOffset = stream.readU16Be();
-    const auto lookupListOffset = stream.readU16Be();
+    std::vector<bool> enabledFeatures;
+    if (!params.scope.scriptTags.empty())
+        enabledFeatures = getScopeFeatures(
+            reader, scriptListOffset, featureListOffset, params.scope);
 
-    const auto lookupIndices = getAllKernFeatures(
-        stream, tableOffset + featureListOffset);
+    const auto lookupIndices = getKernFeatures(
+        reader,
+        featureListOffset,
+        params.scope.scriptTags.empty() ? nullptr : &enabledFeatures);
 
     LookupContext ctx;
     ctx.pxSize = params.pxSize;
     ctx.scale = getScale(params);
-    lookupFeatures(
-        stream, tableOffset + lookupListOffset, ctx, lookupIndices);
+    ctx.glyphSet = glyphSet;
+    ctx.classTables = classTables;
+    // Deltas are returned separately only for font units, since
+    // the amounts are not for a specific size in this case.
+    std::vector<RawKerningDelta> ignoredDeltas;
+    if (params.units == KerningUnits::font)
+        ctx.deltas = deltas ? deltas : &ignoredDeltas;
+    else
+        ctx.deltas = nullptr;
+    ctx.hasPairSets = false;
+
+    const auto subTablePositions = getPairAdjustmentSubtables(
+        reader, lookupListOffset, lookupIndices);
+    if (hasPairAdjustments)
+        *hasPairAdjustments = !subTablePositions.empty();
+
+    readSubtables(reader, subTablePositions, maxThreads, ctx);
 
     return std::move(ctx.kerningPairs);
 }
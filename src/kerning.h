@@ -1,10 +1,14 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "sfnt.h"
-#include "streams/stream.h"
+#include "streams/span_reader.h"
 
 
 namespace dpfb {
@@ -17,22 +21,275 @@ struct RawKerningPair {
 };
 
 
+struct KerningPair {
+    char32_t cp1;
+    char32_t cp2;
+    int amount;
+};
+
+
+/**
+ * Code point and its kerning class.
+ */
+struct KerningClassEntry {
+    char32_t cp;
+    std::uint16_t kerningClass;
+};
+
+
+/**
+ * Class-based kerning
+ *
+ * The amount for a pair of code points is
+ * amounts[leftClass * numRightClasses + rightClass], where the
+ * classes are taken from leftClasses and rightClasses, both sorted by
+ * code points. A pair of code points has no kerning in the table
+ * if any of them is not in the corresponding list.
+ */
+struct KerningClassTable {
+    std::vector<KerningClassEntry> leftClasses;
+    std::vector<KerningClassEntry> rightClasses;
+    std::uint16_t numLeftClasses;
+    std::uint16_t numRightClasses;
+    std::vector<int> amounts;
+};
+
+
+/**
+ * Sort kerning pairs by code points and remove duplicates.
+ *
+ * Of the pairs with the same code points, only the first one is
+ * kept, so the order of pairs from different sources matters.
+ */
+void sortKerningPairsUnique(std::vector<KerningPair>& pairs);
+
+
+/**
+ * Expand class tables to kerning pairs.
+ *
+ * The amount for a pair of code points is taken from the first
+ * source that has a non-zero amount for the pair: the pairs, then
+ * the tables in order. The pairs must be sorted and unique, as
+ * produced by sortKerningPairsUnique(); so is the result.
+ */
+std::vector<KerningPair> expandKerningClasses(
+    const std::vector<KerningPair>& pairs,
+    const std::vector<KerningClassTable>& classTables);
+
+
+/**
+ * Kerning delta for a specific size.
+ *
+ * Deltas come from device tables, which adjust kerning at specific
+ * pixel per em sizes. They are only returned separately with
+ * KerningUnits::font; otherwise, the delta for the baked size is
+ * already included in the kerning amount.
+ */
+struct KerningDelta {
+    char32_t cp1;
+    char32_t cp2;
+    int pxSize;
+    int amount;
+};
+
+
+enum class KerningUnits {
+    // Pixels of the baked size
+    px,
+    // Font design units
+    font
+};
+
+
+/**
+ * Convert kerning pairs from font units to pixels.
+ *
+ * Deltas for pxSize are added to the scaled amounts. Pairs with the
+ * resulting amount of 0 are removed. The pairs and the deltas must be
+ * sorted by code points; so is the result.
+ */
+std::vector<KerningPair> scaleKerningPairs(
+    const std::vector<KerningPair>& pairs,
+    const std::vector<KerningDelta>& deltas,
+    int pxSize,
+    int unitsPerEm);
+
+
+/**
+ * Number of occurrences of code point pairs in a text corpus.
+ */
+class BigramCounts {
+public:
+    /**
+     * Count all pairs of adjacent code points in UTF-8 text.
+     */
+    void addText(const char* str, std::size_t size);
+
+    std::uint32_t getCount(char32_t cp1, char32_t cp2) const;
+private:
+    std::unordered_map<std::uint64_t, std::uint32_t> counts;
+};
+
+
+/**
+ * Limits of the number of kerning pairs.
+ *
+ * Pairs with the absolute amount less than minAmount are removed. If
+ * there are still more than maxPairs pairs (and maxPairs is not 0),
+ * the pairs are ranked and only the top maxPairs are kept. Without
+ * bigramCounts, pairs are ranked by absolute amount. With
+ * bigramCounts, they are ranked by the absolute amount multiplied by
+ * the number of occurrences of the pair, and then by absolute amount
+ * for pairs that never occur in the corpus.
+ */
+struct KerningBudget {
+    std::size_t maxPairs;
+    int minAmount;
+    std::shared_ptr<const BigramCounts> bigramCounts;
+};
+
+
+/**
+ * Returns true if the budget can remove pairs.
+ */
+bool isKerningBudgetSet(const KerningBudget& budget);
+
+
+/**
+ * Apply the budget to kerning pairs, keeping their order.
+ *
+ * If deltas is not null, deltas of the removed pairs are also
+ * removed. Deltas of pairs that are not in the list (those with the
+ * amount of 0 in font units) are not subject to the budget.
+ *
+ * Returns the number of removed pairs.
+ */
+std::size_t applyKerningBudget(
+    std::vector<KerningPair>& pairs,
+    const KerningBudget& budget,
+    std::vector<KerningDelta>* deltas = nullptr);
+
+
+/**
+ * Scripts and language for which "GPOS" kerning is read.
+ *
+ * Tags are made with sfntTag() and padded with spaces, like
+ * sfntTag('l', 'a', 't', 'n') or sfntTag('R', 'U', 'S', ' ').
+ */
+struct KerningScope {
+    // If empty, kerning of all scripts and languages is read.
+    std::vector<std::uint32_t> scriptTags;
+    // If 0, or if a script has no such language, the default
+    // language of the script is used.
+    std::uint32_t langTag;
+};
+
+
 struct KerningParams {
     int pxSize;
     int pxPerEm;
+    KerningUnits units;
+    KerningScope scope;
+};
+
+
+struct RawGlyphClass {
+    std::uint16_t glyphIdx;
+    std::uint16_t glyphClass;
 };
 
 
+struct RawKerningDelta {
+    std::uint16_t glyphIdx1;
+    std::uint16_t glyphIdx2;
+    int pxSize;
+    int amount;
+};
+
+
+/**
+ * Class-based kerning of glyph indices.
+ *
+ * This is the same as KerningClassTable, but for glyph indices.
+ * glyphClasses1 and glyphClasses2 are sorted by glyph indices.
+ */
+struct RawKerningClassTable {
+    std::vector<RawGlyphClass> glyphClasses1;
+    std::vector<RawGlyphClass> glyphClasses2;
+    std::uint16_t numClasses1;
+    std::uint16_t numClasses2;
+    std::vector<int> amounts;
+};
+
+
+/**
+ * Set of glyph indices, where glyphSet[glyphIdx] is true if the
+ * glyph is in the set. Indices beyond the size are not in the set.
+ */
+using GlyphSet = std::vector<bool>;
+
+
+/**
+ * Read kerning pairs from the "kern" table.
+ *
+ * If glyphSet is not null, only pairs of glyphs from the set are
+ * returned.
+ *
+ * \throws streams::StreamError
+ */
 std::vector<RawKerningPair> readKerningPairsKern(
-    streams::Stream& stream,
+    const streams::SpanReader& fontReader,
     const SfntOffsetTable& sfntOffsetTable,
-    const KerningParams& params);
+    const KerningParams& params,
+    const GlyphSet* glyphSet = nullptr);
 
 
+/**
+ * Read kerning pairs from the "GPOS" table.
+ *
+ * If glyphSet is not null, only pairs of glyphs from the set are
+ * returned. Glyphs outside the set are skipped as early as
+ * possible, so that class-based subtables are not expanded for the
+ * whole font.
+ *
+ * If classTables is not null, class-based subtables are not
+ * expanded to pairs, but appended to classTables instead. Classes
+ * and rows/columns that have no kerning are removed. The result
+ * then only contains pairs that are not overridden by the class
+ * tables that go before them in the font, so the amount for a
+ * pair is the same as returned by expandKerningClasses().
+ *
+ * If params.scope has script tags, only "kern" features of the
+ * resolved language systems of these scripts are read. A script
+ * that is not in the font falls back to "DFLT".
+ *
+ * Pair adjustment subtables are read in parallel by up to maxThreads
+ * threads (0 means the number of hardware threads); the result is
+ * the same as if they were read one after another.
+ *
+ * With KerningUnits::font, adjustments from device tables are not
+ * included in the amounts, but appended to deltas for all sizes
+ * (if deltas is not null). A pair can have deltas without a
+ * kerning pair if its amount in font units is 0. Like the amount,
+ * deltas of a pair come only from the first subtable that has a
+ * kerning pair or deltas for it, and are dropped if a preceding
+ * class table has kerning for the pair.
+ *
+ * If hasPairAdjustments is not null, it's set to whether "kern"
+ * features in the scope have any pair adjustment subtables. Unlike
+ * the result, this doesn't depend on glyphSet.
+ *
+ * \throws streams::StreamError
+ */
 std::vector<RawKerningPair> readKerningPairsGpos(
-    streams::Stream& stream,
+    const streams::SpanReader& fontReader,
     const SfntOffsetTable& sfntOffsetTable,
-    const KerningParams& params);
+    const KerningParams& params,
+    const GlyphSet* glyphSet = nullptr,
+    std::vector<RawKerningClassTable>* classTables = nullptr,
+    std::vector<RawKerningDelta>* deltas = nullptr,
+    bool* hasPairAdjustments = nullptr,
+    unsigned maxThreads = 0);
 
 
 }
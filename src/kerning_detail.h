@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "streams/span_reader.h"
+
+
+namespace dpfb {
+
+// Parts of the "GPOS" reader that are not a part of the kerning API,
+// but are exposed for benchmarks.
+namespace detail {
+
+
+struct GlyphRange {
+    std::uint16_t first;
+    std::uint16_t last;
+};
+
+
+// Ranges of the coverage table, in coverage index order.
+using Coverage = std::vector<GlyphRange>;
+
+
+/**
+ * Read an OpenType coverage table.
+ *
+ * Consecutive glyphs of a format 1 table are merged in a single range.
+ *
+ * \throws streams::StreamError
+ */
+Coverage readCoverageTable(streams::SpanReader& reader);
+
+
+struct ClassRange {
+    std::uint16_t first;
+    std::uint16_t last;
+    std::uint16_t glyphClass;
+};
+
+
+// Ranges of the class definition table, sorted by the first glyph.
+using ClassDef = std::vector<ClassRange>;
+
+
+/**
+ * Read an OpenType class definition table.
+ *
+ * Runs of glyphs of the same class in a format 1 table are merged in
+ * a single range.
+ *
+ * \throws streams::StreamError if a class is not less than
+ *     classCount, or on a malformed table.
+ */
+ClassDef readClassDefTable(
+    streams::SpanReader& reader, std::uint16_t classCount);
+
+
+}
+}
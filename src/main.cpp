@@ -1,21 +1,33 @@
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "args.h"
+#include "baking_stats.h"
 #include "cp_range.h"
 #include "font.h"
 #include "font_writer/font_writer.h"
 #include "geometry.h"
+#include "glyph_profile.h"
 #include "image.h"
 #include "image_writer/image_writer.h"
 #include "image_name_formatter.h"
+#include "renderer_comparison.h"
+#include "sfnt.h"
 #include "str.h"
 #include "streams/file_stream.h"
+#include "trace.h"
 #include "unicode.h"
 
 
@@ -91,6 +103,61 @@ static int ptToPx(int pt, int dpi)
 }
 
 
+// Convert 1 to 4 printable ASCII characters to an OpenType tag,
+// padding it with spaces.
+static std::uint32_t parseOpenTypeTag(
+    const char* str, std::size_t len, const char* what)
+{
+    if (len < 1 || len > 4)
+        throw std::runtime_error(str::format(
+            "Invalid %s tag \"%.*s\"", what, static_cast<int>(len), str));
+
+    std::uint32_t tag = 0;
+    for (std::size_t i = 0; i < 4; ++i) {
+        char c = ' ';
+        if (i < len) {
+            c = str[i];
+            if (c < 0x20 || c > 0x7e)
+                throw std::runtime_error(str::format(
+                    "Invalid %s tag \"%.*s\"",
+                    what, static_cast<int>(len), str));
+        }
+
+        tag = (tag << 8) | static_cast<unsigned char>(c);
+    }
+
+    return tag;
+}
+
+
+static KerningScope createKerningScope()
+{
+    KerningScope scope {{}, 0};
+
+    const auto* s = args::kerningScript;
+    while (*s) {
+        const auto* end = std::strchr(s, ',');
+        if (!end)
+            end = s + std::strlen(s);
+
+        scope.scriptTags.push_back(parseOpenTypeTag(s, end - s, "script"));
+
+        s = *end ? end + 1 : end;
+    }
+
+    if (*args::kerningLang) {
+        if (scope.scriptTags.empty())
+            throw std::runtime_error(
+                "-kerning-lang requires -kerning-script");
+
+        scope.langTag = parseOpenTypeTag(
+            args::kerningLang, std::strlen(args::kerningLang), "language");
+    }
+
+    return scope;
+}
+
+
 static FontBakingOptions createFontBakingOptions()
 {
     Hinting hinting;
@@ -102,6 +169,15 @@ static FontBakingOptions createFontBakingOptions()
         throw std::runtime_error(str::format(
             "Invalid hinting \"%s\"", args::hinting));
 
+    BitmapStrikes bitmapStrikes;
+    if (std::strcmp(args::strikes, "prefer") == 0)
+        bitmapStrikes = BitmapStrikes::prefer;
+    else if (std::strcmp(args::strikes, "ignore") == 0)
+        bitmapStrikes = BitmapStrikes::ignore;
+    else
+        throw std::runtime_error(str::format(
+            "Invalid strikes mode \"%s\"", args::strikes));
+
     KerningSource kerningSource;
     if (std::strcmp(args::kerning, "none") == 0)
         kerningSource = KerningSource::none;
@@ -115,12 +191,55 @@ static FontBakingOptions createFontBakingOptions()
         throw std::runtime_error(str::format(
             "Invalid kerning \"%s\"", args::kerning));
 
+    KerningFormat kerningFormat;
+    if (std::strcmp(args::kerningFormat, "pairs") == 0)
+        kerningFormat = KerningFormat::pairs;
+    else if (std::strcmp(args::kerningFormat, "classes") == 0)
+        kerningFormat = KerningFormat::classes;
+    else
+        throw std::runtime_error(str::format(
+            "Invalid kerning format \"%s\"", args::kerningFormat));
+
+    KerningUnits kerningUnits;
+    if (std::strcmp(args::kerningUnits, "px") == 0)
+        kerningUnits = KerningUnits::px;
+    else if (std::strcmp(args::kerningUnits, "font") == 0)
+        kerningUnits = KerningUnits::font;
+    else
+        throw std::runtime_error(str::format(
+            "Invalid kerning units \"%s\"", args::kerningUnits));
+
+    if (args::kerningMaxPairs < 0)
+        throw std::runtime_error("Kerning max pairs should be >= 0");
+    if (args::kerningMinAmount < 0)
+        throw std::runtime_error("Kerning min amount should be >= 0");
+
+    std::shared_ptr<BigramCounts> bigramCounts;
+    if (*args::kerningCorpus) {
+        std::vector<char> text;
+        try {
+            streams::FileStream f(args::kerningCorpus, "rb");
+            text.resize(f.getSize());
+            if (!text.empty())
+                f.readBuffer(&text[0], text.size());
+        } catch (streams::StreamError& e) {
+            throw std::runtime_error(str::format(
+                "Can't read kerning corpus \"%s\": %s",
+                args::kerningCorpus, e.what()));
+        }
+
+        bigramCounts = std::make_shared<BigramCounts>();
+        bigramCounts->addText(text.data(), text.size());
+    }
+
     return {
         args::fontPath,
         args::fontRenderer,
-        args::fontIndex,
+        // Set per font by bake()
+        0,
         ptToPx(args::fontSize, args::fontDpi),
         hinting,
+        bitmapStrikes,
         args::imageMaxSize,
         Edge(
             args::imagePadding[0],
@@ -138,7 +257,17 @@ static FontBakingOptions createFontBakingOptions()
             args::glyphPaddingOuter[2],
             args::glyphPaddingOuter[3]),
         Point(args::glyphSpacing[0], args::glyphSpacing[1]),
-        kerningSource
+        kerningSource,
+        kerningFormat,
+        kerningUnits,
+        {
+            static_cast<std::size_t>(args::kerningMaxPairs),
+            args::kerningMinAmount,
+            bigramCounts
+        },
+        createKerningScope(),
+        // Set per font by bakeFonts()
+        0
     };
 }
 
@@ -246,9 +375,47 @@ static Size getImageSize(
 }
 
 
+static void renderGlyphs(
+    const Font& font, const Page& page, Image& canvas,
+    GlyphProfile* glyphProfile)
+{
+    using Clock = std::chrono::steady_clock;
+
+    for (const auto glyphIdx : page.glyphIndices) {
+        const auto& glyph = font.getGlyphs()[glyphIdx];
+
+        Image glyphImage(
+            canvas.getData()
+                + glyph.pagePos.y * canvas.getPitch() + glyph.pagePos.x,
+            glyph.size.w,
+            glyph.size.h,
+            canvas.getPitch());
+        try {
+            const auto startTime = (
+                glyphProfile ? Clock::now() : Clock::time_point());
+
+            font.renderGlyph(glyph.glyphIdx, glyphImage);
+
+            if (glyphProfile)
+                glyphProfile->addRenderTime(
+                    glyph.cp,
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        Clock::now() - startTime).count());
+        } catch (FontRendererError& e) {
+            throw std::runtime_error(str::format(
+                "%s font renderer can't render glyph for %s: %s",
+                font.getBakingOptions().fontRenderer.c_str(),
+                unicode::cpToStr(glyph.cp),
+                e.what()));
+        }
+    }
+}
+
+
 static void writeImages(
     const Font& font, const ImageNameFormatter& imageNameFormatter,
-    const ImageWriter& imageWriter, const ExportOptions& exportOptions)
+    const ImageWriter& imageWriter, const ExportOptions& exportOptions,
+    BakingStats* stats, GlyphProfile* glyphProfile)
 {
     const auto& pages = font.getPages();
     const auto imageMaxSize = font.getBakingOptions().imageMaxSize;
@@ -259,30 +426,20 @@ static void writeImages(
     Image canvas(canvasSize.w, canvasSize.h);
 
     for (std::size_t pageIdx = 0; pageIdx < pages.size(); ++pageIdx) {
-        std::memset(
-            canvas.getData(),
-            0,
-            static_cast<std::size_t>(canvasSize.w) * canvasSize.h);
-
         const auto& page = pages[pageIdx];
-        for (const auto glyphIdx : page.glyphIndices) {
-            const auto& glyph = font.getGlyphs()[glyphIdx];
-
-            Image glyphImage(
-                canvas.getData()
-                    + glyph.pagePos.y * canvas.getPitch() + glyph.pagePos.x,
-                glyph.size.w,
-                glyph.size.h,
-                canvas.getPitch());
-            try {
-                font.renderGlyph(glyph.glyphIdx, glyphImage);
-            } catch (FontRendererError& e) {
-                throw std::runtime_error(str::format(
-                    "%s font renderer can't render glyph for %s: %s",
-                    font.getBakingOptions().fontRenderer.c_str(),
-                    unicode::cpToStr(glyph.cp),
-                    e.what()));
-            }
+
+        {
+            const BakingStageScope renderScope(stats, BakingStage::render);
+            trace::Span renderSpan("render page", "render");
+            renderSpan.addArg("font", exportOptions.exportName);
+            renderSpan.addArg("page", pageIdx);
+
+            std::memset(
+                canvas.getData(),
+                0,
+                static_cast<std::size_t>(canvasSize.w) * canvasSize.h);
+
+            renderGlyphs(font, page, canvas, glyphProfile);
         }
 
         const auto imagePath = (
@@ -294,6 +451,13 @@ static void writeImages(
             imageSize.w,
             imageSize.h,
             canvas.getPitch());
+
+        // Image writers write to the stream as they encode, so the span
+        // includes writing the file.
+        const BakingStageScope imagesScope(stats, BakingStage::images);
+        trace::Span encodeSpan("encode page", "images");
+        encodeSpan.addArg("font", exportOptions.exportName);
+        encodeSpan.addArg("page", pageIdx);
         try {
             streams::FileStream f(imagePath, "wb");
             imageWriter.write(f, image);
@@ -311,13 +475,18 @@ static void writeImages(
 
 static void writeFont(
     const Font& font, const ImageNameFormatter& imageNameFormatter,
-    const FontWriter& fontWriter, const ExportOptions& exportOptions)
+    const FontWriter& fontWriter, const ExportOptions& exportOptions,
+    BakingStats* stats)
 {
     const auto fontPath = (
         exportOptions.outDir
         + exportOptions.exportName
         + fontWriter.getFileExtension());
 
+    const BakingStageScope stageScope(stats, BakingStage::fontFile);
+    trace::Span span("write font file", "font_file");
+    span.addArg("font", exportOptions.exportName);
+
     try {
         streams::FileStream f(fontPath, "wb");
         fontWriter.write(f, font, imageNameFormatter);
@@ -330,19 +499,277 @@ static void writeFont(
 }
 
 
-static void bake()
+static void printStrikesInfo(
+    const Font& font, const ExportOptions& exportOptions)
 {
-    const auto cpRangeList = createCpRangeList();
-    const auto bakingOptions = createFontBakingOptions();
-    const auto exportOptions = createExportOpions();
+    const auto strikeSizes = font.getStrikeSizes();
+    if (strikeSizes.empty())
+        return;
 
-    // Get writers early for validation
+    std::string sizesStr;
+    for (const auto size : strikeSizes) {
+        if (!sizesStr.empty())
+            sizesStr += ", ";
+        sizesStr += std::to_string(size);
+    }
+
+    const auto numGlyphs = font.getGlyphs().size();
+    const auto numBitmapGlyphs = font.getNumBitmapGlyphs();
+    std::printf(
+        "%s: bitmap strikes: %s px; "
+        "%zu glyphs from strikes, %zu from outlines\n",
+        exportOptions.exportName.c_str(),
+        sizesStr.c_str(),
+        numBitmapGlyphs,
+        numGlyphs - numBitmapGlyphs);
+}
+
+
+static void printKerningBudgetInfo(
+    const Font& font, const ExportOptions& exportOptions)
+{
+    if (!isKerningBudgetSet(font.getBakingOptions().kerningBudget))
+        return;
+
+    std::printf(
+        "%s: kerning budget: kept %zu pairs, dropped %zu\n",
+        exportOptions.exportName.c_str(),
+        font.getKerningPairs().size(),
+        font.getNumDroppedKerningPairs());
+}
+
+
+// Fonts can be baked in parallel, so a report is printed at once to
+// keep its lines together.
+static void printStats(
+    const BakingStats& stats, const ExportOptions& exportOptions)
+{
+    const auto withIo = streams::areStreamStatsEnabled();
+
+    auto report = str::format(
+        "%s: stats for %zu glyphs:\n"
+        "  %-9s %10s %14s",
+        exportOptions.exportName.c_str(),
+        stats.numGlyphs,
+        "stage", "time, ms", "peak RSS, KiB");
+    if (withIo)
+        report += str::format(
+            " %10s %12s %8s %12s %8s %14s",
+            "reads", "bytes read", "seeks", "seek dist",
+            "writes", "bytes written");
+    report += "\n";
+
+    const auto addRow = [&](
+        const char* name, const BakingStageStats& stageStats)
+    {
+        report += str::format(
+            "  %-9s %10.3f %14" PRIu64,
+            name, stageStats.timeNs / 1e6, stageStats.peakRssKib);
+
+        if (withIo) {
+            const auto& io = stageStats.io;
+            report += str::format(
+                " %10" PRIu64 " %12" PRIu64 " %8" PRIu64
+                " %12" PRIu64 " %8" PRIu64 " %14" PRIu64,
+                io.numReads, io.bytesRead,
+                io.numSeeks, io.seekDistance,
+                io.numWrites, io.bytesWritten);
+        }
+
+        report += "\n";
+    };
+
+    for (std::size_t i = 0; i < numBakingStages; ++i)
+        addRow(
+            getBakingStageName(static_cast<BakingStage>(i)),
+            stats.stages[i]);
+    addRow("total", stats.getTotal());
+
+    if (!withIo)
+        report += (
+            "  Stream I/O counters are not available; "
+            "rebuild with DPFB_STREAM_STATS\n");
+
+    std::fputs(report.c_str(), stdout);
+}
+
+
+static std::string formatStageStatsJson(
+    const BakingStageStats& stageStats)
+{
+    const auto& io = stageStats.io;
+    return str::format(
+        "{"
+        "\"timeMs\": %.3f, "
+        "\"peakRssKib\": %" PRIu64 ", "
+        "\"reads\": %" PRIu64 ", "
+        "\"bytesRead\": %" PRIu64 ", "
+        "\"seeks\": %" PRIu64 ", "
+        "\"seekDistance\": %" PRIu64 ", "
+        "\"writes\": %" PRIu64 ", "
+        "\"bytesWritten\": %" PRIu64
+        "}",
+        stageStats.timeNs / 1e6,
+        stageStats.peakRssKib,
+        io.numReads,
+        io.bytesRead,
+        io.numSeeks,
+        io.seekDistance,
+        io.numWrites,
+        io.bytesWritten);
+}
+
+
+static void writeStatsJson(
+    const char* path,
+    const std::vector<std::string>& exportNames,
+    const std::vector<BakingStats>& fontStats)
+{
+    try {
+        streams::FileStream f(path, "wb");
+
+        f.writeStr(str::format(
+            "{\n"
+            "  \"ioStatsEnabled\": %s,\n"
+            "  \"fonts\": [\n",
+            streams::areStreamStatsEnabled() ? "true" : "false"));
+
+        for (std::size_t i = 0; i < fontStats.size(); ++i) {
+            const auto& stats = fontStats[i];
+
+            f.writeStr(str::format(
+                "    {\n"
+                "      \"name\": \"%s\",\n"
+                "      \"glyphs\": %zu,\n"
+                "      \"stages\": {\n",
+                str::escapeJsonStr(exportNames[i]).c_str(),
+                stats.numGlyphs));
+
+            for (std::size_t j = 0; j < numBakingStages; ++j)
+                f.writeStr(str::format(
+                    "        \"%s\": %s%s\n",
+                    getBakingStageName(static_cast<BakingStage>(j)),
+                    formatStageStatsJson(stats.stages[j]).c_str(),
+                    j + 1 != numBakingStages ? "," : ""));
+
+            f.writeStr(str::format(
+                "      },\n"
+                "      \"total\": %s\n"
+                "    }%s\n",
+                formatStageStatsJson(stats.getTotal()).c_str(),
+                i + 1 != fontStats.size() ? "," : ""));
+        }
+
+        f.writeStr(
+            "  ]\n"
+            "}\n");
+    } catch (streams::StreamError& e) {
+        throw std::runtime_error(str::format(
+            "Can't write stats to \"%s\": %s", path, e.what()));
+    }
+}
+
+
+// Like printStats(), prints the report at once.
+static void printGlyphProfile(
+    const GlyphProfile& glyphProfile,
+    int numSlowest,
+    const ExportOptions& exportOptions)
+{
+    const auto medianNs = glyphProfile.getMedianNs();
+    const auto slowest = glyphProfile.getSlowest(numSlowest);
+
+    auto report = str::format(
+        "%s: %zu slowest glyphs of %zu (median %.1f us):\n"
+        "  %-9s %12s %12s %12s %8s\n",
+        exportOptions.exportName.c_str(),
+        slowest.size(),
+        glyphProfile.getTimings().size(),
+        medianNs / 1e3,
+        "glyph", "metrics, us", "render, us", "total, us", "/median");
+
+    for (const auto& timing : slowest) {
+        const auto totalNs = timing.getTotalNs();
+        report += str::format(
+            "  %-9s %12.1f %12.1f %12.1f %8.1f\n",
+            unicode::cpToStr(timing.cp),
+            timing.metricsNs / 1e3,
+            timing.renderNs / 1e3,
+            totalNs / 1e3,
+            medianNs > 0 ? static_cast<double>(totalNs) / medianNs : 0.0);
+    }
+
+    const auto histogram = glyphProfile.getHistogram();
+    std::size_t maxCount = 0;
+    for (const auto count : histogram)
+        maxCount = std::max(maxCount, count);
+
+    report += str::format(
+        "%s: glyph time histogram:\n", exportOptions.exportName.c_str());
+
+    const std::size_t maxBarLen = 40;
+    for (std::size_t i = 0; i < histogram.size(); ++i) {
+        std::string range;
+        if (i == 0)
+            range = "< 1 us";
+        else
+            range = str::format(
+                "%" PRIu64 "-%" PRIu64 " us",
+                std::uint64_t(1) << (i - 1),
+                std::uint64_t(1) << i);
+
+        const auto barLen = (
+            histogram[i] * maxBarLen + maxCount - 1) / maxCount;
+        report += str::format(
+            "  %-16s %8zu%s%s\n",
+            range.c_str(),
+            histogram[i],
+            barLen > 0 ? " " : "",
+            std::string(barLen, '#').c_str());
+    }
+
+    std::fputs(report.c_str(), stdout);
+}
+
+
+static void writeTrace(const char* path)
+{
+    trace::stop();
+
+    try {
+        streams::FileStream f(path, "wb");
+        trace::write(f);
+    } catch (streams::StreamError& e) {
+        throw std::runtime_error(str::format(
+            "Can't write trace to \"%s\": %s", path, e.what()));
+    }
+}
+
+
+// stats is nullptr if stats are disabled. Otherwise, the stats of
+// the font are added to it.
+static void bakeFont(
+    const FontData& fontData,
+    const cp_range::CpRangeList& cpRangeList,
+    const FontBakingOptions& bakingOptions,
+    const ExportOptions& exportOptions,
+    BakingStats* stats)
+{
     const auto& imageWriter = ImageWriter::get(
         exportOptions.imageFormat.c_str());
     const auto& fontWriter = FontWriter::get(
         exportOptions.fontFormat.c_str());
 
-    const Font font(bakingOptions, cpRangeList);
+    trace::Span span("bake font", "font");
+    span.addArg("font", exportOptions.exportName);
+
+    GlyphProfile glyphProfile;
+    auto* glyphProfilePtr = args::profileGlyphs > 0 ? &glyphProfile : nullptr;
+
+    const Font font(
+        bakingOptions, cpRangeList, fontData, stats, glyphProfilePtr);
+    if (stats)
+        stats->numGlyphs = font.getGlyphs().size();
 
     const auto imageCount = font.getPages().size();
     if (imageCount > static_cast<std::size_t>(exportOptions.imageMaxCount))
@@ -356,11 +783,355 @@ static void bake()
         imageCount,
         imageWriter.getFileExtension());
 
-    writeFont(font, imageNameFormatter, fontWriter, exportOptions);
-    writeImages(font, imageNameFormatter, imageWriter, exportOptions);
+    writeFont(font, imageNameFormatter, fontWriter, exportOptions, stats);
+    writeImages(
+        font,
+        imageNameFormatter,
+        imageWriter,
+        exportOptions,
+        stats,
+        glyphProfilePtr);
+
+    printStrikesInfo(font, exportOptions);
+    printKerningBudgetInfo(font, exportOptions);
+    if (stats && args::stats)
+        printStats(*stats, exportOptions);
+    if (glyphProfilePtr)
+        printGlyphProfile(glyphProfile, args::profileGlyphs, exportOptions);
+}
+
+
+static std::vector<int> parseFontIndices(
+    const char* str, std::uint32_t numFonts)
+{
+    std::vector<int> result;
+
+    if (std::strcmp(str, "all") == 0) {
+        for (std::uint32_t i = 0; i < numFonts; ++i)
+            result.push_back(i);
+        return result;
+    }
+
+    const auto* s = str;
+    while (true) {
+        char* end;
+        const auto first = std::strtol(s, &end, 10);
+        if (end == s || first < 0)
+            throw std::runtime_error(str::format(
+                "Invalid font index list \"%s\"", str));
+        s = end;
+
+        auto last = first;
+        if (*s == '-') {
+            ++s;
+            last = std::strtol(s, &end, 10);
+            if (end == s || last < first)
+                throw std::runtime_error(str::format(
+                    "Invalid font index list \"%s\"", str));
+            s = end;
+        }
+
+        if (static_cast<std::uint32_t>(last) >= numFonts)
+            throw std::runtime_error(str::format(
+                "Font index %li is out of range; the file contains "
+                "%" PRIu32 " font%s",
+                last, numFonts, numFonts > 1 ? "s" : ""));
+
+        for (auto i = first; i <= last; ++i)
+            if (std::find(result.begin(), result.end(), i) == result.end())
+                result.push_back(i);
+
+        if (!*s)
+            break;
+        if (*s != ',')
+            throw std::runtime_error(str::format(
+                "Invalid font index list \"%s\"", str));
+        ++s;
+    }
+
+    return result;
+}
+
+
+static std::string getCollectionFontExportName(
+    const std::string& exportName, int fontIndex)
+{
+    return exportName + "_" + std::to_string(fontIndex);
+}
+
+
+// Bake fonts of a collection in parallel. Each font gets its own
+// Font and FontRenderer instances; only the file data is shared.
+static void bakeFonts(
+    const FontData& fontData,
+    const cp_range::CpRangeList& cpRangeList,
+    const FontBakingOptions& bakingOptions,
+    const ExportOptions& exportOptions,
+    const std::vector<int>& fontIndices,
+    std::vector<BakingStats>* fontStats)
+{
+    std::vector<std::exception_ptr> errors(fontIndices.size());
+    std::atomic<std::size_t> nextIdx {0};
+
+    const auto numHardwareThreads = std::max(
+        1u, std::thread::hardware_concurrency());
+    const auto numThreads = std::min<std::size_t>(
+        numHardwareThreads, fontIndices.size());
+    // Share hardware threads between the fonts rather than let each
+    // of them start its own set.
+    const unsigned maxFontThreads = std::max<std::size_t>(
+        1, numHardwareThreads / numThreads);
+
+    const auto worker = [&]()
+    {
+        while (true) {
+            const auto i = nextIdx++;
+            if (i >= fontIndices.size())
+                break;
+
+            auto fontBakingOptions = bakingOptions;
+            fontBakingOptions.fontIndex = fontIndices[i];
+            fontBakingOptions.maxThreads = maxFontThreads;
+
+            auto fontExportOptions = exportOptions;
+            fontExportOptions.exportName = getCollectionFontExportName(
+                exportOptions.exportName, fontIndices[i]);
+
+            try {
+                bakeFont(
+                    fontData,
+                    cpRangeList,
+                    fontBakingOptions,
+                    fontExportOptions,
+                    fontStats ? &(*fontStats)[i] : nullptr);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < numThreads; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+
+    std::string errorsStr;
+    for (std::size_t i = 0; i < errors.size(); ++i) {
+        if (!errors[i])
+            continue;
+
+        if (!errorsStr.empty())
+            errorsStr += "; ";
+
+        try {
+            std::rethrow_exception(errors[i]);
+        } catch (std::exception& e) {
+            errorsStr += str::format(
+                "font %i: %s", fontIndices[i], e.what());
+        }
+    }
+
+    if (!errorsStr.empty())
+        throw std::runtime_error(errorsStr);
 }
 
 
+static void bake()
+{
+    const auto cpRangeList = createCpRangeList();
+    const auto bakingOptions = createFontBakingOptions();
+    const auto exportOptions = createExportOpions();
+
+    // Get writers early for validation
+    ImageWriter::get(exportOptions.imageFormat.c_str());
+    FontWriter::get(exportOptions.fontFormat.c_str());
+
+    if (*args::trace)
+        trace::start();
+
+    const auto withStats = args::stats || *args::statsJson;
+
+    // Stats of the work shared by all fonts of the file; they are
+    // included in the stats of each font.
+    BakingStats sharedStats {};
+    auto* sharedStatsPtr = withStats ? &sharedStats : nullptr;
+
+    FontData fontData;
+    {
+        const BakingStageScope stageScope(
+            sharedStatsPtr, BakingStage::load);
+        const trace::Span span("load font file", "load");
+        fontData = loadFontData(bakingOptions.fontPath);
+    }
+
+    std::uint32_t numFonts;
+    {
+        const BakingStageScope stageScope(
+            sharedStatsPtr, BakingStage::sfnt);
+        numFonts = getNumSfntFonts({&(*fontData)[0], fontData->size()});
+    }
+
+    const auto fontIndices = parseFontIndices(args::fontIndex, numFonts);
+
+    std::vector<BakingStats> fontStats;
+    if (withStats)
+        fontStats.assign(fontIndices.size(), sharedStats);
+
+    std::vector<std::string> exportNames;
+    if (fontIndices.size() == 1) {
+        auto fontBakingOptions = bakingOptions;
+        fontBakingOptions.fontIndex = fontIndices[0];
+        bakeFont(
+            fontData,
+            cpRangeList,
+            fontBakingOptions,
+            exportOptions,
+            withStats ? &fontStats[0] : nullptr);
+
+        exportNames.push_back(exportOptions.exportName);
+    } else {
+        bakeFonts(
+            fontData,
+            cpRangeList,
+            bakingOptions,
+            exportOptions,
+            fontIndices,
+            withStats ? &fontStats : nullptr);
+
+        for (const auto fontIndex : fontIndices)
+            exportNames.push_back(getCollectionFontExportName(
+                exportOptions.exportName, fontIndex));
+    }
+
+    if (*args::statsJson)
+        writeStatsJson(args::statsJson, exportNames, fontStats);
+
+    if (*args::trace)
+        writeTrace(args::trace);
+}
+
+
+static void printRendererComparison(
+    const RendererComparison& comparison, const std::string& exportName)
+{
+    std::printf(
+        "%s: font renderers:\n"
+        "  %-12s %8s %8s %12s %10s %12s\n",
+        exportName.c_str(),
+        "renderer", "glyphs", "init, ms", "metrics, ms", "raster, ms",
+        "glyphs/s");
+
+    for (const auto& timing : comparison.timings)
+        std::printf(
+            "  %-12s %8zu %8.2f %12.2f %10.2f %12.0f\n",
+            timing.rendererName,
+            timing.numGlyphs,
+            timing.initNs / 1e6,
+            timing.metricsNs / 1e6,
+            timing.renderNs / 1e6,
+            timing.getGlyphsPerSec());
+
+    const auto* referenceName = comparison.timings[0].rendererName;
+    const std::size_t maxMismatches = 10;
+
+    for (const auto& diff : comparison.diffs) {
+        std::printf(
+            "%s: %s vs %s: %zu code point mismatches, "
+            "%zu metric mismatches, %zu different glyphs, "
+            "max error %i, mean error %.3f\n",
+            exportName.c_str(),
+            diff.rendererName,
+            referenceName,
+            diff.numCpMismatches,
+            diff.metricsMismatches.size(),
+            diff.numDifferentGlyphs,
+            diff.maxError,
+            diff.meanError);
+
+        const auto numMismatches = std::min(
+            diff.metricsMismatches.size(), maxMismatches);
+        for (std::size_t i = 0; i < numMismatches; ++i) {
+            const auto& mismatch = diff.metricsMismatches[i];
+            const auto& a = mismatch.reference;
+            const auto& b = mismatch.other;
+            std::printf(
+                "  %-9s size %ix%i / %ix%i, offset %i:%i / %i:%i, "
+                "advance %i / %i\n",
+                unicode::cpToStr(mismatch.cp),
+                a.size.w, a.size.h, b.size.w, b.size.h,
+                a.offset.x, a.offset.y, b.offset.x, b.offset.y,
+                a.advance, b.advance);
+        }
+
+        if (diff.metricsMismatches.size() > numMismatches)
+            std::printf(
+                "  and %zu more\n",
+                diff.metricsMismatches.size() - numMismatches);
+    }
+}
+
+
+// The renderer of -font-renderer is the reference one; other
+// renderers follow in the order of registration.
+static std::vector<const FontRendererCreator*> getComparedRenderers(
+    const char* referenceName)
+{
+    const auto* reference = FontRendererCreator::find(referenceName);
+    if (!reference)
+        throw std::runtime_error(str::format(
+            "No such font renderer: \"%s\"", referenceName));
+
+    std::vector<const FontRendererCreator*> result {reference};
+    for (const auto* creator = FontRendererCreator::getFirst();
+            creator;
+            creator = creator->getNext())
+        if (creator != reference)
+            result.push_back(creator);
+
+    return result;
+}
+
+
+static void compareFontRenderers()
+{
+    const auto cpRangeList = createCpRangeList();
+    const auto bakingOptions = createFontBakingOptions();
+    const auto exportOptions = createExportOpions();
+
+    if (bakingOptions.fontPxSize <= 0)
+        throw std::runtime_error("Font size should be > 0");
+
+    const auto creators = getComparedRenderers(
+        bakingOptions.fontRenderer.c_str());
+
+    const auto fontData = loadFontData(bakingOptions.fontPath);
+    const auto numFonts = getNumSfntFonts(
+        {&(*fontData)[0], fontData->size()});
+    const auto fontIndices = parseFontIndices(args::fontIndex, numFonts);
+
+    for (const auto fontIndex : fontIndices) {
+        const FontRendererArgs rendererArgs {
+            &(*fontData)[0],
+            fontData->size(),
+            fontIndex,
+            bakingOptions.fontPxSize,
+            bakingOptions.hinting,
+            bakingOptions.bitmapStrikes
+        };
+
+        const auto comparison = compareRenderers(
+            rendererArgs, cpRangeList, creators);
+        printRendererComparison(
+            comparison,
+            fontIndices.size() == 1
+                ? exportOptions.exportName
+                : getCollectionFontExportName(
+                    exportOptions.exportName, fontIndex));
+    }
+}
+
 }
 
 
@@ -369,7 +1140,10 @@ int main(int argc, char* argv[])
     dpfb::args::parse(argc, argv);
 
     try {
-        dpfb::bake();
+        if (dpfb::args::compareRenderers)
+            dpfb::compareFontRenderers();
+        else
+            dpfb::bake();
     } catch (std::runtime_error& e) {
         std::fprintf(
             stderr, "Can't bake %s: %s\n", dpfb::args::fontPath, e.what());
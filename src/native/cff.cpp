@@ -0,0 +1,788 @@
+
+#include "native/cff.h"
+
+#include <cinttypes>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+#include "str.h"
+
+
+// Specifications:
+//   The Compact Font Format Specification (Adobe Technical Note #5176)
+//   The Type 2 Charstring Format (Adobe Technical Note #5177)
+
+
+namespace dpfb {
+namespace native {
+
+
+using namespace streams;
+
+
+static void getIndexObject(
+    Stream& stream,
+    const CffIndex& index,
+    std::uint32_t objectIdx,
+    std::uint32_t& start,
+    std::uint32_t& end);
+
+
+static CffIndex readIndex(Stream& stream)
+{
+    CffIndex index;
+    index.count = stream.readU16Be();
+    if (index.count == 0) {
+        index.offSize = 0;
+        index.offsetsPos = index.dataPos = stream.getPosition();
+        return index;
+    }
+
+    index.offSize = stream.readU8();
+    if (index.offSize < 1 || index.offSize > 4)
+        throw StreamError(str::format(
+            "Invalid CFF INDEX offSize %" PRIu8, index.offSize));
+
+    index.offsetsPos = stream.getPosition();
+    index.dataPos = (
+        index.offsetsPos + (index.count + 1) * index.offSize - 1);
+
+    // Move past the end of the INDEX.
+    std::uint32_t start;
+    std::uint32_t end;
+    getIndexObject(stream, index, index.count - 1, start, end);
+    stream.seek(end, SeekOrigin::set);
+
+    return index;
+}
+
+
+static std::uint32_t readOffset(Stream& stream, std::uint8_t offSize)
+{
+    std::uint32_t result = 0;
+    while (offSize--)
+        result = (result << 8) | stream.readU8();
+    return result;
+}
+
+
+static void getIndexObject(
+    Stream& stream,
+    const CffIndex& index,
+    std::uint32_t objectIdx,
+    std::uint32_t& start,
+    std::uint32_t& end)
+{
+    if (objectIdx >= index.count)
+        throw StreamError(str::format(
+            "CFF INDEX object index %" PRIu32 " >= count (%" PRIu16 ")",
+            objectIdx, index.count));
+
+    stream.seek(
+        index.offsetsPos + objectIdx * index.offSize, SeekOrigin::set);
+    const auto startOffset = readOffset(stream, index.offSize);
+    const auto endOffset = readOffset(stream, index.offSize);
+    if (startOffset == 0 || startOffset > endOffset)
+        throw StreamError("Invalid CFF INDEX offsets");
+
+    start = index.dataPos + startOffset;
+    end = index.dataPos + endOffset;
+}
+
+
+enum DictOp {
+    dictOpCharStrings = 17,
+    dictOpPrivate = 18,
+    dictOpSubrs = 19,
+    dictOpCharstringType = 1206,
+    dictOpRos = 1230,
+    dictOpFdArray = 1236,
+    dictOpFdSelect = 1237,
+};
+
+
+const int maxDictOperands = 48;
+
+
+static double readDictReal(Stream& stream)
+{
+    static const char* const nibbleStrs[] = {
+        "0", "1", "2", "3", "4", "5", "6", "7", "8", "9",
+        ".", "E", "E-", "", "-", ""
+    };
+
+    std::string str;
+    while (true) {
+        const auto b = stream.readU8();
+        const auto n1 = b >> 4;
+        const auto n2 = b & 0xf;
+
+        if (n1 == 0xf)
+            break;
+        str += nibbleStrs[n1];
+
+        if (n2 == 0xf)
+            break;
+        str += nibbleStrs[n2];
+    }
+
+    return std::strtod(str.c_str(), nullptr);
+}
+
+
+/**
+ * Parse DICT data, calling handler(op, operands, numOperands) for
+ * every operator. Two-byte operators are passed as 1200 + the
+ * second byte.
+ */
+template<typename T>
+static void parseDict(
+    Stream& stream, std::uint32_t start, std::uint32_t size, T handler)
+{
+    double operands[maxDictOperands];
+    int numOperands = 0;
+
+    stream.seek(start, SeekOrigin::set);
+    const auto end = start + size;
+    while (stream.getPosition() < end) {
+        const auto b0 = stream.readU8();
+        if (b0 <= 21) {
+            int op = b0;
+            if (b0 == 12)
+                op = 1200 + stream.readU8();
+
+            const auto pos = stream.getPosition();
+            handler(op, operands, numOperands);
+            stream.seek(pos, SeekOrigin::set);
+
+            numOperands = 0;
+            continue;
+        }
+
+        double operand;
+        if (b0 == 28)
+            operand = stream.readS16Be();
+        else if (b0 == 29)
+            operand = stream.readS32Be();
+        else if (b0 == 30)
+            operand = readDictReal(stream);
+        else if (b0 >= 32 && b0 <= 246)
+            operand = b0 - 139;
+        else if (b0 >= 247 && b0 <= 250)
+            operand = (b0 - 247) * 256 + stream.readU8() + 108;
+        else if (b0 >= 251 && b0 <= 254)
+            operand = -(b0 - 251) * 256 - stream.readU8() - 108;
+        else
+            throw StreamError(str::format(
+                "Invalid CFF DICT operand %" PRIu8, b0));
+
+        if (numOperands == maxDictOperands)
+            throw StreamError("Too many CFF DICT operands");
+        operands[numOperands++] = operand;
+    }
+}
+
+
+CffOutlineReader::CffOutlineReader(
+        Stream& stream,
+        const SfntOffsetTable& sfntOffsetTable)
+    : charStrings {}
+    , globalSubrs {}
+    , localSubrs {}
+    , fdSelect {}
+{
+    const auto cffOffset = sfntOffsetTable.getTableOffset(
+        sfntTag('C', 'F', 'F', ' '));
+    if (cffOffset == 0)
+        throw StreamError("Font has no \"CFF \" table");
+
+    stream.seek(cffOffset, SeekOrigin::set);
+    const auto major = stream.readU8();
+    if (major != 1)
+        throw StreamError(str::format(
+            "Unsupported CFF major version %" PRIu8, major));
+    // Skip minor
+    stream.seek(sizeof(std::uint8_t), SeekOrigin::cur);
+    const auto hdrSize = stream.readU8();
+
+    stream.seek(cffOffset + hdrSize, SeekOrigin::set);
+    // Name INDEX
+    readIndex(stream);
+    const auto topDicts = readIndex(stream);
+    // String INDEX
+    readIndex(stream);
+    globalSubrs = readIndex(stream);
+
+    std::uint32_t topDictStart;
+    std::uint32_t topDictEnd;
+    // We only support one font per CFF table, as required by
+    // OpenType.
+    getIndexObject(stream, topDicts, 0, topDictStart, topDictEnd);
+
+    std::uint32_t charStringsOffset = 0;
+    std::uint32_t privateDictSize = 0;
+    std::uint32_t privateDictOffset = 0;
+    bool isCid = false;
+    std::uint32_t fdArrayOffset = 0;
+    std::uint32_t fdSelectOffset = 0;
+    int charstringType = 2;
+
+    parseDict(
+        stream, topDictStart, topDictEnd - topDictStart,
+        [&](int op, const double* operands, int numOperands)
+        {
+            switch (op) {
+                case dictOpCharStrings:
+                    if (numOperands >= 1)
+                        charStringsOffset = operands[0];
+                    break;
+                case dictOpPrivate:
+                    if (numOperands >= 2) {
+                        privateDictSize = operands[0];
+                        privateDictOffset = operands[1];
+                    }
+                    break;
+                case dictOpCharstringType:
+                    if (numOperands >= 1)
+                        charstringType = operands[0];
+                    break;
+                case dictOpRos:
+                    isCid = true;
+                    break;
+                case dictOpFdArray:
+                    if (numOperands >= 1)
+                        fdArrayOffset = operands[0];
+                    break;
+                case dictOpFdSelect:
+                    if (numOperands >= 1)
+                        fdSelectOffset = operands[0];
+                    break;
+            }
+        });
+
+    if (charstringType != 2)
+        throw StreamError(str::format(
+            "Unsupported CFF charstring type %i", charstringType));
+
+    if (charStringsOffset == 0)
+        throw StreamError("CFF font has no CharStrings");
+
+    stream.seek(cffOffset + charStringsOffset, SeekOrigin::set);
+    charStrings = readIndex(stream);
+
+    if (!isCid) {
+        localSubrs.push_back(
+            readPrivateDictSubrs(
+                stream, cffOffset, privateDictSize, privateDictOffset));
+        return;
+    }
+
+    if (fdArrayOffset == 0 || fdSelectOffset == 0)
+        throw StreamError("CID-keyed CFF font has no FDArray or FDSelect");
+
+    stream.seek(cffOffset + fdArrayOffset, SeekOrigin::set);
+    const auto fdArray = readIndex(stream);
+    localSubrs.reserve(fdArray.count);
+    for (std::uint16_t i = 0; i < fdArray.count; ++i) {
+        std::uint32_t fontDictStart;
+        std::uint32_t fontDictEnd;
+        getIndexObject(stream, fdArray, i, fontDictStart, fontDictEnd);
+
+        std::uint32_t fdPrivateDictSize = 0;
+        std::uint32_t fdPrivateDictOffset = 0;
+        parseDict(
+            stream, fontDictStart, fontDictEnd - fontDictStart,
+            [&](int op, const double* operands, int numOperands)
+            {
+                if (op == dictOpPrivate && numOperands >= 2) {
+                    fdPrivateDictSize = operands[0];
+                    fdPrivateDictOffset = operands[1];
+                }
+            });
+
+        localSubrs.push_back(
+            readPrivateDictSubrs(
+                stream, cffOffset, fdPrivateDictSize, fdPrivateDictOffset));
+    }
+
+    readFdSelect(stream, cffOffset + fdSelectOffset);
+}
+
+
+CffIndex CffOutlineReader::readPrivateDictSubrs(
+    Stream& stream,
+    std::uint32_t cffOffset,
+    std::uint32_t privateDictSize,
+    std::uint32_t privateDictOffset)
+{
+    std::uint32_t subrsOffset = 0;
+    if (privateDictSize > 0)
+        parseDict(
+            stream, cffOffset + privateDictOffset, privateDictSize,
+            [&](int op, const double* operands, int numOperands)
+            {
+                if (op == dictOpSubrs && numOperands >= 1)
+                    subrsOffset = operands[0];
+            });
+
+    if (subrsOffset == 0)
+        return {0, 0, 0, 0};
+
+    // Subrs offset is relative to the beginning of the Private DICT.
+    stream.seek(
+        cffOffset + privateDictOffset + subrsOffset, SeekOrigin::set);
+    return readIndex(stream);
+}
+
+
+void CffOutlineReader::readFdSelect(
+    Stream& stream, std::uint32_t fdSelectPos)
+{
+    const auto numGlyphs = charStrings.count;
+    fdSelect.resize(numGlyphs);
+
+    stream.seek(fdSelectPos, SeekOrigin::set);
+    const auto format = stream.readU8();
+    if (format == 0)
+        stream.readBuffer(fdSelect.data(), numGlyphs);
+    else if (format == 3) {
+        auto numRanges = stream.readU16Be();
+        if (numRanges == 0)
+            throw StreamError("CFF FDSelect format 3 has no ranges");
+
+        auto first = stream.readU16Be();
+        while (numRanges--) {
+            const auto fd = stream.readU8();
+            const auto next = stream.readU16Be();
+            if (first > next || next > numGlyphs)
+                throw StreamError("Invalid CFF FDSelect range");
+
+            for (auto i = first; i < next; ++i)
+                fdSelect[i] = fd;
+
+            first = next;
+        }
+    } else
+        throw StreamError(str::format(
+            "Unknown CFF FDSelect format %" PRIu8, format));
+
+    for (const auto fd : fdSelect)
+        if (fd >= localSubrs.size())
+            throw StreamError("CFF FDSelect refers to a missing Font DICT");
+}
+
+
+const int maxCharstringStack = 48;
+const int maxSubrNesting = 10;
+
+
+struct CharstringState {
+    Outline* outline;
+    const CffIndex* globalSubrs;
+    const CffIndex* localSubrs;
+    float x;
+    float y;
+    bool isContourOpen;
+    int numStems;
+    int sp;
+    float stack[maxCharstringStack];
+};
+
+
+static void moveTo(CharstringState& state, float dx, float dy)
+{
+    state.x += dx;
+    state.y += dy;
+    state.outline->moveTo(state.x, state.y);
+    state.isContourOpen = true;
+}
+
+
+static void ensureContourOpen(CharstringState& state)
+{
+    if (state.isContourOpen)
+        return;
+
+    state.outline->moveTo(state.x, state.y);
+    state.isContourOpen = true;
+}
+
+
+static void lineTo(CharstringState& state, float dx, float dy)
+{
+    ensureContourOpen(state);
+
+    state.x += dx;
+    state.y += dy;
+    state.outline->lineTo(state.x, state.y);
+}
+
+
+static void curveTo(
+    CharstringState& state,
+    float dx1, float dy1, float dx2, float dy2, float dx3, float dy3)
+{
+    ensureContourOpen(state);
+
+    const auto x1 = state.x + dx1;
+    const auto y1 = state.y + dy1;
+    const auto x2 = x1 + dx2;
+    const auto y2 = y1 + dy2;
+    state.x = x2 + dx3;
+    state.y = y2 + dy3;
+    state.outline->cubicTo(x1, y1, x2, y2, state.x, state.y);
+}
+
+
+static int getSubrBias(const CffIndex& subrs)
+{
+    if (subrs.count < 1240)
+        return 107;
+    else if (subrs.count < 33900)
+        return 1131;
+    else
+        return 32768;
+}
+
+
+static void checkNumArgs(
+    const CharstringState& state, int numArgs, const char* opName)
+{
+    if (state.sp < numArgs)
+        throw StreamError(str::format(
+            "Charstring operator %s expects %i arguments, got %i",
+            opName, numArgs, state.sp));
+}
+
+
+enum CharstringOp {
+    csHstem = 1,
+    csVstem = 3,
+    csVmoveto = 4,
+    csRlineto = 5,
+    csHlineto = 6,
+    csVlineto = 7,
+    csRrcurveto = 8,
+    csCallsubr = 10,
+    csReturn = 11,
+    csEscape = 12,
+    csEndchar = 14,
+    csHstemhm = 18,
+    csHintmask = 19,
+    csCntrmask = 20,
+    csRmoveto = 21,
+    csHmoveto = 22,
+    csVstemhm = 23,
+    csRcurveline = 24,
+    csRlinecurve = 25,
+    csVvcurveto = 26,
+    csHhcurveto = 27,
+    csShortint = 28,
+    csCallgsubr = 29,
+    csVhcurveto = 30,
+    csHvcurveto = 31,
+};
+
+
+enum CharstringEscapeOp {
+    csDotsection = 0,
+    csHflex = 34,
+    csFlex = 35,
+    csHflex1 = 36,
+    csFlex1 = 37,
+};
+
+
+static void executeEscape(CharstringState& state, std::uint8_t op)
+{
+    const auto* s = state.stack;
+
+    switch (op) {
+        case csDotsection:
+            break;
+        case csHflex:
+            checkNumArgs(state, 7, "hflex");
+            curveTo(state, s[0], 0, s[1], s[2], s[3], 0);
+            curveTo(state, s[4], 0, s[5], -s[2], s[6], 0);
+            break;
+        case csFlex:
+            checkNumArgs(state, 13, "flex");
+            curveTo(state, s[0], s[1], s[2], s[3], s[4], s[5]);
+            curveTo(state, s[6], s[7], s[8], s[9], s[10], s[11]);
+            break;
+        case csHflex1:
+            checkNumArgs(state, 9, "hflex1");
+            curveTo(state, s[0], s[1], s[2], s[3], s[4], 0);
+            curveTo(state, s[5], 0, s[6], s[7], s[8], -(s[1] + s[3] + s[7]));
+            break;
+        case csFlex1: {
+            checkNumArgs(state, 11, "flex1");
+
+            const auto dx = s[0] + s[2] + s[4] + s[6] + s[8];
+            const auto dy = s[1] + s[3] + s[5] + s[7] + s[9];
+
+            float dx6;
+            float dy6;
+            if (std::abs(dx) > std::abs(dy)) {
+                dx6 = s[10];
+                dy6 = -dy;
+            } else {
+                dx6 = -dx;
+                dy6 = s[10];
+            }
+
+            curveTo(state, s[0], s[1], s[2], s[3], s[4], s[5]);
+            curveTo(state, s[6], s[7], s[8], s[9], dx6, dy6);
+            break;
+        }
+        default:
+            throw StreamError(str::format(
+                "Unsupported charstring operator 12 %" PRIu8, op));
+    }
+
+    state.sp = 0;
+}
+
+
+/**
+ * Execute a charstring or a subroutine.
+ *
+ * \returns true if endchar was reached
+ */
+static bool execute(
+    Stream& stream,
+    CharstringState& state,
+    std::uint32_t pos,
+    std::uint32_t end,
+    int depth)
+{
+    auto* s = state.stack;
+    auto& sp = state.sp;
+
+    stream.seek(pos, SeekOrigin::set);
+    while (pos < end) {
+        const auto b0 = stream.readU8();
+        ++pos;
+
+        if (b0 >= 32 || b0 == csShortint) {
+            float value;
+            if (b0 == csShortint) {
+                value = stream.readS16Be();
+                pos += 2;
+            } else if (b0 <= 246)
+                value = b0 - 139;
+            else if (b0 <= 250) {
+                value = (b0 - 247) * 256 + stream.readU8() + 108;
+                ++pos;
+            } else if (b0 <= 254) {
+                value = -(b0 - 251) * 256 - stream.readU8() - 108;
+                ++pos;
+            } else {
+                value = stream.readS32Be() / 65536.0f;
+                pos += 4;
+            }
+
+            if (sp == maxCharstringStack)
+                throw StreamError("Charstring stack overflow");
+            s[sp++] = value;
+            continue;
+        }
+
+        switch (b0) {
+            case csHstem:
+            case csVstem:
+            case csHstemhm:
+            case csVstemhm:
+                state.numStems += sp / 2;
+                break;
+            case csHintmask:
+            case csCntrmask: {
+                // Arguments before hintmask are an implicit vstem.
+                state.numStems += sp / 2;
+
+                const auto maskSize = (state.numStems + 7) / 8;
+                stream.seek(maskSize, SeekOrigin::cur);
+                pos += maskSize;
+                break;
+            }
+            case csRmoveto:
+                checkNumArgs(state, 2, "rmoveto");
+                moveTo(state, s[sp - 2], s[sp - 1]);
+                break;
+            case csHmoveto:
+                checkNumArgs(state, 1, "hmoveto");
+                moveTo(state, s[sp - 1], 0);
+                break;
+            case csVmoveto:
+                checkNumArgs(state, 1, "vmoveto");
+                moveTo(state, 0, s[sp - 1]);
+                break;
+            case csRlineto:
+                for (int i = 0; i + 1 < sp; i += 2)
+                    lineTo(state, s[i], s[i + 1]);
+                break;
+            case csHlineto:
+            case csVlineto: {
+                auto horizontal = b0 == csHlineto;
+                for (int i = 0; i < sp; ++i) {
+                    if (horizontal)
+                        lineTo(state, s[i], 0);
+                    else
+                        lineTo(state, 0, s[i]);
+                    horizontal = !horizontal;
+                }
+                break;
+            }
+            case csRrcurveto:
+                for (int i = 0; i + 5 < sp; i += 6)
+                    curveTo(
+                        state,
+                        s[i], s[i + 1], s[i + 2],
+                        s[i + 3], s[i + 4], s[i + 5]);
+                break;
+            case csRcurveline: {
+                checkNumArgs(state, 8, "rcurveline");
+                int i = 0;
+                for (; sp - i >= 8; i += 6)
+                    curveTo(
+                        state,
+                        s[i], s[i + 1], s[i + 2],
+                        s[i + 3], s[i + 4], s[i + 5]);
+                lineTo(state, s[i], s[i + 1]);
+                break;
+            }
+            case csRlinecurve: {
+                checkNumArgs(state, 8, "rlinecurve");
+                int i = 0;
+                for (; sp - i >= 8; i += 2)
+                    lineTo(state, s[i], s[i + 1]);
+                curveTo(
+                    state,
+                    s[i], s[i + 1], s[i + 2],
+                    s[i + 3], s[i + 4], s[i + 5]);
+                break;
+            }
+            case csVvcurveto: {
+                int i = 0;
+                float dx1 = 0;
+                if (sp % 2 == 1) {
+                    dx1 = s[0];
+                    i = 1;
+                }
+
+                for (; i + 3 < sp; i += 4) {
+                    curveTo(
+                        state, dx1, s[i], s[i + 1], s[i + 2], 0, s[i + 3]);
+                    dx1 = 0;
+                }
+                break;
+            }
+            case csHhcurveto: {
+                int i = 0;
+                float dy1 = 0;
+                if (sp % 2 == 1) {
+                    dy1 = s[0];
+                    i = 1;
+                }
+
+                for (; i + 3 < sp; i += 4) {
+                    curveTo(
+                        state, s[i], dy1, s[i + 1], s[i + 2], s[i + 3], 0);
+                    dy1 = 0;
+                }
+                break;
+            }
+            case csVhcurveto:
+            case csHvcurveto: {
+                auto horizontal = b0 == csHvcurveto;
+                for (int i = 0; i + 3 < sp; i += 4) {
+                    // The last curve can have an extra argument.
+                    const auto last = sp - i == 5 ? s[i + 4] : 0;
+                    if (horizontal)
+                        curveTo(
+                            state,
+                            s[i], 0, s[i + 1], s[i + 2], last, s[i + 3]);
+                    else
+                        curveTo(
+                            state,
+                            0, s[i], s[i + 1], s[i + 2], s[i + 3], last);
+                    horizontal = !horizontal;
+                }
+                break;
+            }
+            case csCallsubr:
+            case csCallgsubr: {
+                checkNumArgs(state, 1, "callsubr");
+                if (depth == maxSubrNesting)
+                    throw StreamError(
+                        "Charstring subroutine nesting is too deep");
+
+                const auto& subrs = (
+                    b0 == csCallsubr
+                        ? *state.localSubrs : *state.globalSubrs);
+                const auto subrIdx = (
+                    static_cast<int>(s[--sp]) + getSubrBias(subrs));
+                if (subrIdx < 0)
+                    throw StreamError("Invalid subroutine index");
+
+                std::uint32_t subrStart;
+                std::uint32_t subrEnd;
+                getIndexObject(stream, subrs, subrIdx, subrStart, subrEnd);
+                if (execute(stream, state, subrStart, subrEnd, depth + 1))
+                    return true;
+
+                stream.seek(pos, SeekOrigin::set);
+                // Arguments are left for the next operator.
+                continue;
+            }
+            case csReturn:
+                return false;
+            case csEndchar:
+                // 4 arguments (excluding width) are for deprecated
+                // seac-like accent composition, which we ignore.
+                return true;
+            case csEscape: {
+                const auto op = stream.readU8();
+                ++pos;
+                executeEscape(state, op);
+                break;
+            }
+            default:
+                throw StreamError(str::format(
+                    "Unsupported charstring operator %" PRIu8, b0));
+        }
+
+        sp = 0;
+    }
+
+    return false;
+}
+
+
+void CffOutlineReader::read(
+    Stream& stream, GlyphIndex glyphIdx, Outline& outline)
+{
+    outline.clear();
+
+    std::uint32_t start;
+    std::uint32_t end;
+    getIndexObject(stream, charStrings, glyphIdx, start, end);
+
+    CharstringState state;
+    state.outline = &outline;
+    state.globalSubrs = &globalSubrs;
+    state.localSubrs = &localSubrs[
+        fdSelect.empty() ? 0 : fdSelect[glyphIdx]];
+    state.x = 0;
+    state.y = 0;
+    state.isContourOpen = false;
+    state.numStems = 0;
+    state.sp = 0;
+
+    execute(stream, state, start, end, 0);
+}
+
+
+}
+}
@@ -0,0 +1,64 @@
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "native/outline.h"
+#include "sfnt.h"
+
+
+namespace dpfb {
+namespace native {
+
+
+struct CffIndex {
+    std::uint32_t offsetsPos;
+    // Position of the byte preceding the object data, since
+    // offsets in INDEX are 1-based.
+    std::uint32_t dataPos;
+    std::uint16_t count;
+    std::uint8_t offSize;
+};
+
+
+/**
+ * Reader of CFF outlines ("CFF " table).
+ *
+ * Both name-keyed and CID-keyed fonts are supported. The deprecated
+ * seac-like endchar accent composition is not supported; such
+ * glyphs are rendered without the accent.
+ */
+class CffOutlineReader : public OutlineReader {
+public:
+    /**
+     * \throws streams::StreamError
+     */
+    CffOutlineReader(
+        streams::Stream& stream,
+        const SfntOffsetTable& sfntOffsetTable);
+
+    void read(
+        streams::Stream& stream,
+        GlyphIndex glyphIdx,
+        Outline& outline) override;
+private:
+    CffIndex charStrings;
+    CffIndex globalSubrs;
+    // Local subroutines of every Font DICT. Name-keyed fonts have
+    // only one Private DICT.
+    std::vector<CffIndex> localSubrs;
+    // Font DICT index for every glyph. Empty for name-keyed fonts.
+    std::vector<std::uint8_t> fdSelect;
+
+    CffIndex readPrivateDictSubrs(
+        streams::Stream& stream,
+        std::uint32_t cffOffset,
+        std::uint32_t privateDictSize,
+        std::uint32_t privateDictOffset);
+    void readFdSelect(streams::Stream& stream, std::uint32_t fdSelectPos);
+};
+
+
+}
+}
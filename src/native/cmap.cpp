@@ -0,0 +1,244 @@
+
+#include "native/cmap.h"
+
+#include <algorithm>
+#include <cinttypes>
+
+#include "str.h"
+
+
+// https://docs.microsoft.com/en-us/typography/opentype/spec/cmap
+
+
+namespace dpfb {
+namespace native {
+
+
+using namespace streams;
+
+
+// Higher is better; 0 means the subtable is not usable.
+static int getSubtablePriority(
+    std::uint16_t platformId,
+    std::uint16_t encodingId,
+    std::uint16_t format)
+{
+    const auto isUnicode = (
+        platformId == 0
+        || (platformId == 3 && (encodingId == 1 || encodingId == 10)));
+    if (!isUnicode)
+        return 0;
+
+    switch (format) {
+        case 12:
+            return 2;
+        case 4:
+        case 6:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+
+Cmap::Cmap(
+        Stream& stream,
+        const SfntOffsetTable& sfntOffsetTable)
+    : segments {}
+    , glyphIds {}
+    , glyphIdxMask {0xffff}
+{
+    const auto cmapOffset = sfntOffsetTable.getTableOffset(
+        sfntTag('c', 'm', 'a', 'p'));
+    if (cmapOffset == 0)
+        throw StreamError("Font has no \"cmap\" table");
+
+    stream.seek(cmapOffset, SeekOrigin::set);
+    // Skip version
+    stream.seek(sizeof(std::uint16_t), SeekOrigin::cur);
+    const auto numTables = stream.readU16Be();
+
+    std::uint32_t bestSubtableOffset = 0;
+    int bestPriority = 0;
+    for (std::uint16_t i = 0; i < numTables; ++i) {
+        stream.seek(
+            cmapOffset + 4 + i * 8, SeekOrigin::set);
+        const auto platformId = stream.readU16Be();
+        const auto encodingId = stream.readU16Be();
+        const auto subtableOffset = cmapOffset + stream.readU32Be();
+
+        stream.seek(subtableOffset, SeekOrigin::set);
+        const auto format = stream.readU16Be();
+
+        const auto priority = getSubtablePriority(
+            platformId, encodingId, format);
+        if (priority > bestPriority) {
+            bestSubtableOffset = subtableOffset;
+            bestPriority = priority;
+        }
+    }
+
+    if (bestPriority == 0)
+        throw StreamError("Font doesn't contain Unicode charmap");
+
+    stream.seek(bestSubtableOffset, SeekOrigin::set);
+    const auto format = stream.readU16Be();
+    if (format == 4)
+        readFormat4(stream);
+    else if (format == 6)
+        readFormat6(stream);
+    else
+        readFormat12(stream);
+}
+
+
+void Cmap::readFormat4(Stream& stream)
+{
+    const auto length = stream.readU16Be();
+    // Skip language
+    stream.seek(sizeof(std::uint16_t), SeekOrigin::cur);
+
+    const auto segCount = stream.readU16Be() / 2;
+    // Skip searchRange, entrySelector, and rangeShift
+    stream.seek(sizeof(std::uint16_t) * 3, SeekOrigin::cur);
+
+    const auto endCodesPos = stream.getPosition();
+    const auto startCodesPos = endCodesPos + (segCount + 1) * 2;
+    const auto idDeltasPos = startCodesPos + segCount * 2;
+    const auto idRangeOffsetsPos = idDeltasPos + segCount * 2;
+    const auto glyphIdsPos = idRangeOffsetsPos + segCount * 2;
+
+    // The glyph ID array takes the rest of the subtable.
+    const auto headerSize = 16 + segCount * 8;
+    if (length > headerSize) {
+        glyphIds.resize((length - headerSize) / 2);
+        stream.seek(glyphIdsPos, SeekOrigin::set);
+        for (auto& glyphId : glyphIds)
+            glyphId = stream.readU16Be();
+    }
+
+    segments.reserve(segCount);
+    for (std::uint16_t i = 0; i < segCount; ++i) {
+        Segment segment;
+
+        stream.seek(endCodesPos + i * 2, SeekOrigin::set);
+        segment.end = stream.readU16Be();
+        stream.seek(startCodesPos + i * 2, SeekOrigin::set);
+        segment.start = stream.readU16Be();
+        if (segment.start > segment.end)
+            continue;
+
+        stream.seek(idDeltasPos + i * 2, SeekOrigin::set);
+        segment.idDelta = stream.readU16Be();
+        stream.seek(idRangeOffsetsPos + i * 2, SeekOrigin::set);
+        const auto idRangeOffset = stream.readU16Be();
+
+        if (idRangeOffset == 0)
+            segment.glyphIdsIdx = noGlyphIds;
+        else {
+            // idRangeOffset is relative to its own position in the
+            // idRangeOffset array.
+            const auto idx = idRangeOffset / 2 + i - segCount;
+            if (idx < 0)
+                continue;
+            segment.glyphIdsIdx = idx;
+        }
+
+        segments.push_back(segment);
+    }
+
+    // Segments must be sorted, but we don't trust the font.
+    std::sort(
+        segments.begin(), segments.end(),
+        [](const Segment& a, const Segment& b)
+        {
+            return a.end < b.end;
+        });
+}
+
+
+void Cmap::readFormat6(Stream& stream)
+{
+    // Skip length and language
+    stream.seek(sizeof(std::uint16_t) * 2, SeekOrigin::cur);
+
+    const auto firstCode = stream.readU16Be();
+    const auto entryCount = stream.readU16Be();
+    if (entryCount == 0)
+        return;
+
+    glyphIds.resize(entryCount);
+    for (auto& glyphId : glyphIds)
+        glyphId = stream.readU16Be();
+
+    segments.push_back(
+        {firstCode,
+            static_cast<char32_t>(firstCode + entryCount - 1),
+            0,
+            0});
+}
+
+
+void Cmap::readFormat12(Stream& stream)
+{
+    // Skip reserved, length, and language
+    stream.seek(
+        sizeof(std::uint16_t) + sizeof(std::uint32_t) * 2,
+        SeekOrigin::cur);
+
+    glyphIdxMask = 0xffffffff;
+
+    const auto numGroups = stream.readU32Be();
+    segments.reserve(numGroups);
+    for (std::uint32_t i = 0; i < numGroups; ++i) {
+        Segment segment;
+        segment.start = stream.readU32Be();
+        segment.end = stream.readU32Be();
+        segment.idDelta = stream.readU32Be() - segment.start;
+        segment.glyphIdsIdx = noGlyphIds;
+
+        if (segment.start > segment.end)
+            throw StreamError(str::format(
+                "cmap format 12 group %" PRIu32 " has startCharCode > "
+                "endCharCode",
+                i));
+
+        if (!segments.empty() && segment.start <= segments.back().end)
+            throw StreamError(
+                "cmap format 12 groups are not sorted or overlap");
+
+        segments.push_back(segment);
+    }
+}
+
+
+GlyphIndex Cmap::getGlyphIndex(char32_t cp) const
+{
+    const auto iter = std::lower_bound(
+        segments.begin(), segments.end(), cp,
+        [](const Segment& segment, char32_t cp)
+        {
+            return segment.end < cp;
+        });
+    if (iter == segments.end() || iter->start > cp)
+        return 0;
+
+    std::uint32_t glyphIdx;
+    if (iter->glyphIdsIdx == noGlyphIds)
+        glyphIdx = cp;
+    else {
+        const auto idx = iter->glyphIdsIdx + (cp - iter->start);
+        if (idx >= glyphIds.size())
+            return 0;
+
+        glyphIdx = glyphIds[idx];
+        if (glyphIdx == 0)
+            return 0;
+    }
+
+    return (glyphIdx + iter->idDelta) & glyphIdxMask;
+}
+
+
+}
+}
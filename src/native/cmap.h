@@ -0,0 +1,62 @@
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "font_renderer/font_renderer.h"
+#include "sfnt.h"
+#include "streams/stream.h"
+
+
+namespace dpfb {
+namespace native {
+
+
+/**
+ * Unicode character to glyph mapping ("cmap" table).
+ *
+ * Formats 4, 6, and 12 are supported. When the font has several
+ * Unicode subtables, the one with the full Unicode repertoire
+ * (format 12) is preferred over BMP-only ones.
+ */
+class Cmap {
+public:
+    /**
+     * \throws streams::StreamError
+     */
+    Cmap(
+        streams::Stream& stream,
+        const SfntOffsetTable& sfntOffsetTable);
+
+    /**
+     * Return the glyph index for the code point, or 0 if the font
+     * has no glyph for it.
+     */
+    GlyphIndex getGlyphIndex(char32_t cp) const;
+private:
+    struct Segment {
+        char32_t start;
+        char32_t end;
+        std::uint32_t idDelta;
+        // Index of the glyph for the start code point in glyphIds,
+        // or noGlyphIds if glyphs are computed with idDelta alone.
+        std::uint32_t glyphIdsIdx;
+    };
+
+    static const std::uint32_t noGlyphIds = 0xffffffff;
+
+    // Sorted by end.
+    std::vector<Segment> segments;
+    std::vector<std::uint16_t> glyphIds;
+    // Format 4 and 6 glyph indices are computed modulo 65536.
+    std::uint32_t glyphIdxMask;
+
+    void readFormat4(streams::Stream& stream);
+    void readFormat6(streams::Stream& stream);
+    void readFormat12(streams::Stream& stream);
+};
+
+
+}
+}
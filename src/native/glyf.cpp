@@ -0,0 +1,364 @@
+
+#include "native/glyf.h"
+
+#include <cinttypes>
+
+#include "str.h"
+
+
+namespace dpfb {
+namespace native {
+
+
+using namespace streams;
+
+
+// The same as in FreeType (TT_MAX_COMPOSITE_RECURSE).
+const int maxCompositeDepth = 5;
+
+
+GlyfOutlineReader::GlyfOutlineReader(
+        const SfntOffsetTable& sfntOffsetTable,
+        std::uint16_t numGlyphs,
+        int indexToLocFormat)
+    : locaOffset {
+        sfntOffsetTable.getTableOffset(sfntTag('l', 'o', 'c', 'a'))}
+    , glyfOffset {
+        sfntOffsetTable.getTableOffset(sfntTag('g', 'l', 'y', 'f'))}
+    , numGlyphs {numGlyphs}
+    , indexToLocFormat {indexToLocFormat}
+    , points {}
+    , contourEnds {}
+    , pointFlags {}
+{
+    if (locaOffset == 0)
+        throw StreamError("Font has no \"loca\" table");
+    if (glyfOffset == 0)
+        throw StreamError("Font has no \"glyf\" table");
+
+    if (indexToLocFormat != 0 && indexToLocFormat != 1)
+        throw StreamError(str::format(
+            "Invalid indexToLocFormat %i", indexToLocFormat));
+}
+
+
+void GlyfOutlineReader::read(
+    Stream& stream, GlyphIndex glyphIdx, Outline& outline)
+{
+    points.clear();
+    contourEnds.clear();
+
+    readGlyph(stream, glyphIdx, 0);
+    convertToOutline(outline);
+}
+
+
+// https://docs.microsoft.com/en-us/typography/opentype/spec/glyf
+void GlyfOutlineReader::readGlyph(
+    Stream& stream, GlyphIndex glyphIdx, int depth)
+{
+    if (glyphIdx >= numGlyphs)
+        throw StreamError(str::format(
+            "Glyph index %" PRIuLEAST32 " >= number of glyphs "
+            "(%" PRIu16 ")",
+            glyphIdx, numGlyphs));
+
+    std::uint32_t glyphOffset;
+    std::uint32_t nextGlyphOffset;
+    if (indexToLocFormat == 0) {
+        stream.seek(
+            locaOffset + glyphIdx * sizeof(std::uint16_t),
+            SeekOrigin::set);
+        glyphOffset = stream.readU16Be() * 2;
+        nextGlyphOffset = stream.readU16Be() * 2;
+    } else {
+        stream.seek(
+            locaOffset + glyphIdx * sizeof(std::uint32_t),
+            SeekOrigin::set);
+        glyphOffset = stream.readU32Be();
+        nextGlyphOffset = stream.readU32Be();
+    }
+
+    if (glyphOffset >= nextGlyphOffset)
+        // Empty glyph
+        return;
+
+    stream.seek(glyfOffset + glyphOffset, SeekOrigin::set);
+
+    const auto numContours = stream.readS16Be();
+    // Skip xMin, yMin, xMax, and yMax
+    stream.seek(4 * sizeof(std::int16_t), SeekOrigin::cur);
+
+    if (numContours >= 0)
+        readSimpleGlyph(stream, numContours);
+    else if (depth < maxCompositeDepth)
+        readCompositeGlyph(stream, points.size(), depth);
+    else
+        throw StreamError(str::format(
+            "Composite glyph nesting exceeds %i levels",
+            maxCompositeDepth));
+}
+
+
+enum SimpleGlyphFlag {
+    onCurvePoint = 0x01,
+    xShortVector = 0x02,
+    yShortVector = 0x04,
+    repeatFlag = 0x08,
+    xIsSameOrPositiveXShortVector = 0x10,
+    yIsSameOrPositiveYShortVector = 0x20,
+};
+
+
+void GlyfOutlineReader::readSimpleGlyph(
+    Stream& stream, std::int16_t numContours)
+{
+    if (numContours == 0)
+        return;
+
+    const auto firstPointIdx = points.size();
+
+    std::size_t numPoints = 0;
+    for (std::int16_t i = 0; i < numContours; ++i) {
+        const std::size_t endPt = stream.readU16Be();
+        if (endPt + 1 < numPoints)
+            throw StreamError(
+                "Glyph contour end points are not increasing");
+
+        numPoints = endPt + 1;
+        contourEnds.push_back(firstPointIdx + endPt);
+    }
+
+    // Skip instructions
+    stream.seek(stream.readU16Be(), SeekOrigin::cur);
+
+    pointFlags.resize(numPoints);
+    for (std::size_t i = 0; i < numPoints;) {
+        const auto flag = stream.readU8();
+        pointFlags[i++] = flag;
+
+        if (flag & repeatFlag) {
+            auto repeatCount = stream.readU8();
+            if (repeatCount > numPoints - i)
+                throw StreamError("Glyph flag repeat count is too big");
+
+            while (repeatCount--)
+                pointFlags[i++] = flag;
+        }
+    }
+
+    points.resize(firstPointIdx + numPoints);
+    auto* glyphPoints = &points[firstPointIdx];
+
+    int x = 0;
+    for (std::size_t i = 0; i < numPoints; ++i) {
+        const auto flag = pointFlags[i];
+        if (flag & xShortVector) {
+            const int dx = stream.readU8();
+            x += flag & xIsSameOrPositiveXShortVector ? dx : -dx;
+        } else if (!(flag & xIsSameOrPositiveXShortVector))
+            x += stream.readS16Be();
+
+        glyphPoints[i].x = x;
+        glyphPoints[i].onCurve = flag & onCurvePoint;
+    }
+
+    int y = 0;
+    for (std::size_t i = 0; i < numPoints; ++i) {
+        const auto flag = pointFlags[i];
+        if (flag & yShortVector) {
+            const int dy = stream.readU8();
+            y += flag & yIsSameOrPositiveYShortVector ? dy : -dy;
+        } else if (!(flag & yIsSameOrPositiveYShortVector))
+            y += stream.readS16Be();
+
+        glyphPoints[i].y = y;
+    }
+}
+
+
+enum CompositeGlyphFlag {
+    arg1And2AreWords = 0x0001,
+    argsAreXyValues = 0x0002,
+    weHaveAScale = 0x0008,
+    moreComponents = 0x0020,
+    weHaveAnXAndYScale = 0x0040,
+    weHaveATwoByTwo = 0x0080,
+    scaledComponentOffset = 0x0800,
+    unscaledComponentOffset = 0x1000,
+};
+
+
+static float readF2Dot14(Stream& stream)
+{
+    return stream.readS16Be() / 16384.0f;
+}
+
+
+void GlyfOutlineReader::readCompositeGlyph(
+    Stream& stream, std::size_t firstPointIdx, int depth)
+{
+    std::uint16_t flags;
+    do {
+        flags = stream.readU16Be();
+        const auto glyphIdx = stream.readU16Be();
+
+        int arg1;
+        int arg2;
+        if (flags & arg1And2AreWords) {
+            if (flags & argsAreXyValues) {
+                arg1 = stream.readS16Be();
+                arg2 = stream.readS16Be();
+            } else {
+                arg1 = stream.readU16Be();
+                arg2 = stream.readU16Be();
+            }
+        } else {
+            if (flags & argsAreXyValues) {
+                arg1 = stream.readS8();
+                arg2 = stream.readS8();
+            } else {
+                arg1 = stream.readU8();
+                arg2 = stream.readU8();
+            }
+        }
+
+        float xx = 1.0f;
+        float xy = 0.0f;
+        float yx = 0.0f;
+        float yy = 1.0f;
+        if (flags & weHaveAScale)
+            xx = yy = readF2Dot14(stream);
+        else if (flags & weHaveAnXAndYScale) {
+            xx = readF2Dot14(stream);
+            yy = readF2Dot14(stream);
+        } else if (flags & weHaveATwoByTwo) {
+            xx = readF2Dot14(stream);
+            yx = readF2Dot14(stream);
+            xy = readF2Dot14(stream);
+            yy = readF2Dot14(stream);
+        }
+
+        const auto nextComponentPos = stream.getPosition();
+
+        const auto componentStart = points.size();
+        readGlyph(stream, glyphIdx, depth + 1);
+
+        for (auto i = componentStart; i < points.size(); ++i) {
+            auto& p = points[i];
+            const auto x = p.x;
+            const auto y = p.y;
+            p.x = xx * x + xy * y;
+            p.y = yx * x + yy * y;
+        }
+
+        float dx;
+        float dy;
+        if (flags & argsAreXyValues) {
+            dx = arg1;
+            dy = arg2;
+
+            // Apple's and Microsoft's rasterizers disagree on
+            // whether the offset should be scaled. Without explicit
+            // flags, we follow Microsoft (and FreeType) and use the
+            // unscaled offset.
+            if ((flags & scaledComponentOffset)
+                    && !(flags & unscaledComponentOffset)) {
+                dx = xx * arg1 + xy * arg2;
+                dy = yx * arg1 + yy * arg2;
+            }
+        } else {
+            // Align the point arg2 of the component with the point
+            // arg1 of the glyph assembled so far. Both are relative
+            // to their glyphs, which matters for nested composites.
+            const auto parentPointIdx = firstPointIdx + arg1;
+            const auto childPointIdx = componentStart + arg2;
+            if (parentPointIdx >= componentStart
+                    || childPointIdx >= points.size())
+                throw StreamError(
+                    "Invalid point numbers in composite glyph");
+
+            dx = points[parentPointIdx].x - points[childPointIdx].x;
+            dy = points[parentPointIdx].y - points[childPointIdx].y;
+        }
+
+        for (auto i = componentStart; i < points.size(); ++i) {
+            points[i].x += dx;
+            points[i].y += dy;
+        }
+
+        stream.seek(nextComponentPos, SeekOrigin::set);
+    } while (flags & moreComponents);
+}
+
+
+void GlyfOutlineReader::convertToOutline(Outline& outline) const
+{
+    outline.clear();
+
+    std::size_t contourStart = 0;
+    for (const auto contourEnd : contourEnds) {
+        const auto* contour = &points[contourStart];
+        const std::size_t numPoints = contourEnd - contourStart + 1;
+        contourStart = contourEnd + 1;
+
+        if (numPoints < 2)
+            continue;
+
+        // Find the starting point. If all points are off-curve,
+        // start from the implied on-curve point between the first
+        // two ones.
+        std::size_t startIdx = 0;
+        while (startIdx < numPoints && !contour[startIdx].onCurve)
+            ++startIdx;
+
+        PointF start;
+        std::size_t numSteps;
+        if (startIdx < numPoints) {
+            start.x = contour[startIdx].x;
+            start.y = contour[startIdx].y;
+            numSteps = numPoints - 1;
+        } else {
+            startIdx = 0;
+            start.x = (contour[0].x + contour[1].x) * 0.5f;
+            start.y = (contour[0].y + contour[1].y) * 0.5f;
+            numSteps = numPoints;
+        }
+
+        outline.moveTo(start.x, start.y);
+
+        bool hasControl = false;
+        PointF control;
+        for (std::size_t i = 1; i <= numSteps; ++i) {
+            const auto& p = contour[(startIdx + i) % numPoints];
+
+            if (p.onCurve) {
+                if (hasControl) {
+                    outline.quadTo(control.x, control.y, p.x, p.y);
+                    hasControl = false;
+                } else
+                    outline.lineTo(p.x, p.y);
+            } else {
+                if (hasControl)
+                    outline.quadTo(
+                        control.x,
+                        control.y,
+                        (control.x + p.x) * 0.5f,
+                        (control.y + p.y) * 0.5f);
+
+                control.x = p.x;
+                control.y = p.y;
+                hasControl = true;
+            }
+        }
+
+        if (hasControl)
+            outline.quadTo(control.x, control.y, start.x, start.y);
+        else
+            outline.lineTo(start.x, start.y);
+    }
+}
+
+
+}
+}
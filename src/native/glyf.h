@@ -0,0 +1,68 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "native/outline.h"
+#include "sfnt.h"
+
+
+namespace dpfb {
+namespace native {
+
+
+/**
+ * Reader of TrueType outlines ("glyf" and "loca" tables).
+ */
+class GlyfOutlineReader : public OutlineReader {
+public:
+    /**
+     * \param numGlyphs number of glyphs from the "maxp" table
+     * \param indexToLocFormat format of the "loca" table from
+     *     the "head" table
+     *
+     * \throws streams::StreamError
+     */
+    GlyfOutlineReader(
+        const SfntOffsetTable& sfntOffsetTable,
+        std::uint16_t numGlyphs,
+        int indexToLocFormat);
+
+    void read(
+        streams::Stream& stream,
+        GlyphIndex glyphIdx,
+        Outline& outline) override;
+private:
+    struct TtPoint {
+        float x;
+        float y;
+        bool onCurve;
+    };
+
+    std::uint32_t locaOffset;
+    std::uint32_t glyfOffset;
+    std::uint16_t numGlyphs;
+    int indexToLocFormat;
+
+    // Scratch buffers
+    std::vector<TtPoint> points;
+    std::vector<std::uint16_t> contourEnds;
+    std::vector<std::uint8_t> pointFlags;
+
+    void readGlyph(
+        streams::Stream& stream, GlyphIndex glyphIdx, int depth);
+    void readSimpleGlyph(
+        streams::Stream& stream, std::int16_t numContours);
+    // firstPointIdx is the index of the first point of the
+    // composite glyph in points.
+    void readCompositeGlyph(
+        streams::Stream& stream, std::size_t firstPointIdx, int depth);
+
+    void convertToOutline(Outline& outline) const;
+};
+
+
+}
+}
@@ -0,0 +1,94 @@
+
+#include "native/outline.h"
+
+#include <cassert>
+
+
+namespace dpfb {
+namespace native {
+
+
+void Outline::clear()
+{
+    ops.clear();
+    points.clear();
+}
+
+
+bool Outline::isEmpty() const
+{
+    return ops.empty();
+}
+
+
+void Outline::moveTo(float x, float y)
+{
+    ops.push_back(Op::moveTo);
+    points.push_back({x, y});
+}
+
+
+void Outline::lineTo(float x, float y)
+{
+    assert(!ops.empty());
+    ops.push_back(Op::lineTo);
+    points.push_back({x, y});
+}
+
+
+void Outline::quadTo(float x1, float y1, float x, float y)
+{
+    assert(!ops.empty());
+    ops.push_back(Op::quadTo);
+    points.push_back({x1, y1});
+    points.push_back({x, y});
+}
+
+
+void Outline::cubicTo(
+    float x1, float y1, float x2, float y2, float x, float y)
+{
+    assert(!ops.empty());
+    ops.push_back(Op::cubicTo);
+    points.push_back({x1, y1});
+    points.push_back({x2, y2});
+    points.push_back({x, y});
+}
+
+
+const std::vector<Outline::Op>& Outline::getOps() const
+{
+    return ops;
+}
+
+
+const std::vector<PointF>& Outline::getPoints() const
+{
+    return points;
+}
+
+
+void Outline::getCBox(
+    float& xMin, float& yMin, float& xMax, float& yMax) const
+{
+    assert(!points.empty());
+
+    xMin = xMax = points[0].x;
+    yMin = yMax = points[0].y;
+
+    for (const auto& p : points) {
+        if (p.x < xMin)
+            xMin = p.x;
+        else if (p.x > xMax)
+            xMax = p.x;
+
+        if (p.y < yMin)
+            yMin = p.y;
+        else if (p.y > yMax)
+            yMax = p.y;
+    }
+}
+
+
+}
+}
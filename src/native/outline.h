@@ -0,0 +1,97 @@
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "font_renderer/font_renderer.h"
+#include "streams/stream.h"
+
+
+namespace dpfb {
+namespace native {
+
+
+struct PointF {
+    float x;
+    float y;
+};
+
+
+/**
+ * Glyph outline in font units.
+ *
+ * Every contour starts with moveTo() and is implicitly closed by
+ * the next moveTo() or the end of the outline.
+ */
+class Outline {
+public:
+    enum class Op : std::uint8_t {
+        moveTo,
+        lineTo,
+        quadTo,
+        cubicTo
+    };
+
+    void clear();
+    bool isEmpty() const;
+
+    void moveTo(float x, float y);
+    void lineTo(float x, float y);
+    void quadTo(float x1, float y1, float x, float y);
+    void cubicTo(
+        float x1, float y1, float x2, float y2, float x, float y);
+
+    const std::vector<Op>& getOps() const;
+
+    /**
+     * Points of all operations.
+     *
+     * moveTo and lineTo have 1 point, quadTo 2, and cubicTo 3.
+     */
+    const std::vector<PointF>& getPoints() const;
+
+    /**
+     * Get the control box.
+     *
+     * Like in FreeType, this is the bounding box of all points,
+     * including control points of curves. It's not defined for
+     * empty outlines.
+     */
+    void getCBox(
+        float& xMin, float& yMin, float& xMax, float& yMax) const;
+private:
+    std::vector<Op> ops;
+    std::vector<PointF> points;
+};
+
+
+/**
+ * Reader of glyph outlines from a font table.
+ *
+ * Implementations keep only table offsets and scratch buffers;
+ * the font data is accessed through the stream passed to read().
+ */
+class OutlineReader {
+public:
+    OutlineReader() = default;
+    virtual ~OutlineReader() {};
+
+    OutlineReader(const OutlineReader& other) = delete;
+    OutlineReader& operator=(const OutlineReader& other) = delete;
+
+    /**
+     * Read the outline of the glyph, replacing the contents of
+     * the given outline.
+     *
+     * \throws streams::StreamError
+     */
+    virtual void read(
+        streams::Stream& stream,
+        GlyphIndex glyphIdx,
+        Outline& outline) = 0;
+};
+
+
+}
+}
@@ -0,0 +1,433 @@
+
+#include "native/rasterizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+
+#if defined(__SSE2__) \
+        || defined(_M_X64) \
+        || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define DPFB_NATIVE_SSE2
+    #include <emmintrin.h>
+
+    // AVX2 code is compiled with the target attribute, so it doesn't
+    // require -mavx2 for the whole file. The CPU is checked at
+    // runtime.
+    #if (defined(__GNUC__) || defined(__clang__)) \
+            && (defined(__x86_64__) || defined(__i386__))
+        #define DPFB_NATIVE_AVX2
+        #include <immintrin.h>
+    #endif
+#endif
+
+
+namespace dpfb {
+namespace native {
+
+
+SimdLevel getMaxSimdLevel()
+{
+    #ifdef DPFB_NATIVE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SimdLevel::avx2;
+    #endif
+
+    #ifdef DPFB_NATIVE_SSE2
+    return SimdLevel::sse2;
+    #else
+    return SimdLevel::scalar;
+    #endif
+}
+
+
+// Cells past the end of the buffer that drawLine() may touch when
+// a line lies on the right edge of the last row.
+const int accSlack = 2;
+
+
+Rasterizer::Rasterizer()
+    : simdLevel {getMaxSimdLevel()}
+    , w {}
+    , h {}
+    , acc {}
+{
+
+}
+
+
+void Rasterizer::setSimdLevel(SimdLevel newSimdLevel)
+{
+    assert(newSimdLevel <= getMaxSimdLevel());
+    simdLevel = newSimdLevel;
+}
+
+
+void Rasterizer::reset(int newW, int newH)
+{
+    w = newW;
+    h = newH;
+    acc.assign(static_cast<std::size_t>(w) * h + accSlack, 0.0f);
+}
+
+
+void Rasterizer::drawLine(PointF p0, PointF p1)
+{
+    if (p0.y == p1.y)
+        return;
+
+    // Points outside the buffer can only appear due to rounding
+    // errors, so clamping doesn't affect the result in practice.
+    p0.x = std::min(std::max(p0.x, 0.0f), static_cast<float>(w));
+    p1.x = std::min(std::max(p1.x, 0.0f), static_cast<float>(w));
+
+    float dir;
+    if (p0.y < p1.y)
+        dir = 1.0f;
+    else {
+        dir = -1.0f;
+        std::swap(p0, p1);
+    }
+
+    const auto dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+    auto x = p0.x;
+    if (p0.y < 0.0f)
+        x -= p0.y * dxdy;
+
+    const auto yStart = std::max(0, static_cast<int>(p0.y));
+    const auto yEnd = std::min(h, static_cast<int>(std::ceil(p1.y)));
+
+    for (int y = yStart; y < yEnd; ++y) {
+        auto* line = acc.data() + static_cast<std::size_t>(y) * w;
+
+        const auto dy = (
+            std::min(static_cast<float>(y + 1), p1.y)
+            - std::max(static_cast<float>(y), p0.y));
+        const auto xNext = x + dxdy * dy;
+        const auto d = dy * dir;
+
+        const auto x0 = std::min(x, xNext);
+        const auto x1 = std::max(x, xNext);
+        const auto x0Floor = std::floor(x0);
+        const auto x0i = static_cast<int>(x0Floor);
+        const auto x1Ceil = std::ceil(x1);
+        const auto x1i = static_cast<int>(x1Ceil);
+
+        if (x1i <= x0i + 1) {
+            // The line is within one cell.
+            const auto xmf = 0.5f * (x + xNext) - x0Floor;
+            line[x0i] += d - d * xmf;
+            line[x0i + 1] += d * xmf;
+        } else {
+            const auto s = 1.0f / (x1 - x0);
+            const auto x0f = x0 - x0Floor;
+            const auto a0 = 0.5f * s * (1.0f - x0f) * (1.0f - x0f);
+            const auto x1f = x1 - x1Ceil + 1.0f;
+            const auto am = 0.5f * s * x1f * x1f;
+
+            line[x0i] += d * a0;
+            if (x1i == x0i + 2)
+                line[x0i + 1] += d * (1.0f - a0 - am);
+            else {
+                const auto a1 = s * (1.5f - x0f);
+                line[x0i + 1] += d * (a1 - a0);
+                for (auto xi = x0i + 2; xi < x1i - 1; ++xi)
+                    line[xi] += d * s;
+
+                const auto a2 = a1 + (x1i - x0i - 3) * s;
+                line[x1i - 1] += d * (1.0f - a2 - am);
+            }
+            line[x1i] += d * am;
+        }
+
+        x = xNext;
+    }
+}
+
+
+static PointF lerp(float t, PointF p0, PointF p1)
+{
+    return {p0.x + t * (p1.x - p0.x), p0.y + t * (p1.y - p0.y)};
+}
+
+
+void Rasterizer::drawQuad(PointF p0, PointF p1, PointF p2)
+{
+    const auto devX = p0.x - 2.0f * p1.x + p2.x;
+    const auto devY = p0.y - 2.0f * p1.y + p2.y;
+    const auto devSq = devX * devX + devY * devY;
+    if (devSq < 0.333f) {
+        drawLine(p0, p2);
+        return;
+    }
+
+    // The same tolerance as in font-rs.
+    const auto tolerance = 3.0f;
+    const auto n = 1 + static_cast<int>(
+        std::sqrt(std::sqrt(tolerance * devSq)));
+    const auto step = 1.0f / n;
+
+    auto p = p0;
+    auto t = 0.0f;
+    for (int i = 0; i < n - 1; ++i) {
+        t += step;
+        const auto pNext = lerp(t, lerp(t, p0, p1), lerp(t, p1, p2));
+        drawLine(p, pNext);
+        p = pNext;
+    }
+    drawLine(p, p2);
+}
+
+
+void Rasterizer::drawCubic(PointF p0, PointF p1, PointF p2, PointF p3)
+{
+    const auto dev0X = p0.x - 2.0f * p1.x + p2.x;
+    const auto dev0Y = p0.y - 2.0f * p1.y + p2.y;
+    const auto dev1X = p1.x - 2.0f * p2.x + p3.x;
+    const auto dev1Y = p1.y - 2.0f * p2.y + p3.y;
+    const auto devSq = std::max(
+        dev0X * dev0X + dev0Y * dev0Y,
+        dev1X * dev1X + dev1Y * dev1Y);
+    if (devSq < 0.333f / 9.0f) {
+        drawLine(p0, p3);
+        return;
+    }
+
+    // The second derivative of a cubic is up to 3 times larger than
+    // that of a quadratic with the same control point deviation, so
+    // we need sqrt(3) times more segments for the same error.
+    const auto tolerance = 3.0f * 9.0f;
+    const auto n = 1 + static_cast<int>(
+        std::sqrt(std::sqrt(tolerance * devSq)));
+    const auto step = 1.0f / n;
+
+    auto p = p0;
+    auto t = 0.0f;
+    for (int i = 0; i < n - 1; ++i) {
+        t += step;
+        const auto p01 = lerp(t, p0, p1);
+        const auto p12 = lerp(t, p1, p2);
+        const auto p23 = lerp(t, p2, p3);
+        const auto pNext = lerp(
+            t, lerp(t, p01, p12), lerp(t, p12, p23));
+        drawLine(p, pNext);
+        p = pNext;
+    }
+    drawLine(p, p3);
+}
+
+
+void Rasterizer::drawOutline(
+    const Outline& outline, float scale, float dx, float dy)
+{
+    const auto& ops = outline.getOps();
+    const auto* points = outline.getPoints().data();
+
+    const auto transform = [&](const PointF& p) -> PointF
+    {
+        return {p.x * scale + dx, p.y * -scale + dy};
+    };
+
+    PointF start {};
+    PointF cur {};
+    for (const auto op : ops) {
+        switch (op) {
+            case Outline::Op::moveTo:
+                drawLine(cur, start);
+                start = cur = transform(points[0]);
+                ++points;
+                break;
+            case Outline::Op::lineTo: {
+                const auto p = transform(points[0]);
+                drawLine(cur, p);
+                cur = p;
+                ++points;
+                break;
+            }
+            case Outline::Op::quadTo: {
+                const auto p = transform(points[1]);
+                drawQuad(cur, transform(points[0]), p);
+                cur = p;
+                points += 2;
+                break;
+            }
+            case Outline::Op::cubicTo: {
+                const auto p = transform(points[2]);
+                drawCubic(
+                    cur, transform(points[0]), transform(points[1]), p);
+                cur = p;
+                points += 3;
+                break;
+            }
+        }
+    }
+
+    drawLine(cur, start);
+}
+
+
+static inline std::uint8_t coverageToU8(float sum)
+{
+    const auto coverage = std::min(std::abs(sum), 1.0f);
+    // Round to nearest even, like SIMD conversions.
+    return static_cast<std::uint8_t>(std::lrint(coverage * 255.0f));
+}
+
+
+// The accumulate*() functions process a row and return the running
+// sum, which is carried over to the next row.
+
+
+static float accumulateScalar(
+    const float* src, std::uint8_t* dst, int n, float sum)
+{
+    for (int i = 0; i < n; ++i) {
+        sum += src[i];
+        dst[i] = coverageToU8(sum);
+    }
+
+    return sum;
+}
+
+
+#ifdef DPFB_NATIVE_SSE2
+
+
+static float accumulateSse2(
+    const float* src, std::uint8_t* dst, int n, float sum)
+{
+    const auto absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const auto one = _mm_set1_ps(1.0f);
+    const auto maxValue = _mm_set1_ps(255.0f);
+
+    auto offset = _mm_set1_ps(sum);
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        // Prefix sum in 2 steps: shift by 1 and by 2 elements.
+        auto x = _mm_loadu_ps(src + i);
+        x = _mm_add_ps(
+            x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 4)));
+        x = _mm_add_ps(
+            x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 8)));
+        x = _mm_add_ps(x, offset);
+
+        const auto coverage = _mm_min_ps(_mm_and_ps(x, absMask), one);
+        const auto i32 = _mm_cvtps_epi32(_mm_mul_ps(coverage, maxValue));
+        const auto i16 = _mm_packs_epi32(i32, i32);
+        const auto u8 = _mm_packus_epi16(i16, i16);
+
+        const auto packed = _mm_cvtsi128_si32(u8);
+        std::memcpy(dst + i, &packed, 4);
+
+        offset = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+
+    return accumulateScalar(
+        src + i, dst + i, n - i, _mm_cvtss_f32(offset));
+}
+
+
+#endif  // DPFB_NATIVE_SSE2
+
+
+#ifdef DPFB_NATIVE_AVX2
+
+
+__attribute__((target("avx2")))
+static float accumulateAvx2(
+    const float* src, std::uint8_t* dst, int n, float sum)
+{
+    const auto absMask = _mm256_castsi256_ps(
+        _mm256_set1_epi32(0x7fffffff));
+    const auto one = _mm256_set1_ps(1.0f);
+    const auto maxValue = _mm256_set1_ps(255.0f);
+    const auto lastIdx = _mm256_set1_epi32(7);
+
+    auto offset = _mm256_set1_ps(sum);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        // Byte shifts work within 128-bit lanes, so we first compute
+        // prefix sums of both lanes, and then add the total of the
+        // low lane to the high one.
+        auto x = _mm256_loadu_ps(src + i);
+        x = _mm256_add_ps(
+            x,
+            _mm256_castsi256_ps(
+                _mm256_slli_si256(_mm256_castps_si256(x), 4)));
+        x = _mm256_add_ps(
+            x,
+            _mm256_castsi256_ps(
+                _mm256_slli_si256(_mm256_castps_si256(x), 8)));
+
+        // [0, low lane]
+        auto lowTotal = _mm256_permute2f128_ps(x, x, 0x08);
+        lowTotal = _mm256_shuffle_ps(
+            lowTotal, lowTotal, _MM_SHUFFLE(3, 3, 3, 3));
+        x = _mm256_add_ps(x, lowTotal);
+        x = _mm256_add_ps(x, offset);
+
+        const auto coverage = _mm256_min_ps(
+            _mm256_and_ps(x, absMask), one);
+        const auto i32 = _mm256_cvtps_epi32(
+            _mm256_mul_ps(coverage, maxValue));
+        const auto i16 = _mm_packs_epi32(
+            _mm256_castsi256_si128(i32),
+            _mm256_extracti128_si256(i32, 1));
+        const auto u8 = _mm_packus_epi16(i16, i16);
+
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), u8);
+
+        offset = _mm256_permutevar8x32_ps(x, lastIdx);
+    }
+
+    return accumulateSse2(
+        src + i,
+        dst + i,
+        n - i,
+        _mm_cvtss_f32(_mm256_castps256_ps128(offset)));
+}
+
+
+#endif  // DPFB_NATIVE_AVX2
+
+
+void Rasterizer::accumulate(Image& image)
+{
+    assert(image.getWidth() == w);
+    assert(image.getHeight() == h);
+
+    auto* accumulateFn = accumulateScalar;
+    switch (simdLevel) {
+        case SimdLevel::scalar:
+            break;
+        case SimdLevel::sse2:
+            #ifdef DPFB_NATIVE_SSE2
+            accumulateFn = accumulateSse2;
+            #endif
+            break;
+        case SimdLevel::avx2:
+            #ifdef DPFB_NATIVE_AVX2
+            accumulateFn = accumulateAvx2;
+            #endif
+            break;
+    }
+
+    const auto* src = acc.data();
+    auto* dst = image.getData();
+    float sum = 0.0f;
+    for (int y = 0; y < h; ++y) {
+        sum = accumulateFn(src, dst, w, sum);
+        src += w;
+        dst += image.getPitch();
+    }
+}
+
+
+}
+}
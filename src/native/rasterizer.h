@@ -0,0 +1,83 @@
+
+#pragma once
+
+#include <vector>
+
+#include "image.h"
+#include "native/outline.h"
+
+
+namespace dpfb {
+namespace native {
+
+
+enum class SimdLevel {
+    scalar,
+    sse2,
+    avx2
+};
+
+
+/**
+ * Return the best SIMD level supported by both the compiler and
+ * the CPU.
+ */
+SimdLevel getMaxSimdLevel();
+
+
+/**
+ * Antialiasing rasterizer based on signed area accumulation.
+ *
+ * The algorithm is the one from font-rs
+ * (https://github.com/raphlinus/font-rs): every line adds its
+ * signed area coverage to the cells it crosses, and a prefix sum
+ * over the buffer gives the final coverage. The prefix sum pass is
+ * vectorized with SSE2 and AVX2 when available.
+ *
+ * All coordinates are in pixels, with y increasing down.
+ */
+class Rasterizer {
+public:
+    Rasterizer();
+
+    /**
+     * Set the SIMD level of the accumulation pass.
+     *
+     * The default is getMaxSimdLevel(). The level must not be
+     * higher than that.
+     */
+    void setSimdLevel(SimdLevel newSimdLevel);
+
+    /**
+     * Clear the accumulation buffer and set its size.
+     */
+    void reset(int newW, int newH);
+
+    void drawLine(PointF p0, PointF p1);
+    void drawQuad(PointF p0, PointF p1, PointF p2);
+    void drawCubic(PointF p0, PointF p1, PointF p2, PointF p3);
+
+    /**
+     * Draw the outline, translating and scaling its points with
+     * x * scale + dx and y * -scale + dy.
+     *
+     * All contours are closed implicitly.
+     */
+    void drawOutline(
+        const Outline& outline, float scale, float dx, float dy);
+
+    /**
+     * Write the coverage to the image, which must have the size
+     * passed to reset().
+     */
+    void accumulate(Image& image);
+private:
+    SimdLevel simdLevel;
+    int w;
+    int h;
+    std::vector<float> acc;
+};
+
+
+}
+}
@@ -0,0 +1,296 @@
+
+#include "renderer_comparison.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+
+#include "image.h"
+#include "str.h"
+
+
+namespace dpfb {
+
+
+double RendererTiming::getGlyphsPerSec() const
+{
+    const auto timeNs = metricsNs + renderNs;
+    if (timeNs == 0)
+        return 0.0;
+
+    return numGlyphs / (timeNs / 1e9);
+}
+
+
+using Clock = std::chrono::steady_clock;
+
+
+static std::uint64_t getNsSince(Clock::time_point startTime)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - startTime).count();
+}
+
+
+static FontRenderer* createRenderer(
+    const FontRendererCreator& creator, const FontRendererArgs& args)
+{
+    try {
+        return creator.create(args);
+    } catch (FontRendererError& e) {
+        throw FontRendererError(str::format(
+            "Can't create %s font renderer: %s",
+            creator.getName(), e.what()));
+    }
+}
+
+
+// Like in Font, code points without a glyph are skipped, except 0.
+static bool hasGlyph(const FontRenderer& renderer, char32_t cp)
+{
+    return cp == 0 || renderer.getGlyphIndex(cp) != 0;
+}
+
+
+static RendererTiming timeRenderer(
+    const FontRendererCreator& creator,
+    const FontRendererArgs& args,
+    const cp_range::CpRangeList& cpRangeList)
+{
+    RendererTiming result {};
+    result.rendererName = creator.getName();
+
+    const auto initStartTime = Clock::now();
+    std::unique_ptr<FontRenderer> renderer(createRenderer(creator, args));
+    result.initNs = getNsSince(initStartTime);
+
+    std::vector<std::uint8_t> buffer;
+    for (const auto& cpRange : cpRangeList)
+        for (auto cp = cpRange.cpFirst; cp <= cpRange.cpLast; ++cp) {
+            const auto glyphIdx = renderer->getGlyphIndex(cp);
+            if (glyphIdx == 0 && cp != 0)
+                continue;
+
+            ++result.numGlyphs;
+
+            const auto metricsStartTime = Clock::now();
+            const auto metrics = renderer->getGlyphMetrics(glyphIdx);
+            result.metricsNs += getNsSince(metricsStartTime);
+
+            if (metrics.size.w == 0 || metrics.size.h == 0)
+                continue;
+
+            buffer.assign(
+                static_cast<std::size_t>(metrics.size.w) * metrics.size.h,
+                0);
+            Image image(
+                buffer.data(),
+                metrics.size.w,
+                metrics.size.h,
+                metrics.size.w);
+
+            const auto renderStartTime = Clock::now();
+            renderer->renderGlyph(glyphIdx, image);
+            result.renderNs += getNsSince(renderStartTime);
+        }
+
+    return result;
+}
+
+
+static bool isEmpty(const GlyphBitmap& bitmap)
+{
+    return bitmap.metrics.size.w == 0 || bitmap.metrics.size.h == 0;
+}
+
+
+// x and y are relative to the origin; y increases up, and offset.y
+// is the top edge of the bitmap.
+static int getPixel(const GlyphBitmap& bitmap, int x, int y)
+{
+    const auto& metrics = bitmap.metrics;
+    const auto col = x - metrics.offset.x;
+    const auto row = metrics.offset.y - 1 - y;
+    if (col < 0 || col >= metrics.size.w
+            || row < 0 || row >= metrics.size.h)
+        return 0;
+
+    return bitmap.pixels[row * metrics.size.w + col];
+}
+
+
+GlyphBitmapDiff compareGlyphBitmaps(
+    const GlyphBitmap& bitmap1, const GlyphBitmap& bitmap2)
+{
+    GlyphBitmapDiff result {};
+
+    const GlyphBitmap* bitmaps[] = {&bitmap1, &bitmap2};
+
+    bool hasBox = false;
+    int xMin = 0;
+    int yMin = 0;
+    int xMax = 0;
+    int yMax = 0;
+    for (const auto* bitmap : bitmaps) {
+        if (isEmpty(*bitmap))
+            continue;
+
+        const auto& offset = bitmap->metrics.offset;
+        const auto& size = bitmap->metrics.size;
+        if (!hasBox) {
+            hasBox = true;
+            xMin = offset.x;
+            yMin = offset.y - size.h;
+            xMax = offset.x + size.w;
+            yMax = offset.y;
+        } else {
+            xMin = std::min(xMin, offset.x);
+            yMin = std::min(yMin, offset.y - size.h);
+            xMax = std::max(xMax, offset.x + size.w);
+            yMax = std::max(yMax, offset.y);
+        }
+    }
+
+    if (!hasBox)
+        return result;
+
+    for (auto y = yMin; y < yMax; ++y)
+        for (auto x = xMin; x < xMax; ++x) {
+            const auto error = std::abs(
+                getPixel(bitmap1, x, y) - getPixel(bitmap2, x, y));
+            result.maxError = std::max(result.maxError, error);
+            result.errorSum += error;
+        }
+
+    result.numPixels = (
+        static_cast<std::uint64_t>(xMax - xMin) * (yMax - yMin));
+
+    return result;
+}
+
+
+static void renderBitmap(
+    const FontRenderer& renderer, char32_t cp, GlyphBitmap& bitmap)
+{
+    const auto glyphIdx = renderer.getGlyphIndex(cp);
+    bitmap.metrics = renderer.getGlyphMetrics(glyphIdx);
+
+    bitmap.pixels.assign(
+        static_cast<std::size_t>(bitmap.metrics.size.w)
+            * bitmap.metrics.size.h,
+        0);
+    if (isEmpty(bitmap))
+        return;
+
+    Image image(
+        bitmap.pixels.data(),
+        bitmap.metrics.size.w,
+        bitmap.metrics.size.h,
+        bitmap.metrics.size.w);
+    renderer.renderGlyph(glyphIdx, image);
+}
+
+
+static bool metricsEqual(const GlyphMetrics& a, const GlyphMetrics& b)
+{
+    return (
+        a.size.w == b.size.w
+        && a.size.h == b.size.h
+        && a.offset.x == b.offset.x
+        && a.offset.y == b.offset.y
+        && a.advance == b.advance);
+}
+
+
+namespace {
+
+
+struct ErrorSum {
+    std::uint64_t sum;
+    std::uint64_t numPixels;
+};
+
+
+}
+
+
+static void compareBitmaps(
+    char32_t cp,
+    const GlyphBitmap& reference,
+    const GlyphBitmap& other,
+    RendererDiff& diff,
+    ErrorSum& errorSum)
+{
+    if (!metricsEqual(reference.metrics, other.metrics))
+        diff.metricsMismatches.push_back(
+            {cp, reference.metrics, other.metrics});
+
+    const auto bitmapDiff = compareGlyphBitmaps(reference, other);
+    errorSum.sum += bitmapDiff.errorSum;
+    errorSum.numPixels += bitmapDiff.numPixels;
+
+    if (bitmapDiff.maxError > 0)
+        ++diff.numDifferentGlyphs;
+    diff.maxError = std::max(diff.maxError, bitmapDiff.maxError);
+}
+
+
+RendererComparison compareRenderers(
+    const FontRendererArgs& args,
+    const cp_range::CpRangeList& cpRangeList,
+    const std::vector<const FontRendererCreator*>& creators)
+{
+    RendererComparison result;
+    if (creators.empty())
+        return result;
+
+    for (const auto* creator : creators)
+        result.timings.push_back(timeRenderer(*creator, args, cpRangeList));
+
+    std::unique_ptr<FontRenderer> reference(
+        createRenderer(*creators[0], args));
+
+    std::vector<std::unique_ptr<FontRenderer>> others;
+    for (std::size_t i = 1; i < creators.size(); ++i) {
+        others.emplace_back(createRenderer(*creators[i], args));
+        result.diffs.push_back({creators[i]->getName(), 0, {}, 0, 0, 0.0});
+    }
+
+    std::vector<ErrorSum> errorSums(others.size());
+
+    GlyphBitmap referenceBitmap;
+    GlyphBitmap otherBitmap;
+    for (const auto& cpRange : cpRangeList)
+        for (auto cp = cpRange.cpFirst; cp <= cpRange.cpLast; ++cp) {
+            const auto referenceHasGlyph = hasGlyph(*reference, cp);
+            if (referenceHasGlyph)
+                renderBitmap(*reference, cp, referenceBitmap);
+
+            for (std::size_t i = 0; i < others.size(); ++i) {
+                auto& diff = result.diffs[i];
+
+                if (hasGlyph(*others[i], cp) != referenceHasGlyph) {
+                    ++diff.numCpMismatches;
+                    continue;
+                }
+                if (!referenceHasGlyph)
+                    continue;
+
+                renderBitmap(*others[i], cp, otherBitmap);
+                compareBitmaps(
+                    cp, referenceBitmap, otherBitmap, diff, errorSums[i]);
+            }
+        }
+
+    for (std::size_t i = 0; i < others.size(); ++i)
+        if (errorSums[i].numPixels > 0)
+            result.diffs[i].meanError = (
+                static_cast<double>(errorSums[i].sum)
+                / errorSums[i].numPixels);
+
+    return result;
+}
+
+
+}
@@ -0,0 +1,118 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cp_range.h"
+#include "font_renderer/font_renderer.h"
+
+
+namespace dpfb {
+
+
+struct RendererTiming {
+    const char* rendererName;
+    std::size_t numGlyphs;
+    // Time of FontRendererCreator::create()
+    std::uint64_t initNs;
+    // Total time of FontRenderer::getGlyphMetrics()
+    std::uint64_t metricsNs;
+    // Total time of FontRenderer::renderGlyph()
+    std::uint64_t renderNs;
+
+    /**
+     * Return the number of glyphs per second of getting metrics and
+     * rendering, or 0 if the time is 0.
+     */
+    double getGlyphsPerSec() const;
+};
+
+
+struct GlyphMetricsMismatch {
+    char32_t cp;
+    GlyphMetrics reference;
+    GlyphMetrics other;
+};
+
+
+/**
+ * Glyph bitmap with rows of metrics.size.w pixels from top to bottom.
+ */
+struct GlyphBitmap {
+    GlyphMetrics metrics;
+    std::vector<std::uint8_t> pixels;
+};
+
+
+struct GlyphBitmapDiff {
+    // Maximum absolute difference of pixels.
+    int maxError;
+    // Sum of absolute differences of pixels.
+    std::uint64_t errorSum;
+    // Number of compared pixels.
+    std::uint64_t numPixels;
+};
+
+
+/**
+ * Compare glyph bitmaps.
+ *
+ * The bitmaps are placed at their offsets from the origin and
+ * compared in the union of their boxes; pixels outside a bitmap are
+ * 0. This way, a glyph shifted by a pixel is different, but a glyph
+ * with extra empty rows is not.
+ */
+GlyphBitmapDiff compareGlyphBitmaps(
+    const GlyphBitmap& bitmap1, const GlyphBitmap& bitmap2);
+
+
+/**
+ * Difference of a renderer from the reference renderer.
+ *
+ * Glyph bitmaps are compared with compareGlyphBitmaps().
+ */
+struct RendererDiff {
+    const char* rendererName;
+    // Number of code points that have a glyph in only one of the
+    // renderers. Such glyphs are not compared.
+    std::size_t numCpMismatches;
+    // Glyphs with a different size, offset, or advance, in the order
+    // of code points.
+    std::vector<GlyphMetricsMismatch> metricsMismatches;
+    // Number of glyphs with at least one different pixel.
+    std::size_t numDifferentGlyphs;
+    // Maximum absolute difference of pixels.
+    int maxError;
+    // Mean absolute difference of all compared pixels.
+    double meanError;
+};
+
+
+struct RendererComparison {
+    // The first timing is of the reference renderer.
+    std::vector<RendererTiming> timings;
+    // Differences of other renderers from the reference one, in the
+    // same order as in timings.
+    std::vector<RendererDiff> diffs;
+};
+
+
+/**
+ * Get metrics and render glyphs of the code points with every
+ * renderer. The first creator gives the reference renderer.
+ *
+ * As in Font, code points without a glyph are skipped, except 0.
+ * Timings are measured in a separate pass for each renderer, so
+ * renderers don't disturb caches of each other.
+ *
+ * \throws FontRendererError
+ */
+RendererComparison compareRenderers(
+    const FontRendererArgs& args,
+    const cp_range::CpRangeList& cpRangeList,
+    const std::vector<const FontRendererCreator*>& creators);
+
+
+}
@@ -11,7 +11,7 @@ namespace dpfb {
 
 const char* sfntTagToStr(std::uint32_t tag)
 {
-    static char buf[5];
+    thread_local char buf[5];
 
     for (int i = 0; i < 4; ++i)
         buf[i] = (tag >> ((3 - i) * 8)) & 0xff;
@@ -41,27 +41,39 @@ static bool checkOffsetTableSignature(std::uint32_t signature)
 using namespace streams;
 
 
+std::uint32_t getNumSfntFonts(SpanReader reader)
+{
+    reader.seek(0, SeekOrigin::set);
+    if (reader.readU32Be() != sfntTag('t', 't', 'c', 'f'))
+        return 1;
+
+    // Skip version
+    reader.seek(2 * sizeof(std::uint16_t), SeekOrigin::cur);
+    return reader.readU32Be();
+}
+
+
 SfntOffsetTable::SfntOffsetTable(
-        Stream& stream, std::uint32_t fontIdx)
+        SpanReader reader, std::uint32_t fontIdx)
     : tableRecords {}
 {
-    stream.seek(0, SeekOrigin::set);
+    reader.seek(0, SeekOrigin::set);
 
-    auto version = stream.readU32Be();
+    auto version = reader.readU32Be();
     if (version == sfntTag('t', 't', 'c', 'f')) {
-        const auto versionMajor = stream.readU16Be();
+        const auto versionMajor = reader.readU16Be();
         if (versionMajor != 1 && versionMajor != 2)
             throw StreamError(str::format(
                 "Invalid TTC header major version %" PRIu16,
                 versionMajor));
 
-        const auto versionMinor = stream.readU16Be();
+        const auto versionMinor = reader.readU16Be();
         if (versionMinor != 0)
             throw StreamError(str::format(
                 "Invalid TTC header minor version %" PRIu16,
                 versionMinor));
 
-        const auto numFonts = stream.readU32Be();
+        const auto numFonts = reader.readU32Be();
         if (numFonts == 0)
             throw StreamError("Collection has no fonts");
 
@@ -70,11 +82,11 @@ SfntOffsetTable::SfntOffsetTable(
                 "Collection contains only %" PRIu32 " fonts",
                 numFonts));
 
-        stream.seek(fontIdx * sizeof(std::uint32_t), SeekOrigin::cur);
-        const auto fontOffset = stream.readU32Be();
-        stream.seek(fontOffset, SeekOrigin::set);
+        reader.seek(fontIdx * sizeof(std::uint32_t), SeekOrigin::cur);
+        const auto fontOffset = reader.readU32Be();
+        reader.seek(fontOffset, SeekOrigin::set);
 
-        version = stream.readU32Be();
+        version = reader.readU32Be();
     } else if (fontIdx > 0)
         throw StreamError(str::format(
             "Can't load font at index %" PRIu32 " because font is "
@@ -86,27 +98,20 @@ SfntOffsetTable::SfntOffsetTable(
             "Unsupported font format 0x%08" PRIx32,
             version));
 
-    const auto numTables = stream.readU16Be();
+    const auto numTables = reader.readU16Be();
     if (numTables == 0)
         throw StreamError("Font has no tables");
 
     // Skip search range, entry selector, and range shift
-    stream.seek(3 * sizeof(std::uint16_t), SeekOrigin::cur);
+    reader.seek(3 * sizeof(std::uint16_t), SeekOrigin::cur);
 
-    tableRecords.reserve(numTables);
-    for (std::uint16_t i = 0; i < numTables; ++i) {
-        TableRecord tableRecord;
-        tableRecord.tag = stream.readU32Be();
-
-        // Skip checksum
-        stream.seek(sizeof(std::uint32_t), SeekOrigin::cur);
+    // Each record is tag, checksum, offset, and length.
+    std::vector<std::uint32_t> recordWords(numTables * 4);
+    reader.readU32BeArray(recordWords.data(), recordWords.size());
 
-        tableRecord.offset = stream.readU32Be();
-        tableRecords.push_back(tableRecord);
-
-        // Skip length
-        stream.seek(sizeof(std::uint32_t), SeekOrigin::cur);
-    }
+    tableRecords.reserve(numTables);
+    for (std::size_t i = 0; i < recordWords.size(); i += 4)
+        tableRecords.push_back({recordWords[i], recordWords[i + 2]});
 }
 
 
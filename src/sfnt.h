@@ -4,7 +4,7 @@
 #include <cstdint>
 #include <vector>
 
-#include "streams/stream.h"
+#include "streams/span_reader.h"
 
 
 namespace dpfb {
@@ -24,10 +24,23 @@ constexpr std::uint32_t sfntTag(char c1, char c2, char c3, char c4)
 const char* sfntTagToStr(std::uint32_t tag);
 
 
+/**
+ * Get the number of fonts in a collection (TTC or OTC).
+ *
+ * For a single font, returns 1.
+ *
+ * \throws streams::StreamError
+ */
+std::uint32_t getNumSfntFonts(streams::SpanReader reader);
+
+
 class SfntOffsetTable {
 public:
+    /**
+     * \throws streams::StreamError
+     */
     SfntOffsetTable(
-        streams::Stream& stream,
+        streams::SpanReader reader,
         std::uint32_t fontIdx);
 
     std::uint32_t getTableOffset(std::uint32_t tag) const;
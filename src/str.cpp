@@ -33,5 +33,25 @@ std::string format(const char* fmt, ...)
 }
 
 
+std::string escapeJsonStr(const std::string& s)
+{
+    std::string result;
+    result.reserve(s.size());
+
+    for (const auto c : s) {
+        const auto u = static_cast<unsigned char>(c);
+        if (u < 0x20)
+            result += format("\\u%04x", u);
+        else {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+    }
+
+    return result;
+}
+
+
 }
 }
@@ -14,5 +14,15 @@ std::string format(const char* fmt, ...)
     #endif
 
 
+/**
+ * Escape a string to put it between quotes in JSON.
+ *
+ * Quotes and backslashes are escaped with a backslash, and control
+ * characters with \uXXXX. Other bytes, including UTF-8 sequences,
+ * are kept as is.
+ */
+std::string escapeJsonStr(const std::string& s);
+
+
 }
 }
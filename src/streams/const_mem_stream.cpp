@@ -3,6 +3,8 @@
 
 #include <cstring>
 
+#include "streams/stream_stats.h"
+
 
 namespace dpfb {
 namespace streams {
@@ -47,6 +49,7 @@ std::size_t ConstMemStream::read(void* dst, std::size_t dstSize) noexcept
 
     std::memcpy(dst, data + pos, dstSize);
     pos += dstSize;
+    countRead(dstSize);
 
     return dstSize;
 }
@@ -74,6 +77,7 @@ void ConstMemStream::seek(std::int64_t offset, SeekOrigin origin)
     if (offset < 0)
         throw StreamError("Offset points before the beginning");
 
+    countSeek(pos, offset);
     pos = offset;
 }
 
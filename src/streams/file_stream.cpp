@@ -5,6 +5,8 @@
 #include <cerrno>
 #include <utility>
 
+#include "streams/stream_stats.h"
+
 
 namespace dpfb {
 namespace streams {
@@ -64,6 +66,7 @@ FileStream& FileStream::operator=(FileStream&& other)
 
 std::size_t FileStream::write(const void* src, std::size_t srcSize) noexcept
 {
+    countWrite(srcSize);
     return std::fwrite(src, 1, srcSize, fp);
 }
 
@@ -77,7 +80,9 @@ void FileStream::writeBuffer(const void* src, std::size_t srcSize)
 
 std::size_t FileStream::read(void* dst, std::size_t dstSize) noexcept
 {
-    return std::fread(dst, 1, dstSize, fp);
+    const auto numRead = std::fread(dst, 1, dstSize, fp);
+    countRead(numRead);
+    return numRead;
 }
 
 
@@ -95,8 +100,12 @@ std::int64_t FileStream::getSize() const
         throwErrno();
 
     const auto size = getPosition();
+    countSeek(pos, size);
+
     if (std::fseek(fp, pos, SEEK_SET) != 0)
         throwErrno();
+    countSeek(size, pos);
+
     return size;
 }
 
@@ -116,8 +125,16 @@ void FileStream::seek(std::int64_t offset, SeekOrigin origin)
             break;
     }
 
+    #if DPFB_STREAM_STATS
+    const auto oldPos = getPosition();
+    #endif
+
     if (std::fseek(fp, offset, whence) != 0)
         throwErrno();
+
+    #if DPFB_STREAM_STATS
+    countSeek(oldPos, getPosition());
+    #endif
 }
 
 
@@ -0,0 +1,94 @@
+
+#include "streams/span_reader.h"
+
+#include <cstring>
+
+#include "str.h"
+
+
+namespace dpfb {
+namespace streams {
+
+
+SpanReader::SpanReader(const void* data, std::size_t dataSize)
+    : data {static_cast<const std::uint8_t*>(data)}
+    , dataSize {dataSize}
+    , pos {0}
+{
+    if (!data)
+        throw StreamError("data is nullptr");
+}
+
+
+SpanReader SpanReader::getSubSpan(std::size_t offset) const
+{
+    if (offset > dataSize)
+        throw StreamError(str::format(
+            "Span offset (%zu) is beyond the end (%zu)",
+            offset, dataSize));
+
+    return {data + offset, dataSize - offset};
+}
+
+
+SpanReader SpanReader::getSubSpan(
+    std::size_t offset, std::size_t size) const
+{
+    if (offset > dataSize || dataSize - offset < size)
+        throw StreamError(str::format(
+            "Span of %zu bytes at %zu is out of %zu bytes",
+            size, offset, dataSize));
+
+    return {data + offset, size};
+}
+
+
+void SpanReader::seek(std::int64_t offset, SeekOrigin origin)
+{
+    switch (origin) {
+        case SeekOrigin::set:
+            break;
+        case SeekOrigin::cur:
+            offset += pos;
+            break;
+        case SeekOrigin::end:
+            offset += dataSize;
+            break;
+    }
+
+    if (offset < 0)
+        throw StreamError("Offset points before the beginning");
+
+    countSeek(pos, offset);
+    pos = offset;
+}
+
+
+void SpanReader::readBuffer(void* dst, std::size_t dstSize)
+{
+    std::memcpy(dst, advance(dstSize), dstSize);
+}
+
+
+void SpanReader::readU16BeArray(std::uint16_t* dst, std::size_t count)
+{
+    byteorder::copyFromBe(advance(count * sizeof(*dst)), dst, count);
+}
+
+
+void SpanReader::readU32BeArray(std::uint32_t* dst, std::size_t count)
+{
+    byteorder::copyFromBe(advance(count * sizeof(*dst)), dst, count);
+}
+
+
+void SpanReader::throwReadError(std::size_t numBytes) const
+{
+    throw StreamError(str::format(
+        "Can't read %zu bytes at %zu: EOF (size %zu)",
+        numBytes, pos, dataSize));
+}
+
+
+}
+}
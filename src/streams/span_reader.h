@@ -0,0 +1,162 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "streams/stream.h"
+#include "streams/stream_stats.h"
+
+
+namespace dpfb {
+namespace streams {
+
+
+/**
+ * Reader of big-endian data from memory.
+ *
+ * Unlike ConstMemStream, SpanReader is not a Stream: it has no
+ * virtual methods, and reads are inlined to a bounds check and a
+ * couple of loads. It's intended for parsing font tables, where
+ * millions of small values can be read.
+ *
+ * Like a stream, the reader can be positioned beyond the end of the
+ * data; only reads are checked. Copying a reader gives an independent
+ * cursor over the same data.
+ */
+class SpanReader {
+public:
+    /**
+     * \throws StreamError if data is nullptr
+     */
+    SpanReader(const void* data, std::size_t dataSize);
+
+    const std::uint8_t* getData() const;
+    std::size_t getSize() const;
+
+    /**
+     * Return a reader of the data starting at offset.
+     *
+     * This is useful to read a table with positions relative to the
+     * start of the table. The new reader is positioned at 0.
+     *
+     * \throws StreamError if offset is beyond the end of the data
+     */
+    SpanReader getSubSpan(std::size_t offset) const;
+
+    /**
+     * Return a reader of size bytes starting at offset.
+     *
+     * \throws StreamError if the span is out of the data
+     */
+    SpanReader getSubSpan(std::size_t offset, std::size_t size) const;
+
+    /**
+     * \throws StreamError if the new position is negative
+     */
+    void seek(std::int64_t offset, SeekOrigin origin);
+    std::size_t getPosition() const;
+
+    /**
+     * All read methods throw StreamError when reading past the end.
+     */
+    void readBuffer(void* dst, std::size_t dstSize);
+
+    std::uint8_t readU8();
+    std::int8_t readS8();
+
+    std::uint16_t readU16Be();
+    std::uint32_t readU32Be();
+
+    std::int16_t readS16Be();
+    std::int32_t readS32Be();
+
+    /**
+     * Read count big-endian values to dst.
+     */
+    void readU16BeArray(std::uint16_t* dst, std::size_t count);
+    void readU32BeArray(std::uint32_t* dst, std::size_t count);
+private:
+    const std::uint8_t* data;
+    std::size_t dataSize;
+    std::size_t pos;
+
+    const std::uint8_t* advance(std::size_t numBytes);
+    [[noreturn]] void throwReadError(std::size_t numBytes) const;
+};
+
+
+inline const std::uint8_t* SpanReader::getData() const
+{
+    return data;
+}
+
+
+inline std::size_t SpanReader::getSize() const
+{
+    return dataSize;
+}
+
+
+inline std::size_t SpanReader::getPosition() const
+{
+    return pos;
+}
+
+
+inline const std::uint8_t* SpanReader::advance(std::size_t numBytes)
+{
+    if (pos > dataSize || dataSize - pos < numBytes)
+        throwReadError(numBytes);
+
+    const auto* p = data + pos;
+    pos += numBytes;
+    countRead(numBytes);
+    return p;
+}
+
+
+inline std::uint8_t SpanReader::readU8()
+{
+    return *advance(1);
+}
+
+
+inline std::int8_t SpanReader::readS8()
+{
+    return static_cast<std::int8_t>(readU8());
+}
+
+
+inline std::uint16_t SpanReader::readU16Be()
+{
+    const auto* p = advance(2);
+    return (p[0] << 8) | p[1];
+}
+
+
+inline std::uint32_t SpanReader::readU32Be()
+{
+    const auto* p = advance(4);
+    return (
+        (static_cast<std::uint32_t>(p[0]) << 24)
+        | (static_cast<std::uint32_t>(p[1]) << 16)
+        | (static_cast<std::uint32_t>(p[2]) << 8)
+        | p[3]);
+}
+
+
+inline std::int16_t SpanReader::readS16Be()
+{
+    return static_cast<std::int16_t>(readU16Be());
+}
+
+
+inline std::int32_t SpanReader::readS32Be()
+{
+    return static_cast<std::int32_t>(readU32Be());
+}
+
+
+}
+}
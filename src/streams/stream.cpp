@@ -22,6 +22,20 @@ void Stream::readBuffer(void* data, std::size_t dataSize)
 }
 
 
+void Stream::readU16BeArray(std::uint16_t* dst, std::size_t count)
+{
+    readBuffer(dst, count * sizeof(*dst));
+    byteorder::copyFromBe(dst, dst, count);
+}
+
+
+void Stream::readU32BeArray(std::uint32_t* dst, std::size_t count)
+{
+    readBuffer(dst, count * sizeof(*dst));
+    byteorder::copyFromBe(dst, dst, count);
+}
+
+
 std::size_t Stream::writeStr(const char* str) noexcept
 {
     return write(str, std::strlen(str));
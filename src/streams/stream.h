@@ -140,6 +140,14 @@ public:
     std::int16_t readS16Be();
     std::int32_t readS32Be();
 
+    /**
+     * Read count big-endian values to dst.
+     *
+     * \throws StreamError
+     */
+    void readU16BeArray(std::uint16_t* dst, std::size_t count);
+    void readU32BeArray(std::uint32_t* dst, std::size_t count);
+
     void writeU8(std::uint8_t value);
     void writeS8(std::int8_t value);
 
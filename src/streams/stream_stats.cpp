@@ -0,0 +1,46 @@
+
+#include "streams/stream_stats.h"
+
+
+namespace dpfb {
+namespace streams {
+
+
+namespace detail {
+thread_local StreamStats* currentStreamStats;
+}
+
+
+StreamStats& StreamStats::operator+=(const StreamStats& other)
+{
+    numReads += other.numReads;
+    bytesRead += other.bytesRead;
+    numSeeks += other.numSeeks;
+    seekDistance += other.seekDistance;
+    numWrites += other.numWrites;
+    bytesWritten += other.bytesWritten;
+    return *this;
+}
+
+
+StreamStatsScope::StreamStatsScope(StreamStats* stats)
+    : prevStats {detail::currentStreamStats}
+{
+    detail::currentStreamStats = stats;
+}
+
+
+StreamStatsScope::~StreamStatsScope()
+{
+    detail::currentStreamStats = prevStats;
+}
+
+
+StreamStats* getCurrentStreamStats()
+{
+    return detail::currentStreamStats;
+}
+
+
+}
+}
@@ -0,0 +1,122 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+// Stream I/O counting is off by default, so the counting calls in the
+// streams compile to nothing.
+#ifndef DPFB_STREAM_STATS
+    #define DPFB_STREAM_STATS 0
+#endif
+
+
+namespace dpfb {
+namespace streams {
+
+
+/**
+ * Stream I/O counters.
+ *
+ * Streams and span readers add to the stats set for the current
+ * thread with StreamStatsScope. Counting is compiled in only if
+ * DPFB_STREAM_STATS is nonzero; otherwise, the stats stay zero.
+ */
+struct StreamStats {
+    std::uint64_t numReads;
+    std::uint64_t bytesRead;
+    std::uint64_t numSeeks;
+    // Sum of absolute differences between positions before and
+    // after seeks.
+    std::uint64_t seekDistance;
+    std::uint64_t numWrites;
+    std::uint64_t bytesWritten;
+
+    StreamStats& operator+=(const StreamStats& other);
+};
+
+
+/**
+ * Return true if counting was compiled in.
+ */
+constexpr bool areStreamStatsEnabled()
+{
+    return DPFB_STREAM_STATS != 0;
+}
+
+
+/**
+ * Set the stats that the current thread adds to.
+ *
+ * The previous stats are restored on destruction, so scopes can be
+ * nested. nullptr disables counting till the end of the scope.
+ * Worker threads don't inherit the stats; they should use their own
+ * scopes.
+ */
+class StreamStatsScope {
+public:
+    explicit StreamStatsScope(StreamStats* stats);
+    ~StreamStatsScope();
+
+    StreamStatsScope(const StreamStatsScope& other) = delete;
+    StreamStatsScope& operator=(const StreamStatsScope& other) = delete;
+private:
+    StreamStats* prevStats;
+};
+
+
+/**
+ * Return the stats of the current thread, or nullptr.
+ */
+StreamStats* getCurrentStreamStats();
+
+
+namespace detail {
+extern thread_local StreamStats* currentStreamStats;
+}
+
+
+inline void countRead(std::size_t numBytes)
+{
+    #if DPFB_STREAM_STATS
+    if (auto* stats = detail::currentStreamStats) {
+        ++stats->numReads;
+        stats->bytesRead += numBytes;
+    }
+    #else
+    (void)numBytes;
+    #endif
+}
+
+
+inline void countSeek(std::int64_t oldPos, std::int64_t newPos)
+{
+    #if DPFB_STREAM_STATS
+    if (auto* stats = detail::currentStreamStats) {
+        ++stats->numSeeks;
+        stats->seekDistance += (
+            newPos < oldPos ? oldPos - newPos : newPos - oldPos);
+    }
+    #else
+    (void)oldPos;
+    (void)newPos;
+    #endif
+}
+
+
+inline void countWrite(std::size_t numBytes)
+{
+    #if DPFB_STREAM_STATS
+    if (auto* stats = detail::currentStreamStats) {
+        ++stats->numWrites;
+        stats->bytesWritten += numBytes;
+    }
+    #else
+    (void)numBytes;
+    #endif
+}
+
+
+}
+}
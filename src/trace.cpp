@@ -0,0 +1,185 @@
+
+#include "trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <mutex>
+#include <vector>
+
+#include "str.h"
+
+
+namespace dpfb {
+namespace trace {
+
+
+using Clock = std::chrono::steady_clock;
+
+
+struct Event {
+    const char* name;
+    const char* category;
+    std::uint32_t threadId;
+    std::uint64_t startNs;
+    std::uint64_t durationNs;
+    std::string args;
+};
+
+
+static std::atomic<bool> enabled {false};
+static Clock::time_point startTime;
+
+static std::mutex eventsMutex;
+static std::vector<Event> events;
+static std::uint32_t numThreads;
+
+// Incremented by start(), so that thread ids are assigned anew.
+static std::uint32_t generation;
+static thread_local std::uint32_t threadId;
+static thread_local std::uint32_t threadIdGeneration;
+
+
+// eventsMutex must be locked.
+static std::uint32_t getThreadId()
+{
+    if (threadIdGeneration != generation) {
+        threadId = ++numThreads;
+        threadIdGeneration = generation;
+    }
+
+    return threadId;
+}
+
+
+static std::uint64_t getNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - startTime).count();
+}
+
+
+void start()
+{
+    std::lock_guard<std::mutex> lock(eventsMutex);
+
+    events.clear();
+    numThreads = 0;
+    ++generation;
+    getThreadId();
+
+    startTime = Clock::now();
+    enabled = true;
+}
+
+
+void stop()
+{
+    enabled = false;
+}
+
+
+bool isEnabled()
+{
+    return enabled;
+}
+
+
+void write(streams::Stream& stream)
+{
+    std::lock_guard<std::mutex> lock(eventsMutex);
+
+    stream.writeStr(
+        "{\n"
+        "  \"displayTimeUnit\": \"ms\",\n"
+        "  \"traceEvents\": [\n");
+
+    std::vector<std::string> entries;
+
+    for (std::uint32_t i = 1; i <= numThreads; ++i) {
+        const auto threadName = (
+            i == 1 ? std::string("main") : "thread " + std::to_string(i));
+        entries.push_back(str::format(
+            "{\"name\": \"thread_name\", \"ph\": \"M\", "
+            "\"pid\": 1, \"tid\": %" PRIu32 ", "
+            "\"args\": {\"name\": \"%s\"}}",
+            i, threadName.c_str()));
+    }
+
+    for (const auto& event : events)
+        // Timestamps are in microseconds.
+        entries.push_back(str::format(
+            "{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", "
+            "\"pid\": 1, \"tid\": %" PRIu32 ", "
+            "\"ts\": %.3f, \"dur\": %.3f, \"args\": {%s}}",
+            str::escapeJsonStr(event.name).c_str(),
+            str::escapeJsonStr(event.category).c_str(),
+            event.threadId,
+            event.startNs / 1000.0,
+            event.durationNs / 1000.0,
+            event.args.c_str()));
+
+    for (std::size_t i = 0; i < entries.size(); ++i)
+        stream.writeStr(str::format(
+            "    %s%s\n",
+            entries[i].c_str(),
+            i + 1 != entries.size() ? "," : ""));
+
+    stream.writeStr(
+        "  ]\n"
+        "}\n");
+}
+
+
+Span::Span(const char* name, const char* category)
+    : name {}
+    , category {category}
+    , startNs {}
+    , args {}
+{
+    if (!enabled)
+        return;
+
+    this->name = name;
+    startNs = getNowNs();
+}
+
+
+Span::~Span()
+{
+    if (!name || !enabled)
+        return;
+
+    const auto endNs = getNowNs();
+
+    std::lock_guard<std::mutex> lock(eventsMutex);
+    events.push_back(
+        {name, category, getThreadId(), startNs, endNs - startNs, args});
+}
+
+
+void Span::addArg(const char* key, std::int64_t value)
+{
+    if (!name)
+        return;
+
+    if (!args.empty())
+        args += ", ";
+    args += str::format("\"%s\": %" PRId64, key, value);
+}
+
+
+void Span::addArg(const char* key, const std::string& value)
+{
+    if (!name)
+        return;
+
+    if (!args.empty())
+        args += ", ";
+    args += str::format(
+        "\"%s\": \"%s\"", key, str::escapeJsonStr(value).c_str());
+}
+
+
+}
+}
@@ -0,0 +1,70 @@
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "streams/stream.h"
+
+
+namespace dpfb {
+namespace trace {
+
+
+/**
+ * Start recording spans, discarding ones recorded before.
+ *
+ * Tracing is off by default, and spans cost a single check then.
+ * Timestamps are relative to the start() call.
+ */
+void start();
+
+/**
+ * Stop recording spans. Recorded spans are kept for write().
+ */
+void stop();
+
+bool isEnabled();
+
+/**
+ * Write recorded spans in the Trace Event Format.
+ *
+ * The JSON can be loaded in chrome://tracing or Perfetto. Threads are
+ * numbered in the order they recorded their first span; the thread
+ * that called start() is number 1.
+ *
+ * \throws streams::StreamError
+ */
+void write(streams::Stream& stream);
+
+
+/**
+ * A span of time recorded from construction to destruction.
+ *
+ * name and category must be string literals or otherwise outlive
+ * the trace.
+ */
+class Span {
+public:
+    Span(const char* name, const char* category);
+    ~Span();
+
+    Span(const Span& other) = delete;
+    Span& operator=(const Span& other) = delete;
+
+    /**
+     * Add an argument to show with the span.
+     */
+    void addArg(const char* key, std::int64_t value);
+    void addArg(const char* key, const std::string& value);
+private:
+    const char* name;
+    const char* category;
+    std::uint64_t startNs;
+    // Comma-separated JSON members
+    std::string args;
+};
+
+
+}
+}
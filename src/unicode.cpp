@@ -56,7 +56,7 @@ const char* cpToStr(char32_t cp)
 {
     // char32_t is an alias to uint_least32_t and therefore may
     // have more than 32 bits.
-    static char buf[2 + sizeof(char32_t) * 2 + 1];
+    thread_local char buf[2 + sizeof(char32_t) * 2 + 1];
     std::snprintf(buf, sizeof(buf), "U+%04" PRIXLEAST32, cp);
     return buf;
 }
@@ -207,6 +207,61 @@ std::string utf16ToUtf8(const char16_t* begin, const char16_t* end)
 }
 
 
+char32_t decodeUtf8(const char*& str, const char* end)
+{
+    const auto* s = reinterpret_cast<const unsigned char*>(str);
+    const auto* e = reinterpret_cast<const unsigned char*>(end);
+
+    const auto c = *s;
+    if (c < 0x80) {
+        ++str;
+        return c;
+    }
+
+    int numTrailing;
+    char32_t cp;
+    char32_t minCp;
+    if ((c & 0xe0) == 0xc0) {
+        numTrailing = 1;
+        cp = c & 0x1f;
+        minCp = 0x80;
+    } else if ((c & 0xf0) == 0xe0) {
+        numTrailing = 2;
+        cp = c & 0x0f;
+        minCp = 0x800;
+    } else if ((c & 0xf8) == 0xf0) {
+        numTrailing = 3;
+        cp = c & 0x07;
+        minCp = 0x10000;
+    } else {
+        ++str;
+        return replacementCharacter;
+    }
+
+    if (e - s <= numTrailing) {
+        ++str;
+        return replacementCharacter;
+    }
+
+    for (int i = 1; i <= numTrailing; ++i) {
+        if ((s[i] & 0xc0) != 0x80) {
+            ++str;
+            return replacementCharacter;
+        }
+
+        cp = (cp << 6) | (s[i] & 0x3f);
+    }
+
+    if (cp < minCp || !isValidCp(cp)) {
+        ++str;
+        return replacementCharacter;
+    }
+
+    str += 1 + numTrailing;
+    return cp;
+}
+
+
 int encodeUtf16(char32_t cp, char16_t out[2])
 {
     if (cp < 0x10000) {
@@ -43,6 +43,17 @@ char32_t strToCp(const char* str, const char** end = nullptr);
 std::string utf16ToUtf8(const char16_t* begin, const char16_t* end);
 
 
+/**
+ * Decode a code point from UTF-8.
+ *
+ * str must be less than end. On return, str points past the decoded
+ * sequence. Invalid sequences (including overlong forms, surrogates,
+ * and truncated sequences) are decoded as the replacement character
+ * (U+FFFD), consuming one byte.
+ */
+char32_t decodeUtf8(const char*& str, const char* end);
+
+
 /**
  * Encode code point as UTF-16.
  *
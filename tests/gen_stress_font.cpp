@@ -0,0 +1,153 @@
+
+// Writes a synthetic TrueType font for scale testing; see
+// stress_font.h.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "str.h"
+#include "streams/file_stream.h"
+#include "stress_font.h"
+
+
+using namespace dpfb;
+
+
+const char* const help = (
+    "Usage: %s [options] OUTPUT\n"
+    "\n"
+    "Write a synthetic TrueType font with simple outlines, a cmap\n"
+    "format 12, and class-based GPOS kerning.\n"
+    "\n"
+    "Options:\n"
+    "  -glyphs N\n"
+    "           Number of glyphs, including .notdef (2-65535).\n"
+    "           Default is %u.\n"
+    "  -first-cp CP\n"
+    "           Code point of glyph 1. Default is %#x.\n"
+    "  -cmap-group-size N\n"
+    "           Glyphs per cmap group; 0 for a single group.\n"
+    "           Default is %u.\n"
+    "  -lookups N\n"
+    "           Number of GPOS lookups. Default is %u.\n"
+    "  -classes1 N, -classes2 N\n"
+    "           Number of first and second glyph classes.\n"
+    "           Defaults are %u and %u.\n"
+    "  -class-ranges N\n"
+    "           Glyph ranges per class definition table.\n"
+    "           Default is %u.\n"
+    "  -print-cps\n"
+    "           Print the code point range of the font, suitable for\n"
+    "           dpfb's -code-points, and exit.\n"
+);
+
+
+static void printHelp(const char* progName)
+{
+    const StressFontParams defaults;
+    std::printf(
+        help,
+        progName,
+        static_cast<unsigned>(defaults.numGlyphs),
+        static_cast<unsigned>(defaults.firstCp),
+        static_cast<unsigned>(defaults.cmapGroupSize),
+        static_cast<unsigned>(defaults.numLookups),
+        static_cast<unsigned>(defaults.numClasses1),
+        static_cast<unsigned>(defaults.numClasses2),
+        static_cast<unsigned>(defaults.numClassRanges));
+}
+
+
+static void exitWithError(const char* msg)
+{
+    std::fprintf(stderr, "%s\n", msg);
+    std::exit(EXIT_FAILURE);
+}
+
+
+static unsigned long parseUInt(
+    const char* opt, const char* value, unsigned long max)
+{
+    char* end;
+    const auto result = std::strtoul(value, &end, 0);
+    if (end == value || *end || result > max)
+        exitWithError(str::format(
+            "%s expects an integer in range [0, %lu]", opt, max).c_str());
+
+    return result;
+}
+
+
+int main(int argc, char* argv[])
+{
+    StressFontParams params;
+    const char* outPath = nullptr;
+    bool printCps = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* opt = argv[i];
+
+        if (std::strcmp(opt, "-help") == 0) {
+            printHelp(argv[0]);
+            return EXIT_SUCCESS;
+        } else if (std::strcmp(opt, "-print-cps") == 0) {
+            printCps = true;
+            continue;
+        } else if (opt[0] != '-') {
+            outPath = opt;
+            continue;
+        }
+
+        if (i + 1 == argc)
+            exitWithError(str::format("%s expects an argument", opt).c_str());
+        const char* value = argv[++i];
+
+        if (std::strcmp(opt, "-glyphs") == 0)
+            params.numGlyphs = parseUInt(opt, value, 0xffff);
+        else if (std::strcmp(opt, "-first-cp") == 0)
+            params.firstCp = parseUInt(opt, value, 0x10ffff);
+        else if (std::strcmp(opt, "-cmap-group-size") == 0)
+            params.cmapGroupSize = parseUInt(opt, value, 0xffffffff);
+        else if (std::strcmp(opt, "-lookups") == 0)
+            params.numLookups = parseUInt(opt, value, 0xffff);
+        else if (std::strcmp(opt, "-classes1") == 0)
+            params.numClasses1 = parseUInt(opt, value, 0xffff);
+        else if (std::strcmp(opt, "-classes2") == 0)
+            params.numClasses2 = parseUInt(opt, value, 0xffff);
+        else if (std::strcmp(opt, "-class-ranges") == 0)
+            params.numClassRanges = parseUInt(opt, value, 0xffff);
+        else
+            exitWithError(str::format("Unknown option %s", opt).c_str());
+    }
+
+    try {
+        if (printCps) {
+            const auto cps = getStressFontCps(params);
+            if (cps.empty())
+                throw std::runtime_error(
+                    "Stress font needs at least 2 glyphs");
+
+            std::printf(
+                "%u-%u\n",
+                static_cast<unsigned>(cps.front()),
+                static_cast<unsigned>(cps.back()));
+            return EXIT_SUCCESS;
+        }
+
+        if (!outPath)
+            exitWithError("No output file");
+
+        const auto fontData = generateStressFont(params);
+        streams::FileStream f(outPath, "wb");
+        f.writeBuffer(fontData.data(), fontData.size());
+    } catch (std::runtime_error& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+
+#include "microbench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "str.h"
+
+
+namespace dpfb {
+namespace microbench {
+
+
+using Clock = std::chrono::steady_clock;
+
+
+// Results of bodies are written here so that they are not optimized
+// away.
+static volatile std::uint64_t sink;
+
+
+Options::Options()
+    : warmupTime(std::chrono::milliseconds(100))
+    , minSampleTime(std::chrono::milliseconds(10))
+    , numSamples(20)
+{
+
+}
+
+
+Statistics computeStatistics(std::vector<double> values)
+{
+    Statistics result {};
+    if (values.empty())
+        return result;
+
+    std::sort(values.begin(), values.end());
+
+    const auto n = values.size();
+    result.min = values[0];
+    if (n % 2 == 1)
+        result.median = values[n / 2];
+    else
+        result.median = (values[n / 2 - 1] + values[n / 2]) / 2.0;
+
+    double sum = 0.0;
+    for (const auto value : values)
+        sum += value;
+    result.mean = sum / n;
+
+    if (n > 1) {
+        double sqDiffSum = 0.0;
+        for (const auto value : values) {
+            const auto diff = value - result.mean;
+            sqDiffSum += diff * diff;
+        }
+        result.stdDev = std::sqrt(sqDiffSum / (n - 1));
+    }
+
+    return result;
+}
+
+
+static Clock::duration timeBody(const Body& body, std::size_t numIters)
+{
+    const auto start = Clock::now();
+    sink = body(numIters);
+    return Clock::now() - start;
+}
+
+
+Result run(const Body& body, const Options& options)
+{
+    // Calibration is a part of warmup: we double the number of
+    // iterations till a sample is long enough, and then keep running
+    // the body till the warmup time is over.
+    std::size_t numIters = 1;
+    const auto warmupEnd = Clock::now() + options.warmupTime;
+    while (true) {
+        const auto time = timeBody(body, numIters);
+        if (time < options.minSampleTime)
+            numIters *= 2;
+        else if (Clock::now() >= warmupEnd)
+            break;
+    }
+
+    std::vector<double> samples;
+    samples.reserve(options.numSamples);
+    for (std::size_t i = 0; i < options.numSamples; ++i) {
+        const auto time = timeBody(body, numIters);
+        samples.push_back(
+            std::chrono::duration<double, std::nano>(time).count()
+            / numIters);
+    }
+
+    Result result;
+    result.itersPerSample = numIters;
+    result.numSamples = options.numSamples;
+    result.ns = computeStatistics(std::move(samples));
+    return result;
+}
+
+
+std::string formatResult(const char* name, const Result& result)
+{
+    const auto& ns = result.ns;
+    return str::format(
+        "%-44s %12.1f ns (min %.1f, mean %.1f, stddev %.1f%%; "
+        "%zu x %zu iters)",
+        name,
+        ns.median,
+        ns.min,
+        ns.mean,
+        ns.mean > 0.0 ? ns.stdDev / ns.mean * 100.0 : 0.0,
+        result.numSamples,
+        result.itersPerSample);
+}
+
+
+}
+}
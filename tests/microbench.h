@@ -0,0 +1,77 @@
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+namespace dpfb {
+namespace microbench {
+
+
+/**
+ * Function to benchmark.
+ *
+ * The function should run the measured operation numIters times and
+ * return a value that depends on the results of all iterations, so
+ * that the compiler can't optimize the work away.
+ */
+using Body = std::function<std::uint64_t(std::size_t numIters)>;
+
+
+struct Options {
+    // Time to run the body before taking samples.
+    std::chrono::nanoseconds warmupTime;
+    // Minimal duration of a sample; the number of iterations per
+    // sample is calibrated to reach it, so that the timer resolution
+    // and the overhead of calling the body don't matter.
+    std::chrono::nanoseconds minSampleTime;
+    std::size_t numSamples;
+
+    Options();
+};
+
+
+struct Statistics {
+    double min;
+    double median;
+    double mean;
+    // Sample standard deviation; 0 if there are less than 2 values.
+    double stdDev;
+};
+
+
+/**
+ * Compute statistics of the given values.
+ *
+ * All fields are 0 if values are empty.
+ */
+Statistics computeStatistics(std::vector<double> values);
+
+
+struct Result {
+    std::size_t itersPerSample;
+    std::size_t numSamples;
+    // Time of a single iteration.
+    Statistics ns;
+};
+
+
+/**
+ * Warm up, calibrate the number of iterations, and measure the body.
+ */
+Result run(const Body& body, const Options& options = Options());
+
+
+/**
+ * Format the result as a single line, without a line break.
+ */
+std::string formatResult(const char* name, const Result& result);
+
+
+}
+}
@@ -0,0 +1,737 @@
+
+#include "stress_font.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstddef>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+#include "sfnt.h"
+#include "str.h"
+
+
+namespace dpfb {
+
+
+StressFontParams::StressFontParams()
+    : numGlyphs(1000)
+    , firstCp(0x20)
+    , cmapGroupSize(256)
+    , numLookups(4)
+    , numClasses1(64)
+    , numClasses2(64)
+    , numClassRanges(500)
+{
+
+}
+
+
+namespace {
+
+
+// Big-endian writer of table data.
+class Buffer {
+public:
+    std::vector<std::uint8_t> data;
+
+    std::size_t getSize() const
+    {
+        return data.size();
+    }
+
+    void u8(std::uint8_t v)
+    {
+        data.push_back(v);
+    }
+
+    void u16(std::uint16_t v)
+    {
+        data.push_back(v >> 8);
+        data.push_back(v & 0xff);
+    }
+
+    void s16(int v)
+    {
+        u16(static_cast<std::uint16_t>(v));
+    }
+
+    void u32(std::uint32_t v)
+    {
+        u16(v >> 16);
+        u16(v & 0xffff);
+    }
+
+    void setU16(std::size_t pos, std::uint16_t v)
+    {
+        data[pos] = v >> 8;
+        data[pos + 1] = v & 0xff;
+    }
+
+    void setU32(std::size_t pos, std::uint32_t v)
+    {
+        setU16(pos, v >> 16);
+        setU16(pos + 2, v & 0xffff);
+    }
+
+    void align(std::size_t alignment)
+    {
+        while (data.size() % alignment != 0)
+            data.push_back(0);
+    }
+};
+
+
+struct GlyphShape {
+    int x;
+    int y;
+    int w;
+    int h;
+
+    int getXMax() const
+    {
+        return x + w;
+    }
+
+    int getYMax() const
+    {
+        // The top of the outer contour is a quadratic curve.
+        return y + h + 80;
+    }
+
+    int getAdvance() const
+    {
+        return getXMax() + 50;
+    }
+};
+
+
+}
+
+
+const int unitsPerEm = 1000;
+const int ascender = 900;
+const int descender = -250;
+
+
+static GlyphShape getGlyphShape(std::uint32_t glyphIdx)
+{
+    GlyphShape result;
+    result.x = 50;
+    result.y = -static_cast<int>(glyphIdx % 4) * 50;
+    result.w = 200 + glyphIdx * 37 % 500;
+    result.h = 300 + glyphIdx * 53 % 500;
+    return result;
+}
+
+
+// A rectangle with a curved top and a rectangular hole.
+static void writeGlyph(Buffer& glyf, const GlyphShape& shape)
+{
+    const int x = shape.x;
+    const int y = shape.y;
+    const int w = shape.w;
+    const int h = shape.h;
+
+    struct Point {
+        int x;
+        int y;
+        bool onCurve;
+    };
+    const Point points[] = {
+        // Outer contour, clockwise
+        {x, y, true},
+        {x, y + h, true},
+        {x + w / 2, shape.getYMax(), false},
+        {x + w, y + h, true},
+        {x + w, y, true},
+        // Hole, counterclockwise
+        {x + 60, y + 60, true},
+        {x + w - 60, y + 60, true},
+        {x + w - 60, y + h - 60, true},
+        {x + 60, y + h - 60, true},
+    };
+
+    glyf.s16(2);
+    glyf.s16(x);
+    glyf.s16(y);
+    glyf.s16(shape.getXMax());
+    glyf.s16(shape.getYMax());
+    glyf.u16(4);
+    glyf.u16(8);
+    // instructionLength
+    glyf.u16(0);
+
+    for (const auto& point : points)
+        glyf.u8(point.onCurve ? 1 : 0);
+
+    int prevX = 0;
+    for (const auto& point : points) {
+        glyf.s16(point.x - prevX);
+        prevX = point.x;
+    }
+
+    int prevY = 0;
+    for (const auto& point : points) {
+        glyf.s16(point.y - prevY);
+        prevY = point.y;
+    }
+}
+
+
+static const std::uint32_t maxGlyphPoints = 9;
+static const std::uint32_t maxGlyphContours = 2;
+
+
+std::vector<char32_t> getStressFontCps(const StressFontParams& params)
+{
+    std::vector<char32_t> result;
+    if (params.numGlyphs < 2)
+        return result;
+
+    result.reserve(params.numGlyphs - 1);
+
+    auto cp = params.firstCp;
+    std::uint32_t numCpsInGroup = 0;
+    for (std::uint32_t i = 1; i < params.numGlyphs; ++i) {
+        if (cp >= 0xd800 && cp <= 0xdfff)
+            cp = 0xe000;
+        if (cp > 0x10ffff)
+            throw std::runtime_error(
+                "Code points of the stress font exceed U+10FFFF");
+
+        result.push_back(cp);
+        ++cp;
+
+        if (params.cmapGroupSize > 0
+                && ++numCpsInGroup == params.cmapGroupSize) {
+            numCpsInGroup = 0;
+            ++cp;
+        }
+    }
+
+    return result;
+}
+
+
+// https://docs.microsoft.com/en-us/typography/opentype/spec/cmap
+static Buffer createCmap(const std::vector<char32_t>& cps)
+{
+    struct Group {
+        char32_t firstCp;
+        char32_t lastCp;
+        std::uint32_t firstGlyphIdx;
+    };
+    std::vector<Group> groups;
+    for (std::size_t i = 0; i < cps.size(); ++i) {
+        const auto cp = cps[i];
+        if (!groups.empty() && groups.back().lastCp + 1 == cp)
+            groups.back().lastCp = cp;
+        else
+            groups.push_back(
+                {cp, cp, static_cast<std::uint32_t>(i + 1)});
+    }
+
+    Buffer cmap;
+    // version
+    cmap.u16(0);
+    // numTables
+    cmap.u16(1);
+    // Windows, Unicode full repertoire
+    cmap.u16(3);
+    cmap.u16(10);
+    cmap.u32(12);
+
+    cmap.u16(12);
+    // reserved
+    cmap.u16(0);
+    cmap.u32(16 + groups.size() * 12);
+    // language
+    cmap.u32(0);
+    cmap.u32(groups.size());
+    for (const auto& group : groups) {
+        cmap.u32(group.firstCp);
+        cmap.u32(group.lastCp);
+        cmap.u32(group.firstGlyphIdx);
+    }
+
+    return cmap;
+}
+
+
+// https://docs.microsoft.com/en-us/typography/opentype/spec/name
+static Buffer createName()
+{
+    struct Record {
+        std::uint16_t nameId;
+        const char* str;
+    };
+    static const Record records[] = {
+        {1, "dpfb stress"},
+        {2, "Regular"},
+        {4, "dpfb stress Regular"},
+        {6, "dpfbStress-Regular"},
+    };
+    const std::uint16_t numRecords = sizeof(records) / sizeof(*records);
+
+    Buffer name;
+    // format
+    name.u16(0);
+    name.u16(numRecords);
+    // storageOffset
+    name.u16(6 + numRecords * 12);
+
+    Buffer storage;
+    for (const auto& record : records) {
+        // Windows, Unicode BMP, English (US)
+        name.u16(3);
+        name.u16(1);
+        name.u16(0x0409);
+        name.u16(record.nameId);
+
+        const auto strPos = storage.getSize();
+        for (const auto* s = record.str; *s; ++s)
+            storage.u16(*s);
+
+        name.u16(storage.getSize() - strPos);
+        name.u16(strPos);
+    }
+
+    name.data.insert(
+        name.data.end(), storage.data.begin(), storage.data.end());
+    return name;
+}
+
+
+// Amounts are big enough not to round to 0 at small pixel sizes.
+static int getKerningAmount(
+    std::uint32_t lookupIdx, std::uint32_t class1, std::uint32_t class2)
+{
+    return (static_cast<int>(
+        (class1 * 7 + class2 * 13 + lookupIdx * 5) % 21) - 10) * 20;
+}
+
+
+// Class definition table format 2 with numRanges ranges covering
+// all glyphs except .notdef.
+static void writeClassDef(
+    Buffer& buf,
+    std::uint32_t numGlyphs,
+    std::uint32_t numRanges,
+    std::uint32_t numClasses,
+    std::uint32_t classMul,
+    std::uint32_t lookupIdx)
+{
+    const auto rangeSize = (numGlyphs - 1 + numRanges - 1) / numRanges;
+    const auto actualNumRanges = (numGlyphs - 1 + rangeSize - 1) / rangeSize;
+
+    buf.u16(2);
+    buf.u16(actualNumRanges);
+    for (std::uint32_t i = 0; i < actualNumRanges; ++i) {
+        const auto first = 1 + i * rangeSize;
+        const auto last = std::min(first + rangeSize - 1, numGlyphs - 1);
+        buf.u16(first);
+        buf.u16(last);
+        buf.u16((i * classMul + lookupIdx) % numClasses);
+    }
+}
+
+
+static void setOffset16(
+    Buffer& buf,
+    std::size_t offsetPos,
+    std::size_t tableStart,
+    std::size_t targetPos)
+{
+    const auto offset = targetPos - tableStart;
+    if (offset > 0xffff)
+        throw std::runtime_error(
+            "Pair adjustment subtable doesn't fit in 16-bit offsets; "
+            "reduce the number of classes or class ranges");
+
+    buf.setU16(offsetPos, offset);
+}
+
+
+// https://docs.microsoft.com/en-us/typography/opentype/spec/gpos
+static void writePairPosFormat2(
+    Buffer& gpos,
+    const StressFontParams& params,
+    std::uint32_t lookupIdx)
+{
+    const auto start = gpos.getSize();
+
+    gpos.u16(2);
+    const auto coverageOffsetPos = gpos.getSize();
+    gpos.u16(0);
+    // valueFormat1: X_ADVANCE
+    gpos.u16(0x0004);
+    // valueFormat2
+    gpos.u16(0);
+    const auto classDef1OffsetPos = gpos.getSize();
+    gpos.u16(0);
+    const auto classDef2OffsetPos = gpos.getSize();
+    gpos.u16(0);
+    gpos.u16(params.numClasses1);
+    gpos.u16(params.numClasses2);
+
+    for (std::uint32_t c1 = 0; c1 < params.numClasses1; ++c1)
+        for (std::uint32_t c2 = 0; c2 < params.numClasses2; ++c2)
+            gpos.s16(getKerningAmount(lookupIdx, c1, c2));
+
+    setOffset16(gpos, coverageOffsetPos, start, gpos.getSize());
+    // Format 2 with a single range of all glyphs except .notdef.
+    gpos.u16(2);
+    gpos.u16(1);
+    gpos.u16(1);
+    gpos.u16(params.numGlyphs - 1);
+    gpos.u16(0);
+
+    setOffset16(gpos, classDef1OffsetPos, start, gpos.getSize());
+    writeClassDef(
+        gpos,
+        params.numGlyphs,
+        params.numClassRanges,
+        params.numClasses1,
+        1,
+        lookupIdx);
+
+    setOffset16(gpos, classDef2OffsetPos, start, gpos.getSize());
+    writeClassDef(
+        gpos,
+        params.numGlyphs,
+        params.numClassRanges,
+        params.numClasses2,
+        7,
+        lookupIdx);
+}
+
+
+static Buffer createGpos(const StressFontParams& params)
+{
+    const std::uint32_t numLookups = params.numLookups;
+
+    // Lookup and extension subtables take 16 bytes per lookup.
+    if (2 + numLookups * 18 > 0xffff)
+        throw std::runtime_error(str::format(
+            "Too many lookups (%" PRIu32 ")", numLookups));
+
+    Buffer gpos;
+    // version 1.0
+    gpos.u32(0x00010000);
+    // scriptListOffset, featureListOffset, lookupListOffset
+    gpos.u16(10);
+    gpos.u16(30);
+    gpos.u16(42 + numLookups * 2);
+
+    // ScriptList
+    gpos.u16(1);
+    gpos.u32(sfntTag('D', 'F', 'L', 'T'));
+    gpos.u16(8);
+    // Script
+    gpos.u16(4);
+    gpos.u16(0);
+    // LangSys
+    gpos.u16(0);
+    gpos.u16(0xffff);
+    gpos.u16(1);
+    gpos.u16(0);
+
+    // FeatureList
+    gpos.u16(1);
+    gpos.u32(sfntTag('k', 'e', 'r', 'n'));
+    gpos.u16(8);
+    // Feature
+    gpos.u16(0);
+    gpos.u16(numLookups);
+    for (std::uint32_t i = 0; i < numLookups; ++i)
+        gpos.u16(i);
+
+    // LookupList
+    gpos.u16(numLookups);
+    for (std::uint32_t i = 0; i < numLookups; ++i)
+        gpos.u16(2 + numLookups * 2 + i * 16);
+
+    std::vector<std::size_t> extensionPositions;
+    for (std::uint32_t i = 0; i < numLookups; ++i) {
+        // Lookup: extension type, no flags, 1 subtable right after.
+        gpos.u16(9);
+        gpos.u16(0);
+        gpos.u16(1);
+        gpos.u16(8);
+
+        extensionPositions.push_back(gpos.getSize());
+        // Extension: format 1, pair adjustment, offset to patch.
+        gpos.u16(1);
+        gpos.u16(2);
+        gpos.u32(0);
+    }
+
+    for (std::uint32_t i = 0; i < numLookups; ++i) {
+        const auto extensionPos = extensionPositions[i];
+        gpos.setU32(extensionPos + 4, gpos.getSize() - extensionPos);
+        writePairPosFormat2(gpos, params, i);
+    }
+
+    return gpos;
+}
+
+
+static std::uint32_t calcChecksum(const std::vector<std::uint8_t>& data)
+{
+    std::uint32_t result = 0;
+    for (std::size_t i = 0; i < data.size(); i += 4) {
+        std::uint32_t word = 0;
+        for (std::size_t j = 0; j < 4; ++j) {
+            word <<= 8;
+            if (i + j < data.size())
+                word |= data[i + j];
+        }
+        result += word;
+    }
+
+    return result;
+}
+
+
+std::vector<std::uint8_t> generateStressFont(
+    const StressFontParams& params)
+{
+    if (params.numGlyphs < 2)
+        throw std::runtime_error("Stress font needs at least 2 glyphs");
+    if (params.numLookups > 0
+            && (params.numClasses1 == 0
+                || params.numClasses2 == 0
+                || params.numClassRanges == 0))
+        throw std::runtime_error(
+            "Numbers of classes and class ranges must be positive");
+
+    const std::uint32_t numGlyphs = params.numGlyphs;
+    const auto cps = getStressFontCps(params);
+
+    Buffer glyf;
+    Buffer loca;
+    Buffer hmtx;
+    int xMin = 0;
+    int yMin = 0;
+    int xMax = 0;
+    int yMax = 0;
+    int advanceMax = 0;
+    long advanceSum = 0;
+    for (std::uint32_t i = 0; i < numGlyphs; ++i) {
+        const auto shape = getGlyphShape(i);
+
+        loca.u32(glyf.getSize());
+        writeGlyph(glyf, shape);
+        glyf.align(4);
+
+        hmtx.u16(shape.getAdvance());
+        hmtx.s16(shape.x);
+
+        if (i == 0) {
+            xMin = shape.x;
+            yMin = shape.y;
+            xMax = shape.getXMax();
+            yMax = shape.getYMax();
+        } else {
+            xMin = std::min(xMin, shape.x);
+            yMin = std::min(yMin, shape.y);
+            xMax = std::max(xMax, shape.getXMax());
+            yMax = std::max(yMax, shape.getYMax());
+        }
+        advanceMax = std::max(advanceMax, shape.getAdvance());
+        advanceSum += shape.getAdvance();
+    }
+    loca.u32(glyf.getSize());
+
+    std::map<std::uint32_t, Buffer> tables;
+
+    // https://docs.microsoft.com/en-us/typography/opentype/spec/head
+    auto& head = tables[sfntTag('h', 'e', 'a', 'd')];
+    head.u32(0x00010000);
+    // fontRevision
+    head.u32(0x00010000);
+    // checkSumAdjustment is set at the end
+    head.u32(0);
+    head.u32(0x5f0f3cf5);
+    // flags: baseline and left sidebearing point at 0, integer ppem
+    head.u16(0x000b);
+    head.u16(unitsPerEm);
+    // created, modified
+    for (int i = 0; i < 4; ++i)
+        head.u32(0);
+    head.s16(xMin);
+    head.s16(yMin);
+    head.s16(xMax);
+    head.s16(yMax);
+    // macStyle
+    head.u16(0);
+    // lowestRecPPEM
+    head.u16(8);
+    // fontDirectionHint
+    head.s16(2);
+    // indexToLocFormat: long offsets
+    head.s16(1);
+    // glyphDataFormat
+    head.s16(0);
+
+    // https://docs.microsoft.com/en-us/typography/opentype/spec/hhea
+    auto& hhea = tables[sfntTag('h', 'h', 'e', 'a')];
+    hhea.u32(0x00010000);
+    hhea.s16(ascender);
+    hhea.s16(descender);
+    // lineGap
+    hhea.s16(0);
+    hhea.u16(advanceMax);
+    // minLeftSideBearing, minRightSideBearing, xMaxExtent
+    hhea.s16(xMin);
+    hhea.s16(50);
+    hhea.s16(xMax);
+    // caretSlopeRise, caretSlopeRun, caretOffset
+    hhea.s16(1);
+    hhea.s16(0);
+    hhea.s16(0);
+    // reserved
+    for (int i = 0; i < 4; ++i)
+        hhea.s16(0);
+    // metricDataFormat
+    hhea.s16(0);
+    // numberOfHMetrics
+    hhea.u16(numGlyphs);
+
+    // https://docs.microsoft.com/en-us/typography/opentype/spec/maxp
+    auto& maxp = tables[sfntTag('m', 'a', 'x', 'p')];
+    maxp.u32(0x00010000);
+    maxp.u16(numGlyphs);
+    maxp.u16(maxGlyphPoints);
+    maxp.u16(maxGlyphContours);
+    // maxCompositePoints, maxCompositeContours
+    maxp.u16(0);
+    maxp.u16(0);
+    // maxZones
+    maxp.u16(2);
+    // maxTwilightPoints, maxStorage, maxFunctionDefs,
+    // maxInstructionDefs, maxStackElements, maxSizeOfInstructions,
+    // maxComponentElements, maxComponentDepth
+    for (int i = 0; i < 8; ++i)
+        maxp.u16(0);
+
+    // https://docs.microsoft.com/en-us/typography/opentype/spec/os2
+    auto& os2 = tables[sfntTag('O', 'S', '/', '2')];
+    os2.u16(4);
+    // xAvgCharWidth
+    os2.s16(advanceSum / numGlyphs);
+    // usWeightClass, usWidthClass
+    os2.u16(400);
+    os2.u16(5);
+    // fsType: installable
+    os2.u16(0);
+    // Subscript and superscript sizes and offsets
+    for (int i = 0; i < 2; ++i) {
+        os2.s16(650);
+        os2.s16(600);
+        os2.s16(0);
+        os2.s16(i == 0 ? 75 : 350);
+    }
+    // yStrikeoutSize, yStrikeoutPosition
+    os2.s16(50);
+    os2.s16(300);
+    // sFamilyClass
+    os2.s16(0);
+    // panose
+    for (int i = 0; i < 10; ++i)
+        os2.u8(0);
+    // ulUnicodeRange1-4
+    for (int i = 0; i < 4; ++i)
+        os2.u32(0);
+    os2.u32(sfntTag('N', 'O', 'N', 'E'));
+    // fsSelection: REGULAR, USE_TYPO_METRICS
+    os2.u16(0x00c0);
+    // usFirstCharIndex, usLastCharIndex
+    os2.u16(std::min<char32_t>(cps.front(), 0xffff));
+    os2.u16(std::min<char32_t>(cps.back(), 0xffff));
+    // sTypoAscender, sTypoDescender, sTypoLineGap
+    os2.s16(ascender);
+    os2.s16(descender);
+    os2.s16(0);
+    // usWinAscent, usWinDescent
+    os2.u16(ascender);
+    os2.u16(-descender);
+    // ulCodePageRange1-2: Latin 1
+    os2.u32(1);
+    os2.u32(0);
+    // sxHeight, sCapHeight
+    os2.s16(500);
+    os2.s16(700);
+    // usDefaultChar, usBreakChar, usMaxContext
+    os2.u16(0);
+    os2.u16(0x20);
+    os2.u16(2);
+
+    // https://docs.microsoft.com/en-us/typography/opentype/spec/post
+    auto& post = tables[sfntTag('p', 'o', 's', 't')];
+    // version 3.0: no glyph names
+    post.u32(0x00030000);
+    // italicAngle
+    post.u32(0);
+    // underlinePosition, underlineThickness
+    post.s16(-100);
+    post.s16(50);
+    // isFixedPitch, minMemType42, maxMemType42, minMemType1,
+    // maxMemType1
+    for (int i = 0; i < 5; ++i)
+        post.u32(0);
+
+    tables[sfntTag('c', 'm', 'a', 'p')] = createCmap(cps);
+    tables[sfntTag('g', 'l', 'y', 'f')] = std::move(glyf);
+    tables[sfntTag('h', 'm', 't', 'x')] = std::move(hmtx);
+    tables[sfntTag('l', 'o', 'c', 'a')] = std::move(loca);
+    tables[sfntTag('n', 'a', 'm', 'e')] = createName();
+    if (params.numLookups > 0)
+        tables[sfntTag('G', 'P', 'O', 'S')] = createGpos(params);
+
+    // https://docs.microsoft.com/en-us/typography/opentype/spec/otff
+    const std::uint16_t numTables = tables.size();
+    std::uint16_t entrySelector = 0;
+    while ((2u << entrySelector) <= numTables)
+        ++entrySelector;
+    const std::uint16_t searchRange = (1u << entrySelector) * 16;
+
+    Buffer font;
+    font.u32(0x00010000);
+    font.u16(numTables);
+    font.u16(searchRange);
+    font.u16(entrySelector);
+    font.u16(numTables * 16 - searchRange);
+
+    std::uint32_t tableOffset = 12 + numTables * 16;
+    std::uint32_t headOffset = 0;
+    for (auto& tagAndTable : tables) {
+        auto& table = tagAndTable.second;
+        const std::uint32_t tableSize = table.getSize();
+        table.align(4);
+
+        if (tagAndTable.first == sfntTag('h', 'e', 'a', 'd'))
+            headOffset = tableOffset;
+
+        font.u32(tagAndTable.first);
+        font.u32(calcChecksum(table.data));
+        font.u32(tableOffset);
+        font.u32(tableSize);
+
+        tableOffset += table.getSize();
+    }
+
+    for (const auto& tagAndTable : tables) {
+        const auto& tableData = tagAndTable.second.data;
+        font.data.insert(font.data.end(), tableData.begin(), tableData.end());
+    }
+
+    font.setU32(headOffset + 8, 0xb1b0afba - calcChecksum(font.data));
+
+    return font.data;
+}
+
+
+}
@@ -0,0 +1,62 @@
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+
+namespace dpfb {
+
+
+/**
+ * Parameters of a synthetic TrueType font for scale testing.
+ *
+ * Every glyph except .notdef is mapped to a code point and has a
+ * simple outline of a unique size. All glyphs are covered by the
+ * class-based pair adjustment subtables of the "kern" feature.
+ */
+struct StressFontParams {
+    // Number of glyphs, including .notdef; at least 2.
+    std::uint16_t numGlyphs;
+    // Code point of glyph 1. Other glyphs follow in ascending order,
+    // skipping surrogates.
+    char32_t firstCp;
+    // Number of glyphs in a cmap format 12 group. Groups are
+    // separated by a code point that is not in the font. 0 means
+    // there are no gaps.
+    std::uint32_t cmapGroupSize;
+    // Number of GPOS lookups, each with a single class-based pair
+    // adjustment subtable. Lookups go through extension subtables,
+    // so their total size is not limited by 16-bit offsets.
+    std::uint16_t numLookups;
+    std::uint16_t numClasses1;
+    std::uint16_t numClasses2;
+    // Number of glyph ranges in every class definition table.
+    std::uint16_t numClassRanges;
+
+    StressFontParams();
+};
+
+
+/**
+ * Return code points of glyphs; cps[i] is the code point of glyph
+ * i + 1.
+ *
+ * \throws std::runtime_error if the code points don't fit in the
+ *     Unicode range
+ */
+std::vector<char32_t> getStressFontCps(const StressFontParams& params);
+
+
+/**
+ * Generate a font. The result is deterministic for the same params.
+ *
+ * \throws std::runtime_error if params are invalid, or if a pair
+ *     adjustment subtable doesn't fit in 16-bit offsets (reduce the
+ *     number of classes or class ranges).
+ */
+std::vector<std::uint8_t> generateStressFont(
+    const StressFontParams& params);
+
+
+}
@@ -0,0 +1,66 @@
+
+#include "catch.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "baking_stats.h"
+
+
+using namespace dpfb;
+
+
+TEST_CASE("BakingStats", "[baking_stats]") {
+    SECTION("Stage names") {
+        for (std::size_t i = 0; i < numBakingStages; ++i) {
+            const auto* name = getBakingStageName(
+                static_cast<BakingStage>(i));
+            REQUIRE(*name);
+
+            for (std::size_t j = 0; j < i; ++j)
+                REQUIRE(std::strcmp(
+                    name,
+                    getBakingStageName(static_cast<BakingStage>(j)))
+                    != 0);
+        }
+    }
+
+    SECTION("Nested scopes") {
+        BakingStats stats {};
+        {
+            const BakingStageScope outerScope(&stats, BakingStage::glyphs);
+            REQUIRE(
+                streams::getCurrentStreamStats()
+                == &stats[BakingStage::glyphs].io);
+            {
+                const BakingStageScope innerScope(
+                    &stats, BakingStage::kerning);
+                REQUIRE(
+                    streams::getCurrentStreamStats()
+                    == &stats[BakingStage::kerning].io);
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+            REQUIRE(
+                streams::getCurrentStreamStats()
+                == &stats[BakingStage::glyphs].io);
+            {
+                const BakingStageScope nullScope(
+                    nullptr, BakingStage::name);
+                REQUIRE(streams::getCurrentStreamStats() == nullptr);
+            }
+        }
+        REQUIRE(streams::getCurrentStreamStats() == nullptr);
+
+        const auto glyphsTime = stats[BakingStage::glyphs].timeNs;
+        const auto kerningTime = stats[BakingStage::kerning].timeNs;
+        REQUIRE(kerningTime >= 50000000);
+        // The outer stage doesn't include the nested one.
+        REQUIRE(glyphsTime < kerningTime);
+        REQUIRE(stats[BakingStage::name].timeNs == 0);
+
+        const auto total = stats.getTotal();
+        REQUIRE(total.timeNs == glyphsTime + kerningTime);
+        REQUIRE(total.peakRssKib == stats[BakingStage::glyphs].peakRssKib);
+    }
+}
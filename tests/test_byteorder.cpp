@@ -1,6 +1,9 @@
 
 #include "catch.hpp"
 
+#include <cstring>
+#include <vector>
+
 #include "byteorder.h"
 
 
@@ -12,3 +15,59 @@ TEST_CASE("swap", "[byteorder]") {
     REQUIRE(swap(std::uint32_t(0x12345678ul)) == 0x78563412);
 }
 
+
+TEST_CASE("copyFromBe", "[byteorder]") {
+    std::uint8_t src[4 * 40 + 3];
+    for (std::size_t i = 0; i < sizeof(src); ++i)
+        src[i] = i * 7 + 1;
+
+    // Sizes that are not multiples of a vector leave a scalar tail,
+    // and offsets check unaligned loads.
+    for (std::size_t offset = 0; offset < 4; ++offset) {
+        INFO("Offset " << offset);
+        const auto* s = src + offset;
+
+        for (std::size_t count = 0; count <= 40; ++count) {
+            INFO("Count " << count);
+
+            std::vector<std::uint16_t> scalar16(count);
+            copyFromBeScalar(s, scalar16.data(), count);
+            for (std::size_t i = 0; i < count; ++i)
+                REQUIRE(scalar16[i] == ((s[i * 2] << 8) | s[i * 2 + 1]));
+
+            std::vector<std::uint16_t> vector16(count);
+            copyFromBe(s, vector16.data(), count);
+            REQUIRE(vector16 == scalar16);
+
+            std::vector<std::uint32_t> scalar32(count);
+            copyFromBeScalar(s, scalar32.data(), count);
+            for (std::size_t i = 0; i < count; ++i)
+                REQUIRE(
+                    scalar32[i] == (
+                        (std::uint32_t(s[i * 4]) << 24)
+                        | (std::uint32_t(s[i * 4 + 1]) << 16)
+                        | (std::uint32_t(s[i * 4 + 2]) << 8)
+                        | s[i * 4 + 3]));
+
+            std::vector<std::uint32_t> vector32(count);
+            copyFromBe(s, vector32.data(), count);
+            REQUIRE(vector32 == scalar32);
+
+            // data() of an empty vector may be null, which is not
+            // allowed for memcpy().
+            if (count == 0)
+                continue;
+
+            // In-place conversion
+            std::vector<std::uint16_t> inPlace16(count);
+            std::memcpy(inPlace16.data(), s, count * 2);
+            copyFromBe(inPlace16.data(), inPlace16.data(), count);
+            REQUIRE(inPlace16 == scalar16);
+
+            std::vector<std::uint32_t> inPlace32(count);
+            std::memcpy(inPlace32.data(), s, count * 4);
+            copyFromBe(inPlace32.data(), inPlace32.data(), count);
+            REQUIRE(inPlace32 == scalar32);
+        }
+    }
+}
@@ -0,0 +1,66 @@
+
+#include "catch.hpp"
+
+#include "glyph_profile.h"
+
+
+using namespace dpfb;
+
+
+TEST_CASE("GlyphProfile", "[glyph_profile]") {
+    GlyphProfile profile;
+
+    REQUIRE(profile.getMedianNs() == 0);
+    REQUIRE(profile.getSlowest(5).empty());
+    REQUIRE(profile.getHistogram().empty());
+
+    profile.addMetricsTime('a', 500);
+    profile.addMetricsTime('b', 1000);
+    profile.addRenderTime('a', 200);
+    profile.addRenderTime('c', 3500);
+    profile.addRenderTime('b', 1500);
+    profile.addMetricsTime('d', 2500);
+
+    SECTION("Timings") {
+        const auto& timings = profile.getTimings();
+        REQUIRE(timings.size() == 4);
+
+        REQUIRE(timings[0].cp == 'a');
+        REQUIRE(timings[0].metricsNs == 500);
+        REQUIRE(timings[0].renderNs == 200);
+        REQUIRE(timings[0].getTotalNs() == 700);
+
+        REQUIRE(timings[1].cp == 'b');
+        REQUIRE(timings[1].getTotalNs() == 2500);
+        REQUIRE(timings[2].cp == 'c');
+        REQUIRE(timings[2].metricsNs == 0);
+        REQUIRE(timings[3].cp == 'd');
+    }
+
+    SECTION("Slowest") {
+        auto slowest = profile.getSlowest(3);
+        REQUIRE(slowest.size() == 3);
+        REQUIRE(slowest[0].cp == 'c');
+        // Equal times are ordered by code point
+        REQUIRE(slowest[1].cp == 'b');
+        REQUIRE(slowest[2].cp == 'd');
+
+        REQUIRE(profile.getSlowest(10).size() == 4);
+    }
+
+    SECTION("Median") {
+        REQUIRE(profile.getMedianNs() == 2500);
+    }
+
+    SECTION("Histogram") {
+        // 0.7 us, 2.5 us, 3.5 us, 2.5 us
+        const std::vector<std::size_t> expected {1, 0, 3};
+        REQUIRE(profile.getHistogram() == expected);
+
+        profile.addRenderTime('e', 70000);
+        // 70 us is in [64, 128)
+        const auto histogram = profile.getHistogram();
+        REQUIRE(histogram.size() == 8);
+        REQUIRE(histogram[7] == 1);
+    }
+}
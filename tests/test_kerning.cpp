@@ -3,9 +3,13 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <random>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -205,7 +209,7 @@ static KerningTest loadKerningTestFp(
 
 
 static std::vector<RawKerningPair> readKerningPairs(
-    streams::Stream& stream,
+    const streams::SpanReader& fontReader,
     const SfntOffsetTable& sfntOffsetTable,
     const KerningParams& kerningParams,
     KerningSource kerningSource)
@@ -215,14 +219,14 @@ static std::vector<RawKerningPair> readKerningPairs(
     if (kerningSource == KerningSource::gpos
             || kerningSource == KerningSource::kernAndGpos) {
         pairs = readKerningPairsGpos(
-            stream, sfntOffsetTable, kerningParams);
+            fontReader, sfntOffsetTable, kerningParams);
         if (!pairs.empty() || kerningSource == KerningSource::gpos)
             return pairs;
         // else fall back to kern
     }
 
     pairs = readKerningPairsKern(
-        stream, sfntOffsetTable, kerningParams);
+        fontReader, sfntOffsetTable, kerningParams);
 
     return pairs;
 }
@@ -249,9 +253,8 @@ TEST_CASE("Kerning", "[kerning]") {
 
         INFO(fileName);
         const auto fontData = getData(fileName);
-        streams::ConstMemStream fontStream(
-            &fontData[0], fontData.size());
-        SfntOffsetTable sfntOffsetTable(fontStream, 0);
+        streams::SpanReader fontReader(&fontData[0], fontData.size());
+        SfntOffsetTable sfntOffsetTable(fontReader, 0);
 
         // We run the tests with all font renderers to ensure that
         // code point to glyph index conversion is the same.
@@ -260,7 +263,7 @@ TEST_CASE("Kerning", "[kerning]") {
         for (const auto* c = creator; c; c = c->getNext()) {
             std::unique_ptr<FontRenderer> fontRendererPtr(
                 // The font size doesn't matter
-                c->create({&fontData[0], fontData.size(), 12, {}}));
+                c->create({&fontData[0], fontData.size(), 0, 12, {}, {}}));
             INFO("Font renderer " << c->getName());
 
             for (int i = 0; i < 100; ++i) {
@@ -294,10 +297,12 @@ TEST_CASE("Kerning", "[kerning]") {
 
                 const KerningParams kerningParams {
                     kerningTest.pxSize,
-                    kerningTest.pxPerEm
+                    kerningTest.pxPerEm,
+                    KerningUnits::px,
+                    {}
                 };
                 auto pairs = readKerningPairs(
-                    fontStream,
+                    fontReader,
                     sfntOffsetTable,
                     kerningParams,
                     test.kerningSource);
@@ -310,4 +315,621 @@ TEST_CASE("Kerning", "[kerning]") {
 }
 
 
+static bool operator==(const KerningPair& a, const KerningPair& b)
+{
+    return a.cp1 == b.cp1 && a.cp2 == b.cp2 && a.amount == b.amount;
+}
+
+
+static bool operator==(const KerningDelta& a, const KerningDelta& b)
+{
+    return (
+        a.cp1 == b.cp1
+        && a.cp2 == b.cp2
+        && a.pxSize == b.pxSize
+        && a.amount == b.amount);
+}
+
+
+// The reference implementation of sortKerningPairsUnique().
+static void stableSortKerningPairsUnique(std::vector<KerningPair>& pairs)
+{
+    std::stable_sort(
+        pairs.begin(), pairs.end(),
+        [](const KerningPair& a, const KerningPair& b)
+        {
+            if (a.cp1 != b.cp1)
+                return a.cp1 < b.cp1;
+            else
+                return a.cp2 < b.cp2;
+        });
+    pairs.erase(
+        std::unique(
+            pairs.begin(), pairs.end(),
+            [](const KerningPair& a, const KerningPair& b)
+            {
+                return a.cp1 == b.cp1 && a.cp2 == b.cp2;
+            }),
+        pairs.end());
+}
+
+
+static std::vector<KerningPair> generateKerningPairs(
+    std::size_t numPairs, char32_t maxCp, std::uint32_t seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<char32_t> cpDist(0, maxCp);
+    std::uniform_int_distribution<int> amountDist(-100, 100);
+
+    std::vector<KerningPair> pairs;
+    pairs.reserve(numPairs);
+    while (pairs.size() < numPairs)
+        pairs.push_back({cpDist(gen), cpDist(gen), amountDist(gen)});
+
+    return pairs;
+}
+
+
+TEST_CASE("Kerning pairs sorting", "[kerning]") {
+    REQUIRE_NOTHROW([]
+    {
+        std::vector<KerningPair> pairs;
+        sortKerningPairsUnique(pairs);
+    }());
+
+    // Small ranges give a lot of duplicates; the big one checks
+    // code points that need more than one radix digit.
+    const char32_t maxCps[] = {0, 3, 0x7f, 0x10ffff};
+    for (auto maxCp : maxCps) {
+        INFO("maxCp " << maxCp);
+
+        auto pairs = generateKerningPairs(10000, maxCp, maxCp);
+        auto expected = pairs;
+
+        sortKerningPairsUnique(pairs);
+        stableSortKerningPairsUnique(expected);
+
+        REQUIRE(pairs == expected);
+    }
+}
+
+
+// Convert glyph indices to "code points" as is.
+static std::vector<KerningPair> toKerningPairs(
+    const std::vector<RawKerningPair>& rawPairs)
+{
+    std::vector<KerningPair> pairs;
+    for (const auto& rawPair : rawPairs)
+        pairs.push_back(
+            {rawPair.glyphIdx1, rawPair.glyphIdx2, rawPair.amount});
+
+    sortKerningPairsUnique(pairs);
+    return pairs;
+}
+
+
+static std::vector<KerningClassEntry> toKerningClassEntries(
+    const std::vector<RawGlyphClass>& glyphClasses)
+{
+    std::vector<KerningClassEntry> entries;
+    for (const auto& glyphClass : glyphClasses)
+        entries.push_back({glyphClass.glyphIdx, glyphClass.glyphClass});
+
+    return entries;
+}
+
+
+static std::vector<KerningClassTable> toKerningClassTables(
+    const std::vector<RawKerningClassTable>& rawClassTables)
+{
+    std::vector<KerningClassTable> classTables;
+    for (const auto& rawClassTable : rawClassTables)
+        classTables.push_back({
+            toKerningClassEntries(rawClassTable.glyphClasses1),
+            toKerningClassEntries(rawClassTable.glyphClasses2),
+            rawClassTable.numClasses1,
+            rawClassTable.numClasses2,
+            rawClassTable.amounts});
+
+    return classTables;
+}
+
+
+TEST_CASE("Kerning class tables", "[kerning]") {
+    const auto tests = loadTestList();
+
+    char fileName[128];
+    for (const auto& test : tests) {
+        std::snprintf(
+            fileName, sizeof(fileName),
+            "data/kerning_%s.otf", test.name.c_str());
+
+        INFO(fileName);
+        const auto fontData = getData(fileName);
+        streams::SpanReader fontReader(&fontData[0], fontData.size());
+        SfntOffsetTable sfntOffsetTable(fontReader, 0);
+
+        const KerningParams kerningParams {16, 1000, KerningUnits::px, {}};
+
+        const auto expected = toKerningPairs(
+            readKerningPairsGpos(
+                fontReader, sfntOffsetTable, kerningParams));
+
+        std::vector<RawKerningClassTable> rawClassTables;
+        const auto pairs = toKerningPairs(
+            readKerningPairsGpos(
+                fontReader,
+                sfntOffsetTable,
+                kerningParams,
+                nullptr,
+                &rawClassTables));
+
+        if (test.name == "gpos_classes")
+            REQUIRE(!rawClassTables.empty());
+
+        for (const auto& rawClassTable : rawClassTables)
+            REQUIRE(
+                rawClassTable.amounts.size()
+                == static_cast<std::size_t>(rawClassTable.numClasses1)
+                    * rawClassTable.numClasses2);
+
+        REQUIRE(
+            expandKerningClasses(pairs, toKerningClassTables(rawClassTables))
+            == expected);
+    }
+}
+
+
+TEST_CASE("Kerning pair adjustments presence", "[kerning]") {
+    const auto tests = loadTestList();
+
+    char fileName[128];
+    for (const auto& test : tests) {
+        std::snprintf(
+            fileName, sizeof(fileName),
+            "data/kerning_%s.otf", test.name.c_str());
+
+        INFO(fileName);
+        const auto fontData = getData(fileName);
+        streams::SpanReader fontReader(&fontData[0], fontData.size());
+        SfntOffsetTable sfntOffsetTable(fontReader, 0);
+
+        // The presence doesn't depend on the glyph set.
+        const GlyphSet noGlyphs;
+        bool hasPairAdjustments = false;
+        const auto pairs = readKerningPairsGpos(
+            fontReader,
+            sfntOffsetTable,
+            {16, 1000, KerningUnits::px, {}},
+            &noGlyphs,
+            nullptr,
+            nullptr,
+            &hasPairAdjustments);
+
+        REQUIRE(pairs.empty());
+        REQUIRE(
+            hasPairAdjustments
+            == (test.kerningSource != KerningSource::kern));
+    }
+}
+
+
+TEST_CASE("Kerning in font units", "[kerning]") {
+    const auto tests = loadTestList();
+
+    char fileName[128];
+    for (const auto& test : tests) {
+        std::snprintf(
+            fileName, sizeof(fileName),
+            "data/kerning_%s.otf", test.name.c_str());
+
+        INFO(fileName);
+        const auto fontData = getData(fileName);
+        streams::SpanReader fontReader(&fontData[0], fontData.size());
+        SfntOffsetTable sfntOffsetTable(fontReader, 0);
+
+        const int unitsPerEm = 1000;
+
+        std::vector<RawKerningDelta> rawDeltas;
+        const auto pairs = toKerningPairs(
+            readKerningPairsGpos(
+                fontReader,
+                sfntOffsetTable,
+                {0, unitsPerEm, KerningUnits::font, {}},
+                nullptr,
+                nullptr,
+                &rawDeltas));
+
+        std::vector<KerningDelta> deltas;
+        for (const auto& rawDelta : rawDeltas)
+            deltas.push_back({
+                rawDelta.glyphIdx1,
+                rawDelta.glyphIdx2,
+                rawDelta.pxSize,
+                rawDelta.amount});
+        std::stable_sort(
+            deltas.begin(), deltas.end(),
+            [](const KerningDelta& a, const KerningDelta& b)
+            {
+                if (a.cp1 != b.cp1)
+                    return a.cp1 < b.cp1;
+                else
+                    return a.cp2 < b.cp2;
+            });
+
+        if (test.name.find("device") != std::string::npos)
+            REQUIRE(!deltas.empty());
+
+        std::vector<int> pxSizes;
+        for (int pxSize = 1; pxSize <= 64; ++pxSize)
+            pxSizes.push_back(pxSize);
+        for (const auto& delta : deltas)
+            pxSizes.push_back(delta.pxSize);
+
+        for (auto pxSize : pxSizes) {
+            INFO("pxSize " << pxSize);
+
+            const auto expected = toKerningPairs(
+                readKerningPairsGpos(
+                    fontReader,
+                    sfntOffsetTable,
+                    {pxSize, unitsPerEm, KerningUnits::px, {}}));
+
+            REQUIRE(
+                scaleKerningPairs(pairs, deltas, pxSize, unitsPerEm)
+                == expected);
+        }
+    }
+}
+
+
+static void appendU16(std::vector<std::uint8_t>& data, std::uint16_t v)
+{
+    data.push_back(v >> 8);
+    data.push_back(v & 0xff);
+}
+
+
+static void appendU16s(
+    std::vector<std::uint8_t>& data,
+    std::initializer_list<std::uint16_t> values)
+{
+    for (const auto v : values)
+        appendU16(data, v);
+}
+
+
+// A font with only a "GPOS" table of a single lookup with two pair
+// adjustment subtables of the given format. The first has (1, 2)
+// without a device table. The second has (1, 2) and (1, 3), both
+// with an xAdvance device table for 10 px.
+static std::vector<std::uint8_t> createOverlappingSubtablesFont(
+    int posFormat)
+{
+    std::vector<std::uint8_t> data;
+
+    // Offset table with a single record.
+    appendU16s(data, {0x0001, 0x0000, 1, 0, 0, 0});
+    appendU16s(data, {'G' << 8 | 'P', 'O' << 8 | 'S', 0, 0, 0, 28});
+    const auto lengthPos = data.size();
+    appendU16s(data, {0, 0});
+
+    const auto gposStart = data.size();
+
+    // Header, empty ScriptList, and FeatureList with "kern".
+    appendU16s(data, {1, 0, 10, 12, 26});
+    appendU16s(data, {0});
+    appendU16s(data, {1, 'k' << 8 | 'e', 'r' << 8 | 'n', 8});
+    appendU16s(data, {0, 1, 0});
+
+    // LookupList and a pair adjustment lookup with 2 subtables.
+    const std::uint16_t subtableBOffset = posFormat == 1 ? 34 : 50;
+    appendU16s(data, {1, 4});
+    appendU16s(data, {2, 0, 2, 10, subtableBOffset});
+
+    if (posFormat == 1) {
+        // Subtable A: coverage of glyph 1, and the pair (1, 2) with
+        // xAdvance -500.
+        appendU16s(data, {1, 12, 0x0004, 0, 1, 18});
+        appendU16s(data, {1, 1, 1});
+        appendU16s(data, {1, 2, static_cast<std::uint16_t>(-500)});
+
+        // Subtable B: (1, 2) with xAdvance -800 and (1, 3) with
+        // xAdvance 0, both with a device table of -1 for 10 px.
+        appendU16s(data, {1, 12, 0x0044, 0, 1, 18});
+        appendU16s(data, {1, 1, 1});
+        appendU16s(data, {2, 2, static_cast<std::uint16_t>(-800), 32});
+        appendU16s(data, {3, 0, 32});
+        appendU16s(data, {10, 10, 1, 0xc000});
+    } else {
+        // Subtable A: glyph 1 in the first class 0, glyph 2 in the
+        // second class 1, and xAdvance -500 for (0, 1).
+        appendU16s(data, {2, 20, 0x0004, 0, 26, 30, 1, 2});
+        appendU16s(data, {0, static_cast<std::uint16_t>(-500)});
+        appendU16s(data, {1, 1, 1});
+        appendU16s(data, {2, 0});
+        appendU16s(data, {2, 1, 2, 2, 1});
+
+        // Subtable B: glyphs 2 and 3 in the second classes 1 and 2
+        // with xAdvance -800 and 0, both with a device table of -1
+        // for 10 px.
+        appendU16s(data, {2, 28, 0x0044, 0, 34, 38, 1, 3});
+        appendU16s(data, {0, 0});
+        appendU16s(data, {static_cast<std::uint16_t>(-800), 54});
+        appendU16s(data, {0, 54});
+        appendU16s(data, {1, 1, 1});
+        appendU16s(data, {2, 0});
+        appendU16s(data, {2, 2, 2, 2, 1, 3, 3, 2});
+        appendU16s(data, {10, 10, 1, 0xc000});
+    }
+
+    const auto gposLength = data.size() - gposStart;
+    data[lengthPos + 2] = gposLength >> 8;
+    data[lengthPos + 3] = gposLength & 0xff;
+
+    return data;
+}
+
+
+TEST_CASE("Kerning deltas of overlapping subtables", "[kerning]") {
+    const int unitsPerEm = 1000;
+
+    for (int posFormat = 1; posFormat <= 2; ++posFormat) {
+        INFO("posFormat " << posFormat);
+
+        const auto fontData = createOverlappingSubtablesFont(posFormat);
+        streams::SpanReader fontReader(&fontData[0], fontData.size());
+        SfntOffsetTable sfntOffsetTable(fontReader, 0);
+
+        for (int useClasses = 0; useClasses <= 1; ++useClasses) {
+            INFO("useClasses " << useClasses);
+
+            std::vector<RawKerningClassTable> rawClassTables;
+            std::vector<RawKerningDelta> rawDeltas;
+            const auto rawPairs = toKerningPairs(
+                readKerningPairsGpos(
+                    fontReader,
+                    sfntOffsetTable,
+                    {0, unitsPerEm, KerningUnits::font, {}},
+                    nullptr,
+                    useClasses ? &rawClassTables : nullptr,
+                    &rawDeltas));
+            const auto pairs = expandKerningClasses(
+                rawPairs, toKerningClassTables(rawClassTables));
+
+            // The pair (1, 2) belongs to subtable A, so the deltas of
+            // subtable B must not be applied to it.
+            const std::vector<KerningPair> expectedPairs {{1, 2, -500}};
+            REQUIRE(pairs == expectedPairs);
+
+            REQUIRE(rawDeltas.size() == 1);
+            REQUIRE(rawDeltas[0].glyphIdx1 == 1);
+            REQUIRE(rawDeltas[0].glyphIdx2 == 3);
+            REQUIRE(rawDeltas[0].pxSize == 10);
+            REQUIRE(rawDeltas[0].amount == -1);
+
+            const std::vector<KerningDelta> deltas {{1, 3, 10, -1}};
+
+            for (int pxSize = 1; pxSize <= 16; ++pxSize) {
+                INFO("pxSize " << pxSize);
+
+                const auto expected = toKerningPairs(
+                    readKerningPairsGpos(
+                        fontReader,
+                        sfntOffsetTable,
+                        {pxSize, unitsPerEm, KerningUnits::px, {}}));
+
+                REQUIRE(
+                    scaleKerningPairs(pairs, deltas, pxSize, unitsPerEm)
+                    == expected);
+            }
+        }
+    }
+}
+
+
+TEST_CASE("Kerning scope", "[kerning]") {
+    const auto fontData = getData("data/kerning_gpos_script.otf");
+    streams::SpanReader fontReader(&fontData[0], fontData.size());
+    SfntOffsetTable sfntOffsetTable(fontReader, 0);
+
+    const auto* creator = FontRendererCreator::getFirst();
+    REQUIRE(creator);
+    std::unique_ptr<FontRenderer> fontRenderer(
+        creator->create({&fontData[0], fontData.size(), 0, 12, {}, {}}));
+
+    const auto readPairs = [&](
+        std::vector<std::uint32_t> scriptTags, std::uint32_t langTag)
+    {
+        const KerningParams kerningParams {
+            1000, 1000, KerningUnits::px, {scriptTags, langTag}};
+        auto pairs = readKerningPairsGpos(
+            fontReader, sfntOffsetTable, kerningParams);
+        sortKerningPairs(pairs);
+        return pairs;
+    };
+
+    const auto makePairs = [&](const char* str)
+    {
+        std::vector<RawKerningPair> pairs;
+        for (const auto* s = str; *s; s += 2)
+            pairs.push_back({
+                static_cast<std::uint16_t>(
+                    fontRenderer->getGlyphIndex(s[0])),
+                static_cast<std::uint16_t>(
+                    fontRenderer->getGlyphIndex(s[1])),
+                1});
+        sortKerningPairs(pairs);
+        return pairs;
+    };
+
+    const auto dflt = sfntTag('D', 'F', 'L', 'T');
+    const auto latn = sfntTag('l', 'a', 't', 'n');
+    const auto cyrl = sfntTag('c', 'y', 'r', 'l');
+    const auto grek = sfntTag('g', 'r', 'e', 'k');
+    const auto rus = sfntTag('R', 'U', 'S', ' ');
+    const auto trk = sfntTag('T', 'R', 'K', ' ');
+
+    REQUIRE(readPairs({}, 0) == makePairs("aaabbabbcccddcdd"));
+    REQUIRE(readPairs({dflt}, 0) == makePairs("aacc"));
+    REQUIRE(readPairs({latn}, 0) == makePairs("abcd"));
+    REQUIRE(readPairs({cyrl}, 0) == makePairs("badc"));
+    REQUIRE(readPairs({cyrl}, rus) == makePairs("bbdd"));
+    REQUIRE(readPairs({latn, cyrl}, rus) == makePairs("abbbcddd"));
+
+    // Unknown language falls back to the default one
+    REQUIRE(readPairs({cyrl}, trk) == makePairs("badc"));
+    // Unknown script falls back to DFLT
+    REQUIRE(readPairs({grek}, 0) == makePairs("aacc"));
+}
+
+
+TEST_CASE("Kerning classes expansion", "[kerning]") {
+    // The first non-zero amount wins: pairs, then tables in order.
+    const std::vector<KerningPair> pairs {{'A', 'V', -1}};
+    const std::vector<KerningClassTable> classTables {
+        {
+            {{'A', 0}, {'L', 1}},
+            {{'T', 0}, {'V', 0}},
+            2,
+            1,
+            {-2, 0}
+        },
+        {
+            {{'L', 0}},
+            {{'T', 0}},
+            1,
+            1,
+            {-3}
+        },
+    };
+
+    const std::vector<KerningPair> expected {
+        {'A', 'T', -2},
+        {'A', 'V', -1},
+        {'L', 'T', -3},
+    };
+    REQUIRE(expandKerningClasses(pairs, classTables) == expected);
+}
+
+
+TEST_CASE("Kerning budget", "[kerning]") {
+    const std::vector<KerningPair> pairs {
+        {'A', 'T', -4},
+        {'A', 'V', -3},
+        {'L', 'T', -5},
+        {'T', 'a', -2},
+        {'T', 'o', -1},
+        {'V', 'a', 2},
+    };
+
+    SECTION("No budget") {
+        REQUIRE_FALSE(isKerningBudgetSet({0, 0, nullptr}));
+
+        auto result = pairs;
+        REQUIRE(applyKerningBudget(result, {0, 0, nullptr}) == 0);
+        REQUIRE(result == pairs);
+    }
+
+    SECTION("Min amount") {
+        auto result = pairs;
+        REQUIRE(applyKerningBudget(result, {0, 3, nullptr}) == 3);
+
+        const std::vector<KerningPair> expected {
+            {'A', 'T', -4},
+            {'A', 'V', -3},
+            {'L', 'T', -5},
+        };
+        REQUIRE(result == expected);
+    }
+
+    SECTION("Max pairs") {
+        auto result = pairs;
+        REQUIRE(applyKerningBudget(result, {4, 0, nullptr}) == 2);
+
+        // Ties are resolved by the original order.
+        const std::vector<KerningPair> expected {
+            {'A', 'T', -4},
+            {'A', 'V', -3},
+            {'L', 'T', -5},
+            {'T', 'a', -2},
+        };
+        REQUIRE(result == expected);
+    }
+
+    SECTION("Max pairs with bigram counts") {
+        const char text[] = "Tatoo To Tao LT";
+        auto bigramCounts = std::make_shared<BigramCounts>();
+        bigramCounts->addText(text, sizeof(text) - 1);
+
+        REQUIRE(bigramCounts->getCount('T', 'o') == 1);
+        REQUIRE(bigramCounts->getCount('T', 'a') == 2);
+        REQUIRE(bigramCounts->getCount('A', 'V') == 0);
+
+        auto result = pairs;
+        REQUIRE(applyKerningBudget(result, {3, 0, bigramCounts}) == 3);
+
+        const std::vector<KerningPair> expected {
+            {'L', 'T', -5},
+            {'T', 'a', -2},
+            {'T', 'o', -1},
+        };
+        REQUIRE(result == expected);
+    }
+
+    SECTION("Deltas") {
+        // 'T', 'y' has deltas without a kerning pair.
+        std::vector<KerningDelta> deltas {
+            {'A', 'T', 12, 1},
+            {'T', 'o', 12, -1},
+            {'T', 'y', 12, -1},
+            {'V', 'a', 10, 1},
+            {'V', 'a', 12, 1},
+        };
+
+        auto result = pairs;
+        REQUIRE(applyKerningBudget(result, {4, 2, nullptr}, &deltas) == 2);
+
+        const std::vector<KerningDelta> expected {
+            {'A', 'T', 12, 1},
+            {'T', 'y', 12, -1},
+        };
+        REQUIRE(deltas == expected);
+    }
+}
+
+
+// Run with: ./tests "[benchmark]"
+TEST_CASE("Kerning pairs sorting benchmark", "[.][benchmark]") {
+    // Emulate class kerning of a big font: pairs of several
+    // thousands code points with duplicates from multiple lookups,
+    // grouped by the first glyph but not sorted.
+    auto pairs = generateKerningPairs(4000000, 0x2fff, 0);
+    std::stable_sort(
+        pairs.begin(), pairs.end(),
+        [](const KerningPair& a, const KerningPair& b)
+        {
+            return a.cp1 < b.cp1;
+        });
+
+    using Clock = std::chrono::steady_clock;
+
+    auto expected = pairs;
+    const auto stableSortStart = Clock::now();
+    stableSortKerningPairsUnique(expected);
+    const auto stableSortTime = Clock::now() - stableSortStart;
+
+    const auto radixSortStart = Clock::now();
+    sortKerningPairsUnique(pairs);
+    const auto radixSortTime = Clock::now() - radixSortStart;
+
+    REQUIRE(pairs == expected);
+
+    using Ms = std::chrono::duration<double, std::milli>;
+    WARN(
+        "stable_sort + unique: " << Ms(stableSortTime).count() << " ms; "
+        "sortKerningPairsUnique(): " << Ms(radixSortTime).count()
+        << " ms");
+}
+
 }
@@ -0,0 +1,435 @@
+
+#include "catch.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "dp_rect_pack.h"
+#include "image.h"
+#include "image_writer/image_writer.h"
+#include "kerning.h"
+#include "kerning_detail.h"
+#include "microbench.h"
+#include "sfnt.h"
+#include "str.h"
+#include "streams/const_mem_stream.h"
+#include "streams/file_stream.h"
+#include "streams/span_reader.h"
+
+
+using namespace dpfb;
+
+
+TEST_CASE("Microbenchmark statistics", "[microbench]") {
+    SECTION("Empty") {
+        const auto stats = microbench::computeStatistics({});
+        REQUIRE(stats.min == 0.0);
+        REQUIRE(stats.median == 0.0);
+        REQUIRE(stats.mean == 0.0);
+        REQUIRE(stats.stdDev == 0.0);
+    }
+
+    SECTION("Single value") {
+        const auto stats = microbench::computeStatistics({3.0});
+        REQUIRE(stats.min == 3.0);
+        REQUIRE(stats.median == 3.0);
+        REQUIRE(stats.mean == 3.0);
+        REQUIRE(stats.stdDev == 0.0);
+    }
+
+    SECTION("Odd count") {
+        const auto stats = microbench::computeStatistics(
+            {9.0, 1.0, 5.0, 3.0, 7.0});
+        REQUIRE(stats.min == 1.0);
+        REQUIRE(stats.median == 5.0);
+        REQUIRE(stats.mean == 5.0);
+        REQUIRE(stats.stdDev == Approx(3.16227766));
+    }
+
+    SECTION("Even count") {
+        const auto stats = microbench::computeStatistics(
+            {4.0, 1.0, 2.0, 3.0});
+        REQUIRE(stats.median == 2.5);
+    }
+
+    SECTION("Calibration") {
+        microbench::Options options;
+        options.warmupTime = std::chrono::milliseconds(1);
+        options.minSampleTime = std::chrono::microseconds(100);
+        options.numSamples = 3;
+
+        std::size_t minNumIters = 0;
+        const auto result = microbench::run(
+            [&](std::size_t numIters)
+            {
+                if (minNumIters == 0 || numIters < minNumIters)
+                    minNumIters = numIters;
+
+                std::uint64_t sum = 0;
+                for (std::size_t i = 0; i < numIters; ++i)
+                    sum += i * i;
+                return sum;
+            },
+            options);
+
+        REQUIRE(minNumIters == 1);
+        REQUIRE(result.itersPerSample > 1);
+        REQUIRE(result.numSamples == 3);
+        REQUIRE(result.ns.min > 0.0);
+        REQUIRE(result.ns.min <= result.ns.median);
+    }
+}
+
+
+// Microbenchmarks of hot kernels. Run with: ./tests "[microbench]"
+
+
+namespace {
+
+
+class NullStream : public streams::Stream {
+public:
+    std::size_t write(const void* src, std::size_t srcSize) noexcept override
+    {
+        (void)src;
+        size += srcSize;
+        return srcSize;
+    }
+
+    std::size_t read(void* dst, std::size_t dstSize) noexcept override
+    {
+        (void)dst;
+        (void)dstSize;
+        return 0;
+    }
+
+    std::int64_t getSize() const override
+    {
+        return size;
+    }
+
+    void seek(std::int64_t offset, streams::SeekOrigin origin) override
+    {
+        (void)offset;
+        (void)origin;
+        throw streams::StreamError("NullStream doesn't support seeking");
+    }
+
+    std::int64_t getPosition() const override
+    {
+        return size;
+    }
+private:
+    std::int64_t size {};
+};
+
+
+}
+
+
+static void report(const char* name, const microbench::Result& result)
+{
+    std::printf("%s\n", microbench::formatResult(name, result).c_str());
+    std::fflush(stdout);
+}
+
+
+static void appendU16Be(std::vector<std::uint8_t>& data, std::uint16_t v)
+{
+    data.push_back(v >> 8);
+    data.push_back(v & 0xff);
+}
+
+
+TEST_CASE("Stream reading microbenchmark", "[.][microbench]") {
+    std::vector<std::uint8_t> data(64 * 1024);
+    for (std::size_t i = 0; i < data.size(); ++i)
+        data[i] = i * 7;
+
+    const auto numWords = data.size() / 2;
+
+    report(
+        "ConstMemStream::readU16Be()",
+        microbench::run(
+            [&](std::size_t numIters)
+            {
+                streams::ConstMemStream stream(&data[0], data.size());
+                std::uint64_t sum = 0;
+                std::size_t wordIdx = 0;
+                for (std::size_t i = 0; i < numIters; ++i) {
+                    if (wordIdx == numWords) {
+                        stream.seek(0, streams::SeekOrigin::set);
+                        wordIdx = 0;
+                    }
+                    sum += stream.readU16Be();
+                    ++wordIdx;
+                }
+                return sum;
+            }));
+
+    report(
+        "SpanReader::readU16Be()",
+        microbench::run(
+            [&](std::size_t numIters)
+            {
+                streams::SpanReader reader(&data[0], data.size());
+                std::uint64_t sum = 0;
+                std::size_t wordIdx = 0;
+                for (std::size_t i = 0; i < numIters; ++i) {
+                    if (wordIdx == numWords) {
+                        reader.seek(0, streams::SeekOrigin::set);
+                        wordIdx = 0;
+                    }
+                    sum += reader.readU16Be();
+                    ++wordIdx;
+                }
+                return sum;
+            }));
+}
+
+
+TEST_CASE("OpenType layout tables microbenchmark", "[.][microbench]") {
+    std::mt19937 gen(0);
+
+    // Every other glyph, so that no glyphs are merged in ranges.
+    std::vector<std::uint8_t> coverage1;
+    appendU16Be(coverage1, 1);
+    appendU16Be(coverage1, 4000);
+    for (std::uint16_t i = 0; i < 4000; ++i)
+        appendU16Be(coverage1, i * 2);
+
+    std::vector<std::uint8_t> coverage2;
+    appendU16Be(coverage2, 2);
+    appendU16Be(coverage2, 1000);
+    for (std::uint16_t i = 0, coverageIdx = 0; i < 1000; ++i) {
+        const std::uint16_t first = i * 16;
+        const std::uint16_t last = first + gen() % 8;
+        appendU16Be(coverage2, first);
+        appendU16Be(coverage2, last);
+        appendU16Be(coverage2, coverageIdx);
+        coverageIdx += last - first + 1;
+    }
+
+    const std::uint16_t classCount = 50;
+
+    // Runs of 1-4 glyphs of the same class.
+    std::vector<std::uint8_t> classDef1;
+    appendU16Be(classDef1, 1);
+    appendU16Be(classDef1, 0);
+    appendU16Be(classDef1, 10000);
+    for (std::uint16_t i = 0; i < 10000;) {
+        const std::uint16_t glyphClass = gen() % classCount;
+        for (auto runLen = gen() % 4 + 1; runLen && i < 10000; --runLen) {
+            appendU16Be(classDef1, glyphClass);
+            ++i;
+        }
+    }
+
+    std::vector<std::uint8_t> classDef2;
+    appendU16Be(classDef2, 2);
+    appendU16Be(classDef2, 2000);
+    for (std::uint16_t i = 0; i < 2000; ++i) {
+        const std::uint16_t first = i * 8;
+        appendU16Be(classDef2, first);
+        appendU16Be(classDef2, first + gen() % 8);
+        appendU16Be(classDef2, gen() % classCount);
+    }
+
+    struct Test {
+        const char* name;
+        const std::vector<std::uint8_t>* data;
+        bool isCoverage;
+    };
+    const Test tests[] = {
+        {"readCoverageTable(), format 1, 4000 glyphs", &coverage1, true},
+        {"readCoverageTable(), format 2, 1000 ranges", &coverage2, true},
+        {"readClassDefTable(), format 1, 10000 glyphs", &classDef1, false},
+        {"readClassDefTable(), format 2, 2000 ranges", &classDef2, false},
+    };
+
+    for (const auto& test : tests) {
+        const auto& data = *test.data;
+        report(
+            test.name,
+            microbench::run(
+                [&](std::size_t numIters)
+                {
+                    std::uint64_t sum = 0;
+                    for (std::size_t i = 0; i < numIters; ++i) {
+                        streams::SpanReader reader(&data[0], data.size());
+                        if (test.isCoverage)
+                            sum += detail::readCoverageTable(reader).size();
+                        else
+                            sum += detail::readClassDefTable(
+                                reader, classCount).size();
+                    }
+                    return sum;
+                }));
+    }
+}
+
+
+TEST_CASE("GPOS kerning microbenchmark", "[.][microbench]") {
+    std::vector<std::uint8_t> fontData;
+    {
+        streams::FileStream f("data/kerning_gpos_classes.otf", "rb");
+        fontData.resize(f.getSize());
+        f.readBuffer(&fontData[0], fontData.size());
+    }
+
+    const streams::SpanReader fontReader(&fontData[0], fontData.size());
+    const SfntOffsetTable sfntOffsetTable(fontReader, 0);
+    const KerningParams kerningParams {16, 1000, KerningUnits::px, {}};
+
+    report(
+        "readKerningPairsGpos(), gpos_classes",
+        microbench::run(
+            [&](std::size_t numIters)
+            {
+                std::uint64_t sum = 0;
+                for (std::size_t i = 0; i < numIters; ++i)
+                    sum += readKerningPairsGpos(
+                        fontReader, sfntOffsetTable, kerningParams).size();
+                return sum;
+            }));
+
+    report(
+        "readKerningPairsGpos(), gpos_classes, classes",
+        microbench::run(
+            [&](std::size_t numIters)
+            {
+                std::uint64_t sum = 0;
+                std::vector<RawKerningClassTable> classTables;
+                for (std::size_t i = 0; i < numIters; ++i) {
+                    classTables.clear();
+                    sum += readKerningPairsGpos(
+                        fontReader,
+                        sfntOffsetTable,
+                        kerningParams,
+                        nullptr,
+                        &classTables).size();
+                    sum += classTables.size();
+                }
+                return sum;
+            }));
+}
+
+
+TEST_CASE("RectPacker microbenchmark", "[.][microbench]") {
+    struct Size {
+        int w;
+        int h;
+    };
+
+    // Glyph-like sizes of a big font.
+    std::mt19937 gen(0);
+    std::vector<Size> randomSizes(2000);
+    for (auto& size : randomSizes) {
+        size.w = gen() % 60 + 4;
+        size.h = gen() % 60 + 4;
+    }
+
+    // The same order as in Font::packGlyphs().
+    auto sortedSizes = randomSizes;
+    std::sort(
+        sortedSizes.begin(), sortedSizes.end(),
+        [](const Size& a, const Size& b)
+        {
+            if (a.h != b.h)
+                return a.h > b.h;
+            else
+                return a.w > b.w;
+        });
+
+    struct Test {
+        const char* name;
+        const std::vector<Size>* sizes;
+    };
+    const Test tests[] = {
+        {"RectPacker::insert(), 2000 random rects", &randomSizes},
+        {"RectPacker::insert(), 2000 sorted rects", &sortedSizes},
+    };
+
+    for (const auto& test : tests) {
+        const auto& sizes = *test.sizes;
+        report(
+            test.name,
+            microbench::run(
+                [&](std::size_t numIters)
+                {
+                    using Packer = dp::rect_pack::RectPacker<>;
+
+                    std::uint64_t sum = 0;
+                    for (std::size_t i = 0; i < numIters; ++i) {
+                        Packer packer(1024, 1024, Packer::Spacing(1));
+                        for (const auto& size : sizes) {
+                            const auto result = packer.insert(
+                                size.w, size.h);
+                            sum += result.pageIndex + result.pos.x;
+                        }
+                    }
+                    return sum;
+                }));
+    }
+}
+
+
+TEST_CASE("Writers microbenchmark", "[.][microbench]") {
+    // A page of glyph-like content: runs of transparent pixels
+    // interleaved with antialiased spans that go to raw packets.
+    std::mt19937 gen(0);
+    Image image(1024, 1024);
+    for (int y = 0; y < image.getHeight(); ++y) {
+        auto* row = image.getData() + y * image.getPitch();
+        for (int x = 0; x < image.getWidth();) {
+            for (auto runLen = gen() % 64 + 1;
+                    runLen && x < image.getWidth();
+                    --runLen)
+                row[x++] = 0;
+            for (auto runLen = gen() % 24 + 1;
+                    runLen && x < image.getWidth();
+                    --runLen)
+                row[x++] = gen() % 256;
+        }
+    }
+
+    const auto& tgaWriter = ImageWriter::get("tga");
+    report(
+        "TGA writer (writeRleRow()), 1024x1024",
+        microbench::run(
+            [&](std::size_t numIters)
+            {
+                NullStream stream;
+                for (std::size_t i = 0; i < numIters; ++i)
+                    tgaWriter.write(stream, image);
+                return stream.getSize();
+            }));
+
+    // The same as BMFont "char" lines.
+    report(
+        "str::format() writer line",
+        microbench::run(
+            [&](std::size_t numIters)
+            {
+                NullStream stream;
+                for (std::size_t i = 0; i < numIters; ++i) {
+                    const auto cp = static_cast<std::uint_least32_t>(i);
+                    const int v = i & 0x3ff;
+                    stream.writeStr(str::format(
+                        "char id=%" PRIuLEAST32 " "
+                        "x=%i y=%i width=%i height=%i "
+                        "xoffset=%i yoffset=%i xadvance=%i "
+                        "page=%" PRIuLEAST32 " "
+                        "chnl=15\n",
+                        cp,
+                        v, v + 1, v & 63, v & 31,
+                        -(v & 7), v & 15, v & 63,
+                        cp >> 10));
+                }
+                return stream.getSize();
+            }));
+}
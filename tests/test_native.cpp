@@ -0,0 +1,350 @@
+
+#include "catch.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+#if DPFB_USE_FREETYPE
+    #include <ft2build.h>
+    #include FT_FREETYPE_H
+    #include FT_OUTLINE_H
+    #include FT_TRUETYPE_TABLES_H
+#endif
+
+#include "native/cff.h"
+#include "native/cmap.h"
+#include "native/glyf.h"
+#include "native/outline.h"
+#include "sfnt.h"
+#include "streams/const_mem_stream.h"
+#include "streams/file_stream.h"
+#include "streams/span_reader.h"
+
+
+using namespace dpfb;
+using namespace dpfb::native;
+
+
+static void appendU16(std::vector<std::uint8_t>& data, std::uint16_t v)
+{
+    data.push_back(v >> 8);
+    data.push_back(v & 0xff);
+}
+
+
+static void appendU16s(
+    std::vector<std::uint8_t>& data,
+    std::initializer_list<std::uint16_t> values)
+{
+    for (const auto v : values)
+        appendU16(data, v);
+}
+
+
+static void appendU32(std::vector<std::uint8_t>& data, std::uint32_t v)
+{
+    appendU16(data, v >> 16);
+    appendU16(data, v & 0xffff);
+}
+
+
+struct TestPoint {
+    std::int16_t x;
+    std::int16_t y;
+};
+
+
+// A simple glyph with a single contour of on-curve points.
+static std::vector<std::uint8_t> createSimpleGlyph(
+    std::initializer_list<TestPoint> points)
+{
+    std::vector<std::uint8_t> data;
+
+    // numberOfContours, bounding box (not used), endPtsOfContours,
+    // and instructionLength.
+    appendU16s(data, {1, 0, 0, 0, 0});
+    appendU16(data, points.size() - 1);
+    appendU16(data, 0);
+
+    for (std::size_t i = 0; i < points.size(); ++i)
+        data.push_back(0x01);  // onCurvePoint
+
+    // Coordinates are 16-bit deltas.
+    TestPoint prev {0, 0};
+    for (const auto& p : points) {
+        appendU16(data, p.x - prev.x);
+        prev.x = p.x;
+    }
+    for (const auto& p : points) {
+        appendU16(data, p.y - prev.y);
+        prev.y = p.y;
+    }
+
+    return data;
+}
+
+
+struct TestComponent {
+    std::uint16_t glyphIdx;
+    bool argsAreXyValues;
+    std::int16_t arg1;
+    std::int16_t arg2;
+};
+
+
+static std::vector<std::uint8_t> createCompositeGlyph(
+    std::initializer_list<TestComponent> components)
+{
+    std::vector<std::uint8_t> data;
+
+    // numberOfContours and bounding box (not used).
+    appendU16s(data, {0xffff, 0, 0, 0, 0});
+
+    std::size_t i = 0;
+    for (const auto& component : components) {
+        std::uint16_t flags = 0x0001;  // arg1And2AreWords
+        if (component.argsAreXyValues)
+            flags |= 0x0002;
+        if (++i < components.size())
+            flags |= 0x0020;  // moreComponents
+
+        appendU16s(data, {flags, component.glyphIdx});
+        appendU16s(
+            data,
+            {
+                static_cast<std::uint16_t>(component.arg1),
+                static_cast<std::uint16_t>(component.arg2)
+            });
+    }
+
+    return data;
+}
+
+
+// A font with only "loca" (long format) and "glyf" tables.
+static std::vector<std::uint8_t> createGlyfFont(
+    const std::vector<std::vector<std::uint8_t>>& glyphs)
+{
+    const std::uint32_t locaOffset = 12 + 2 * 16;
+    const std::uint32_t locaSize = (glyphs.size() + 1) * 4;
+    const std::uint32_t glyfOffset = locaOffset + locaSize;
+
+    std::vector<std::uint8_t> data;
+
+    // Offset table and table records.
+    appendU32(data, 0x00010000);
+    appendU16s(data, {2, 0, 0, 0});
+    appendU32(data, sfntTag('g', 'l', 'y', 'f'));
+    appendU32(data, 0);
+    appendU32(data, glyfOffset);
+    appendU32(data, 0);
+    appendU32(data, sfntTag('l', 'o', 'c', 'a'));
+    appendU32(data, 0);
+    appendU32(data, locaOffset);
+    appendU32(data, locaSize);
+
+    std::uint32_t glyphOffset = 0;
+    appendU32(data, glyphOffset);
+    for (const auto& glyph : glyphs) {
+        // Glyphs are 2-byte aligned, like required for the short
+        // "loca" format.
+        glyphOffset += (glyph.size() + 1) & ~1u;
+        appendU32(data, glyphOffset);
+    }
+
+    for (const auto& glyph : glyphs) {
+        data.insert(data.end(), glyph.begin(), glyph.end());
+        if (glyph.size() % 2 != 0)
+            data.push_back(0);
+    }
+
+    return data;
+}
+
+
+TEST_CASE("Composite glyf glyphs", "[native]") {
+    const auto fontData = createGlyfFont({
+        // 0
+        createSimpleGlyph({{0, 0}, {0, 100}, {100, 100}, {100, 0}}),
+        // 1
+        createSimpleGlyph({{0, 0}, {10, 10}, {20, 0}}),
+        // 2: Two triangles, the second starts where the first ends.
+        createCompositeGlyph({{1, true, 0, 0}, {1, false, 2, 0}}),
+        // 3: Glyph 2 goes after the square, so its points don't
+        // start from 0.
+        createCompositeGlyph({{0, true, 0, 0}, {2, true, 200, 0}}),
+        // 4: Point 3 is not in the glyph, but it would be point 3 of
+        // the square in glyph 5.
+        createCompositeGlyph({{1, true, 0, 0}, {1, false, 3, 0}}),
+        // 5
+        createCompositeGlyph({{0, true, 0, 0}, {4, true, 0, 0}}),
+    });
+
+    streams::ConstMemStream stream(&fontData[0], fontData.size());
+    const SfntOffsetTable sfntOffsetTable(
+        streams::SpanReader(&fontData[0], fontData.size()), 0);
+
+    GlyfOutlineReader reader(sfntOffsetTable, 6, 1);
+    Outline outline;
+
+    SECTION("Nested point matching") {
+        reader.read(stream, 3, outline);
+
+        // Contours are closed with lineTo() to the start.
+        using Op = Outline::Op;
+        const std::vector<Op> expectedOps {
+            Op::moveTo, Op::lineTo, Op::lineTo, Op::lineTo, Op::lineTo,
+            Op::moveTo, Op::lineTo, Op::lineTo, Op::lineTo,
+            Op::moveTo, Op::lineTo, Op::lineTo, Op::lineTo,
+        };
+        REQUIRE(outline.getOps() == expectedOps);
+
+        const std::vector<PointF> expectedPoints {
+            {0, 0}, {0, 100}, {100, 100}, {100, 0}, {0, 0},
+            {200, 0}, {210, 10}, {220, 0}, {200, 0},
+            {220, 0}, {230, 10}, {240, 0}, {220, 0},
+        };
+        const auto& points = outline.getPoints();
+        REQUIRE(points.size() == expectedPoints.size());
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            INFO("Point " << i);
+            REQUIRE(points[i].x == expectedPoints[i].x);
+            REQUIRE(points[i].y == expectedPoints[i].y);
+        }
+    }
+
+    SECTION("Invalid point number") {
+        REQUIRE_THROWS_AS(
+            reader.read(stream, 4, outline), streams::StreamError);
+        REQUIRE_THROWS_AS(
+            reader.read(stream, 5, outline), streams::StreamError);
+    }
+}
+
+
+#if DPFB_USE_FREETYPE
+
+
+static std::vector<std::uint8_t> getData(const char* fileName)
+{
+    std::vector<std::uint8_t> data;
+    streams::FileStream f(fileName, "rb");
+    data.resize(f.getSize());
+    f.readBuffer(&data[0], data.size());
+    return data;
+}
+
+
+static void compareWithFreetype(
+    FT_Face face,
+    const std::vector<std::uint8_t>& fontData,
+    std::uint32_t fontIdx)
+{
+    streams::ConstMemStream stream(&fontData[0], fontData.size());
+    const SfntOffsetTable sfntOffsetTable(
+        streams::SpanReader(&fontData[0], fontData.size()), fontIdx);
+
+    const Cmap cmap(stream, sfntOffsetTable);
+    for (char32_t cp = 0; cp <= 0x10ffff; ++cp) {
+        const auto expected = FT_Get_Char_Index(face, cp);
+        // REQUIRE only on mismatch, since there are too many
+        // code points to count them as assertions.
+        if (cmap.getGlyphIndex(cp) != expected) {
+            INFO("Code point " << cp);
+            REQUIRE(cmap.getGlyphIndex(cp) == expected);
+        }
+    }
+
+    std::unique_ptr<OutlineReader> outlineReader;
+    if (sfntOffsetTable.getTableOffset(sfntTag('g', 'l', 'y', 'f'))) {
+        const auto* head = static_cast<const TT_Header*>(
+            FT_Get_Sfnt_Table(face, FT_SFNT_HEAD));
+        REQUIRE(head);
+        outlineReader.reset(
+            new GlyfOutlineReader(
+                sfntOffsetTable,
+                face->num_glyphs,
+                head->Index_To_Loc_Format));
+    } else
+        outlineReader.reset(
+            new CffOutlineReader(stream, sfntOffsetTable));
+
+    Outline outline;
+    for (FT_Long glyphIdx = 0; glyphIdx < face->num_glyphs; ++glyphIdx) {
+        INFO("Glyph " << glyphIdx);
+
+        REQUIRE(FT_Load_Glyph(face, glyphIdx, FT_LOAD_NO_SCALE) == 0);
+        auto& ftOutline = face->glyph->outline;
+
+        outlineReader->read(stream, glyphIdx, outline);
+        REQUIRE(outline.isEmpty() == (ftOutline.n_points == 0));
+        if (outline.isEmpty())
+            continue;
+
+        const auto& ops = outline.getOps();
+        REQUIRE(
+            std::count(ops.begin(), ops.end(), Outline::Op::moveTo)
+            == ftOutline.n_contours);
+
+        FT_BBox ftCBox;
+        FT_Outline_Get_CBox(&ftOutline, &ftCBox);
+
+        float xMin, yMin, xMax, yMax;
+        outline.getCBox(xMin, yMin, xMax, yMax);
+
+        // FreeType rounds CFF coordinates to font units. For
+        // TrueType, it also shifts the outline horizontally by the
+        // difference between xMin and the left side bearing, so only
+        // the width is compared.
+        REQUIRE(
+            std::abs((xMax - xMin) - (ftCBox.xMax - ftCBox.xMin)) <= 1.0f);
+        REQUIRE(std::abs(yMin - ftCBox.yMin) <= 1.0f);
+        REQUIRE(std::abs(yMax - ftCBox.yMax) <= 1.0f);
+    }
+}
+
+
+TEST_CASE("Native font tables match FreeType", "[native]") {
+    const char* const fileNames[] = {
+        "data/collection00.ttc",
+        "data/collection01.otc",
+        "data/collection02.ttc",
+        "data/collection03.otc",
+        "data/kerning_gpos_pairs.otf",
+        "data/kerning_kern.otf",
+    };
+
+    FT_Library library;
+    REQUIRE(FT_Init_FreeType(&library) == 0);
+
+    for (const auto* fileName : fileNames) {
+        const auto fontData = getData(fileName);
+        const auto numFonts = getNumSfntFonts(
+            streams::SpanReader(&fontData[0], fontData.size()));
+
+        for (std::uint32_t fontIdx = 0; fontIdx < numFonts; ++fontIdx) {
+            INFO(fileName << ", font " << fontIdx);
+
+            FT_Face face;
+            REQUIRE(
+                FT_New_Memory_Face(
+                    library,
+                    &fontData[0],
+                    fontData.size(),
+                    fontIdx,
+                    &face) == 0);
+
+            compareWithFreetype(face, fontData, fontIdx);
+            FT_Done_Face(face);
+        }
+    }
+
+    FT_Done_FreeType(library);
+}
+
+
+#endif
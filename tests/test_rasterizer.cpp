@@ -0,0 +1,81 @@
+
+#include "catch.hpp"
+
+#include <cstdlib>
+
+#include "image.h"
+#include "native/outline.h"
+#include "native/rasterizer.h"
+
+
+using namespace dpfb;
+using namespace dpfb::native;
+
+
+TEST_CASE("Pixel-aligned square", "[rasterizer]") {
+    Outline outline;
+    outline.moveTo(1, 1);
+    outline.lineTo(1, 3);
+    outline.lineTo(3, 3);
+    outline.lineTo(3, 1);
+
+    Rasterizer rasterizer;
+    rasterizer.setSimdLevel(SimdLevel::scalar);
+    rasterizer.reset(4, 4);
+    rasterizer.drawOutline(outline, 1.0f, 0.0f, 4.0f);
+
+    Image image(4, 4);
+    rasterizer.accumulate(image);
+
+    const std::uint8_t expected[] = {
+        0, 0, 0, 0,
+        0, 255, 255, 0,
+        0, 255, 255, 0,
+        0, 0, 0, 0,
+    };
+    for (int i = 0; i < 16; ++i)
+        REQUIRE(image.getData()[i] == expected[i]);
+}
+
+
+TEST_CASE("SIMD accumulation matches scalar", "[rasterizer]") {
+    // A circle-like shape made of cubics, with a width that is not
+    // a multiple of the vector size.
+    const int size = 37;
+    const float r = 15.0f;
+    const float k = r * 0.5523f;
+    const float c = size / 2.0f;
+
+    Outline outline;
+    outline.moveTo(c + r, c);
+    outline.cubicTo(c + r, c + k, c + k, c + r, c, c + r);
+    outline.cubicTo(c - k, c + r, c - r, c + k, c - r, c);
+    outline.cubicTo(c - r, c - k, c - k, c - r, c, c - r);
+    outline.cubicTo(c + k, c - r, c + r, c - k, c + r, c);
+
+    Rasterizer rasterizer;
+
+    rasterizer.setSimdLevel(SimdLevel::scalar);
+    rasterizer.reset(size, size);
+    rasterizer.drawOutline(outline, 1.0f, 0.0f, size);
+    Image expected(size, size);
+    rasterizer.accumulate(expected);
+
+    const SimdLevel levels[] = {SimdLevel::sse2, SimdLevel::avx2};
+    for (const auto level : levels) {
+        if (level > getMaxSimdLevel())
+            break;
+
+        rasterizer.setSimdLevel(level);
+        rasterizer.reset(size, size);
+        rasterizer.drawOutline(outline, 1.0f, 0.0f, size);
+        Image image(size, size);
+        rasterizer.accumulate(image);
+
+        // The prefix sum is computed in a different order, so
+        // rounding may differ by 1.
+        for (int i = 0; i < size * size; ++i)
+            REQUIRE(
+                std::abs(image.getData()[i] - expected.getData()[i]) <= 1);
+    }
+}
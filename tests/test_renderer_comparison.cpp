@@ -0,0 +1,112 @@
+
+#include "catch.hpp"
+
+#include <vector>
+
+#include "cp_range.h"
+#include "font_renderer/font_renderer.h"
+#include "renderer_comparison.h"
+#include "stress_font.h"
+
+
+using namespace dpfb;
+
+
+TEST_CASE("Renderer comparison", "[renderer_comparison]") {
+    StressFontParams params;
+    params.numGlyphs = 50;
+    params.firstCp = 0x41;
+    params.cmapGroupSize = 20;
+    params.numLookups = 1;
+    params.numClasses1 = 2;
+    params.numClasses2 = 2;
+    params.numClassRanges = 2;
+
+    const auto cps = getStressFontCps(params);
+    const auto fontData = generateStressFont(params);
+    const FontRendererArgs args {
+        &fontData[0], fontData.size(), 0, 16, {}, {}};
+
+    // Includes the code point of a cmap gap.
+    const cp_range::CpRangeList cpRangeList {
+        cp_range::CpRange(cps.front(), cps.back())};
+
+    const auto* first = FontRendererCreator::getFirst();
+    REQUIRE(first);
+
+    SECTION("Same renderer") {
+        const auto comparison = compareRenderers(
+            args, cpRangeList, {first, first});
+
+        REQUIRE(comparison.timings.size() == 2);
+        for (const auto& timing : comparison.timings)
+            REQUIRE(timing.numGlyphs == cps.size());
+
+        REQUIRE(comparison.diffs.size() == 1);
+        const auto& diff = comparison.diffs[0];
+        REQUIRE(diff.numCpMismatches == 0);
+        REQUIRE(diff.metricsMismatches.empty());
+        REQUIRE(diff.numDifferentGlyphs == 0);
+        REQUIRE(diff.maxError == 0);
+        REQUIRE(diff.meanError == 0.0);
+    }
+
+    SECTION("All renderers") {
+        std::vector<const FontRendererCreator*> creators;
+        for (const auto* c = first; c; c = c->getNext())
+            creators.push_back(c);
+
+        const auto comparison = compareRenderers(
+            args, cpRangeList, creators);
+
+        REQUIRE(comparison.timings.size() == creators.size());
+        REQUIRE(comparison.diffs.size() == creators.size() - 1);
+        for (std::size_t i = 0; i < creators.size(); ++i) {
+            INFO("Font renderer " << creators[i]->getName());
+            REQUIRE(comparison.timings[i].numGlyphs == cps.size());
+            if (i > 0)
+                REQUIRE(comparison.diffs[i - 1].numCpMismatches == 0);
+        }
+    }
+}
+
+
+TEST_CASE("Glyph bitmap comparison", "[renderer_comparison]") {
+    // A 2x2 glyph with its top edge 3 px above the baseline.
+    GlyphBitmap bitmap;
+    bitmap.metrics.size = {2, 2};
+    bitmap.metrics.offset = {1, 3};
+    bitmap.pixels = {
+        10, 20,
+        30, 40,
+    };
+
+    SECTION("Extra empty rows") {
+        // Same top edge, but two more empty rows below.
+        GlyphBitmap taller;
+        taller.metrics.size = {2, 4};
+        taller.metrics.offset = {1, 3};
+        taller.pixels = {
+            10, 20,
+            30, 40,
+            0, 0,
+            0, 0,
+        };
+
+        const auto diff = compareGlyphBitmaps(bitmap, taller);
+        REQUIRE(diff.maxError == 0);
+        REQUIRE(diff.errorSum == 0);
+        REQUIRE(diff.numPixels == 8);
+    }
+
+    SECTION("Shift") {
+        // Same pixels one row lower.
+        auto shifted = bitmap;
+        shifted.metrics.offset.y = 2;
+
+        const auto diff = compareGlyphBitmaps(bitmap, shifted);
+        REQUIRE(diff.maxError == 40);
+        REQUIRE(diff.errorSum == 10 + 20 + 20 + 20 + 30 + 40);
+        REQUIRE(diff.numPixels == 6);
+    }
+}
@@ -127,7 +127,13 @@ TEST_CASE("SfntOffsetTable", "[sfnt]") {
         const auto collectionFileName = "data/" + collectionName;
         INFO(collectionFileName);
 
-        FileStream fontStream(collectionFileName, "rb");
+        std::vector<std::uint8_t> fontData;
+        {
+            FileStream f(collectionFileName, "rb");
+            fontData.resize(f.getSize());
+            f.readBuffer(&fontData[0], fontData.size());
+        }
+        const SpanReader fontReader(&fontData[0], fontData.size());
 
         int fontIdx = 0;
         for (; fontIdx < 100; ++fontIdx) {
@@ -156,7 +162,7 @@ TEST_CASE("SfntOffsetTable", "[sfnt]") {
             }
             std::fclose(fp);
 
-            SfntOffsetTable offsetTable(fontStream, fontIdx);
+            SfntOffsetTable offsetTable(fontReader, fontIdx);
             for (const auto& tableOffset : tableOffsets) {
                 INFO("Tag " << sfntTagToStr(tableOffset.tag));
                 REQUIRE(
@@ -166,7 +172,8 @@ TEST_CASE("SfntOffsetTable", "[sfnt]") {
         }
 
         REQUIRE_THROWS_AS(
-            SfntOffsetTable(fontStream, fontIdx), StreamError);
+            SfntOffsetTable(fontReader, fontIdx), StreamError);
+        REQUIRE(getNumSfntFonts(fontReader) == std::uint32_t(fontIdx));
     }
 }
 
@@ -6,6 +6,8 @@
 
 #include "streams/const_mem_stream.h"
 #include "streams/file_stream.h"
+#include "streams/span_reader.h"
+#include "streams/stream_stats.h"
 
 
 using namespace dpfb::streams;
@@ -114,4 +116,164 @@ TEST_CASE("ConstMemStream", "[streams]") {
         ConstMemStream stream(testBuf, sizeof(testBuf));
         commonRead(stream);
     }
+
+    SECTION("Reading arrays") {
+        const unsigned char data[] = {
+            0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08
+        };
+        ConstMemStream stream(data, sizeof(data));
+
+        std::uint16_t u16s[2];
+        stream.readU16BeArray(u16s, 2);
+        REQUIRE(u16s[0] == 0x0102);
+        REQUIRE(u16s[1] == 0x0304);
+
+        std::uint32_t u32;
+        stream.readU32BeArray(&u32, 1);
+        REQUIRE(u32 == 0x05060708);
+
+        REQUIRE_THROWS_AS(stream.readU16BeArray(u16s, 1), StreamError);
+    }
+}
+
+
+TEST_CASE("SpanReader", "[streams]") {
+    REQUIRE_THROWS_AS(SpanReader(nullptr, 4), StreamError);
+    REQUIRE_NOTHROW(SpanReader(testBuf, 0));
+
+    const unsigned char data[] = {
+        0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0xff, 0xfe, 0xff, 0xff, 0xff, 0xfd
+    };
+
+    SECTION("Reading") {
+        SpanReader reader(data, sizeof(data));
+        REQUIRE(reader.getPosition() == 0);
+        REQUIRE(reader.getSize() == sizeof(data));
+
+        REQUIRE(reader.readU8() == 0x01);
+        REQUIRE(reader.readS8() == 0x02);
+        REQUIRE(reader.readU16Be() == 0x0304);
+        REQUIRE(reader.readS16Be() == 0x0506);
+        REQUIRE(reader.readS16Be() == -2);
+        REQUIRE(reader.readS32Be() == -3);
+        REQUIRE(reader.getPosition() == sizeof(data));
+
+        REQUIRE_THROWS_AS(reader.readU8(), StreamError);
+        REQUIRE(reader.getPosition() == sizeof(data));
+
+        reader.seek(-4, SeekOrigin::end);
+        REQUIRE(reader.readU32Be() == 0xfffffffd);
+
+        // Partial reads don't move the position.
+        reader.seek(-3, SeekOrigin::end);
+        REQUIRE_THROWS_AS(reader.readU32Be(), StreamError);
+        REQUIRE(reader.getPosition() == sizeof(data) - 3);
+
+        REQUIRE_THROWS_AS(reader.seek(-1, SeekOrigin::set), StreamError);
+
+        // Can seek past end
+        REQUIRE_NOTHROW(reader.seek(100, SeekOrigin::set));
+        REQUIRE(reader.getPosition() == 100);
+        REQUIRE_THROWS_AS(reader.readU16Be(), StreamError);
+
+        reader.seek(0, SeekOrigin::set);
+        SpanReader copy = reader;
+        REQUIRE(copy.readU16Be() == 0x0102);
+        REQUIRE(reader.getPosition() == 0);
+
+        reader.seek(0, SeekOrigin::set);
+        std::uint16_t u16s[3];
+        reader.readU16BeArray(u16s, 3);
+        REQUIRE(u16s[0] == 0x0102);
+        REQUIRE(u16s[1] == 0x0304);
+        REQUIRE(u16s[2] == 0x0506);
+        std::uint32_t u32;
+        reader.readU32BeArray(&u32, 1);
+        REQUIRE(u32 == 0xfffeffff);
+        REQUIRE(reader.getPosition() == 10);
+
+        reader.seek(-2, SeekOrigin::end);
+        REQUIRE_THROWS_AS(reader.readU16BeArray(u16s, 2), StreamError);
+        REQUIRE(reader.getPosition() == sizeof(data) - 2);
+
+        SpanReader textReader(testBuf, sizeof(testBuf));
+        char inBuf[sizeof(testBuf)];
+        REQUIRE_NOTHROW(textReader.readBuffer(inBuf, sizeof(inBuf)));
+        REQUIRE(std::memcmp(testBuf, inBuf, sizeof(inBuf)) == 0);
+    }
+
+    SECTION("Sub-spans") {
+        const SpanReader reader(data, sizeof(data));
+
+        auto subSpan = reader.getSubSpan(2);
+        REQUIRE(subSpan.getSize() == sizeof(data) - 2);
+        REQUIRE(subSpan.getPosition() == 0);
+        REQUIRE(subSpan.readU16Be() == 0x0304);
+
+        subSpan = reader.getSubSpan(2, 2);
+        REQUIRE(subSpan.getSize() == 2);
+        REQUIRE(subSpan.readU16Be() == 0x0304);
+        REQUIRE_THROWS_AS(subSpan.readU8(), StreamError);
+
+        REQUIRE_NOTHROW(reader.getSubSpan(sizeof(data)));
+        REQUIRE_NOTHROW(reader.getSubSpan(sizeof(data), 0));
+        REQUIRE_THROWS_AS(reader.getSubSpan(sizeof(data) + 1), StreamError);
+        REQUIRE_THROWS_AS(
+            reader.getSubSpan(sizeof(data) - 1, 2), StreamError);
+    }
+}
+
+
+TEST_CASE("StreamStats", "[streams]") {
+    const std::uint8_t data[] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+    StreamStats stats {};
+    StreamStats innerStats {};
+    {
+        const StreamStatsScope scope(&stats);
+        REQUIRE(getCurrentStreamStats() == &stats);
+
+        ConstMemStream stream(data, sizeof(data));
+        stream.readU16Be();
+        stream.seek(6, SeekOrigin::set);
+
+        SpanReader reader(data, sizeof(data));
+        std::uint16_t u16s[2];
+        reader.readU16BeArray(u16s, 2);
+        reader.seek(-3, SeekOrigin::cur);
+
+        {
+            const StreamStatsScope innerScope(&innerStats);
+            reader.readU8();
+        }
+        REQUIRE(getCurrentStreamStats() == &stats);
+
+        {
+            const StreamStatsScope nullScope(nullptr);
+            reader.readU8();
+        }
+    }
+    REQUIRE(getCurrentStreamStats() == nullptr);
+
+    SpanReader(data, sizeof(data)).readU32Be();
+
+    if (!areStreamStatsEnabled()) {
+        REQUIRE(stats.numReads == 0);
+        REQUIRE(innerStats.numReads == 0);
+        return;
+    }
+
+    REQUIRE(stats.numReads == 2);
+    REQUIRE(stats.bytesRead == 6);
+    REQUIRE(stats.numSeeks == 2);
+    REQUIRE(stats.seekDistance == 7);
+    REQUIRE(stats.numWrites == 0);
+    REQUIRE(stats.bytesWritten == 0);
+
+    REQUIRE(innerStats.numReads == 1);
+    REQUIRE(innerStats.bytesRead == 1);
+
+    stats += innerStats;
+    REQUIRE(stats.numReads == 3);
+    REQUIRE(stats.bytesRead == 7);
 }
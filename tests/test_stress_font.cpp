@@ -0,0 +1,88 @@
+
+#include "catch.hpp"
+
+#include <memory>
+#include <vector>
+
+#include "font_renderer/font_renderer.h"
+#include "kerning.h"
+#include "sfnt.h"
+#include "streams/span_reader.h"
+#include "stress_font.h"
+
+
+using namespace dpfb;
+
+
+TEST_CASE("Stress font", "[stress_font]") {
+    StressFontParams params;
+    params.numGlyphs = 3000;
+    params.firstCp = 0xd000;
+    params.cmapGroupSize = 100;
+    params.numLookups = 3;
+    params.numClasses1 = 20;
+    params.numClasses2 = 30;
+    params.numClassRanges = 50;
+
+    const auto cps = getStressFontCps(params);
+    REQUIRE(cps.size() == params.numGlyphs - 1u);
+    for (std::size_t i = 1; i < cps.size(); ++i) {
+        REQUIRE(cps[i] > cps[i - 1]);
+        REQUIRE((cps[i] < 0xd800 || cps[i] > 0xdfff));
+    }
+
+    const auto fontData = generateStressFont(params);
+    REQUIRE(fontData == generateStressFont(params));
+
+    const streams::SpanReader fontReader(&fontData[0], fontData.size());
+    const SfntOffsetTable sfntOffsetTable(fontReader, 0);
+
+    SECTION("Font renderers") {
+        const auto* creator = FontRendererCreator::getFirst();
+        REQUIRE(creator);
+        for (const auto* c = creator; c; c = c->getNext()) {
+            INFO("Font renderer " << c->getName());
+            std::unique_ptr<FontRenderer> fontRenderer(
+                c->create({&fontData[0], fontData.size(), 0, 16, {}, {}}));
+
+            const auto metrics = fontRenderer->getFontMetrics();
+            REQUIRE(metrics.ascender > 0);
+            REQUIRE(metrics.descender < 0);
+
+            for (std::size_t i = 0; i < cps.size(); i += 97)
+                REQUIRE(fontRenderer->getGlyphIndex(cps[i]) == i + 1);
+            REQUIRE(fontRenderer->getGlyphIndex(cps[99] + 1) == 0);
+
+            const auto glyphMetrics = fontRenderer->getGlyphMetrics(1);
+            REQUIRE(glyphMetrics.size.w > 0);
+            REQUIRE(glyphMetrics.size.h > 0);
+        }
+    }
+
+    SECTION("Kerning") {
+        const KerningParams kerningParams {16, 1000, KerningUnits::font, {}};
+
+        std::vector<RawKerningClassTable> classTables;
+        const auto pairs = readKerningPairsGpos(
+            fontReader,
+            sfntOffsetTable,
+            kerningParams,
+            nullptr,
+            &classTables);
+        REQUIRE(pairs.empty());
+        REQUIRE(classTables.size() == params.numLookups);
+
+        // Expand a subset to keep the test fast.
+        GlyphSet glyphSet(200, true);
+        const auto expandedPairs = readKerningPairsGpos(
+            fontReader, sfntOffsetTable, kerningParams, &glyphSet);
+        REQUIRE(!expandedPairs.empty());
+
+        std::size_t numPairsOutsideSet = 0;
+        for (const auto& pair : expandedPairs)
+            if (pair.glyphIdx1 == 0 || pair.glyphIdx1 >= 200
+                    || pair.glyphIdx2 == 0 || pair.glyphIdx2 >= 200)
+                ++numPairsOutsideSet;
+        REQUIRE(numPairsOutsideSet == 0);
+    }
+}
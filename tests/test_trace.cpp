@@ -0,0 +1,96 @@
+
+#include "catch.hpp"
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "streams/file_stream.h"
+#include "trace.h"
+
+
+using namespace dpfb;
+
+
+static std::string writeTrace()
+{
+    const char* tmpFile = "trace.json";
+
+    {
+        streams::FileStream f(tmpFile, "wb");
+        trace::write(f);
+    }
+
+    std::vector<char> data;
+    {
+        streams::FileStream f(tmpFile, "rb");
+        data.resize(f.getSize());
+        f.readBuffer(data.data(), data.size());
+    }
+    std::remove(tmpFile);
+
+    return {data.begin(), data.end()};
+}
+
+
+static bool contains(const std::string& str, const char* substr)
+{
+    return str.find(substr) != std::string::npos;
+}
+
+
+TEST_CASE("trace", "[trace]") {
+    {
+        trace::Span span("before start", "test");
+    }
+
+    trace::start();
+    REQUIRE(trace::isEnabled());
+
+    {
+        trace::Span span("main span", "test");
+        span.addArg("int", -5);
+        span.addArg("str", "a\"b\\\n\x01");
+
+        std::thread thread([]()
+        {
+            const trace::Span span("thread span", "test");
+        });
+        thread.join();
+    }
+
+    trace::stop();
+    REQUIRE_FALSE(trace::isEnabled());
+
+    {
+        const trace::Span span("after stop", "test");
+    }
+
+    const auto json = writeTrace();
+
+    REQUIRE(contains(json, "\"traceEvents\""));
+    REQUIRE(contains(
+        json, "\"name\": \"thread_name\", \"ph\": \"M\", "
+        "\"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"main\"}"));
+    REQUIRE(contains(json, "\"args\": {\"name\": \"thread 2\"}"));
+
+    REQUIRE(contains(
+        json, "{\"name\": \"main span\", \"cat\": \"test\", "
+        "\"ph\": \"X\", \"pid\": 1, \"tid\": 1, "));
+    REQUIRE(contains(
+        json,
+        "\"args\": {\"int\": -5, "
+        "\"str\": \"a\\\"b\\\\\\u000a\\u0001\"}"));
+    REQUIRE(contains(
+        json, "{\"name\": \"thread span\", \"cat\": \"test\", "
+        "\"ph\": \"X\", \"pid\": 1, \"tid\": 2, "));
+
+    REQUIRE_FALSE(contains(json, "before start"));
+    REQUIRE_FALSE(contains(json, "after stop"));
+
+    // Restarting discards the spans.
+    trace::start();
+    trace::stop();
+    REQUIRE_FALSE(contains(writeTrace(), "main span"));
+}
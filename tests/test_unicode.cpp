@@ -159,6 +159,48 @@ TEST_CASE("utf16ToUtf8", "[unicode]") {
 }
 
 
+TEST_CASE("decodeUtf8", "[unicode]") {
+    struct Test {
+        const char* utf8str;
+        std::u32string expected;
+    };
+
+    const char32_t r = replacementCharacter;
+
+    const Test tests[] = {
+        {"a", U"a"},
+        {"\xd0\x94", U"\u0414"},
+        {"\xe2\x98\xba", U"\u263a"},
+        {"\xf0\x9f\x98\x80", U"\U0001f600"},
+        {"a\xd0\x94" "b", U"a\u0414b"},
+
+        // Invalid sequences
+        {"\x80", {r}},  // Lone trailing byte
+        {"\xff", {r}},
+        {"\xd0", {r}},  // Truncated
+        {"\xe2\x98", {r, r}},
+        {"\xd0" "a", {r, 'a'}},  // Not a trailing byte
+        {"\xc0\xaf", {r, r}},  // Overlong
+        {"\xed\xa0\x80", {r, r, r}},  // Surrogate
+        {"\xf4\x90\x80\x80", {r, r, r, r}},  // > U+10FFFF
+    };
+
+    for (const auto& test : tests) {
+        INFO(test.utf8str);
+
+        const auto* str = test.utf8str;
+        const auto* end = str + std::strlen(str);
+
+        std::u32string result;
+        while (str < end)
+            result += decodeUtf8(str, end);
+
+        REQUIRE(str == end);
+        REQUIRE(result == test.expected);
+    }
+}
+
+
 TEST_CASE("encodeUtf16", "[unicode]") {
     struct Test {
         char32_t cp;
@@ -4,6 +4,7 @@
 
 import argparse
 import json
+import math
 import os
 import sys
 
@@ -15,6 +16,23 @@ QUICK_BROWN_FOX = 'The quick brown fox jumps over the lazy dog.'
 REPLACEMENT_CHARACTER = 0xfffd
 
 
+def scale_kerning_to_px(font, kerning_lookup):
+    px_size = font['bakingOptions']['fontPxSize']
+    scale = px_size / font['kerningUnitsPerEm']
+
+    for key, amount in kerning_lookup.items():
+        # Round half away from zero, like C's lround().
+        scaled = math.floor(abs(amount) * scale + 0.5)
+        kerning_lookup[key] = scaled if amount >= 0 else -scaled
+
+    for delta in font['kerningDeltas']:
+        if delta['pxSize'] != px_size:
+            continue
+
+        key = (delta['codePoint1'], delta['codePoint2'])
+        kerning_lookup[key] = kerning_lookup.get(key, 0) + delta['amount']
+
+
 def parse_args():
     parser = argparse.ArgumentParser(
         description=(
@@ -167,6 +185,20 @@ def main():
         cp2 = kerning_pair['codePoint2']
         kerning_lookup[(cp1, cp2)] = kerning_pair['amount']
 
+    # The first non-zero amount wins: explicit pairs, then class
+    # tables in order.
+    for class_table in font.get('kerningClasses', []):
+        amounts = class_table['amounts']
+        for cp1, left_class in class_table['leftClasses']:
+            row = amounts[left_class]
+            for cp2, right_class in class_table['rightClasses']:
+                amount = row[right_class]
+                if amount != 0:
+                    kerning_lookup.setdefault((cp1, cp2), amount)
+
+    if 'kerningUnitsPerEm' in font:
+        scale_kerning_to_px(font, kerning_lookup)
+
     page_lookup = load_pages_for_text(
         text, font, os.path.dirname(args.font), glyph_lookup)
 